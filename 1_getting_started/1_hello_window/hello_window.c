@@ -4,10 +4,28 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 
+#include "common/headless.h"
+#include "common/frame_pacer.h"
+
 #define WINDOW_WIDTH 960
 #define WINDOW_HEIGHT 540
 
-int main(void) {
+FramePacer FRAME_PACER;
+
+static void
+render(void) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+int
+main(int argc, char **argv) {
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        return run_headless("hello_window", &headless, 0, render);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("Failed to initialize SDL: %s\n", SDL_GetError());
         return -1;
@@ -47,8 +65,14 @@ int main(void) {
 
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
+    FramePacerOptions pacing;
+    parse_frame_pacer_options(argc, argv, &pacing);
+    init_frame_pacer(&FRAME_PACER, &pacing);
+
     bool running = true;
     while (running) {
+        begin_frame(&FRAME_PACER);
+
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             switch (e.type) {
@@ -66,12 +90,13 @@ int main(void) {
             }
         }
 
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        render();
 
-        SDL_GL_SwapWindow(window);
+        end_frame(&FRAME_PACER, window);
     }
 
+    print_frame_pacer_report(&FRAME_PACER);
+
     SDL_GL_DeleteContext(glcontext);
     SDL_DestroyWindow(window);
 
@@ -4,75 +4,75 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 
+#include "common/headless.h"
+#include "common/frame_pacer.h"
 #include "common/shader.h"
+#include "common/shader_watcher.h"
+
+#include "hello_triangle_geometry.h"
 
 #define WINDOW_WIDTH 960
 #define WINDOW_HEIGHT 540
 
-char *VERTEX_SHADER = "                                                     \
-#version 330 core                                                         \n\
-                                                                          \n\
-layout (location = 0)                                                     \n\
-in vec3 pos;                                                              \n\
-                                                                          \n\
-void main() {                                                             \n\
-    gl_Position = vec4(pos.xyz, 1.0);                                     \n\
-}                                                                           \
-";
-
-char *FRAGMENT_SHADER = "                                                   \
-#version 330 core                                                         \n\
-                                                                          \n\
-out vec4 color;                                                           \n\
-                                                                          \n\
-void main() {                                                             \n\
-    color = vec4(1.0, 0.5, 0.2, 1.0);                                     \n\
-}                                                                           \
-";
-
-GLfloat VERTICES[] = {
-    0.5f,  0.5f, 0.0f, // Top Right
-    0.5f, -0.5f, 0.0f, // Bottom Right
-   -0.5f, -0.5f, 0.0f, // Bottom Left
-   -0.5f,  0.5f, 0.0f, // Top Left
-};
-
-GLuint INDICES[] = {
-    0, 1, 3, // First Triangle
-    1, 2, 3, // Second Triangle
-};
-
 GLuint VAO, VBO, EBO;
-GLuint PROGRAM;
+Program PROGRAM;
+ShaderWatcher SHADER_WATCHER;
+
+FramePacer FRAME_PACER;
 
 static void
 init(void) {
-    PROGRAM = compile_program_raw(VERTEX_SHADER, FRAGMENT_SHADER);
+    // Edit either file while the sample runs to see it reload.
+    init_shader_watcher(&SHADER_WATCHER);
+    submit_watched_program(&SHADER_WATCHER, &PROGRAM, "hello_triangle.vert",
+                           "hello_triangle.frag", 0, 0);
+    finish_program(&PROGRAM);
+    print_program_cache_report();
 
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    bind_vertex_array(VAO);
 
     glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VERTICES), VERTICES, GL_STATIC_DRAW);
+    bind_buffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(HELLO_TRIANGLE_VERTICES),
+                 HELLO_TRIANGLE_VERTICES, GL_STATIC_DRAW);
 
     glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(INDICES), INDICES,
-                 GL_STATIC_DRAW);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(HELLO_TRIANGLE_INDICES),
+                 HELLO_TRIANGLE_INDICES, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
     glEnableVertexAttribArray(0);
 
-    glBindVertexArray(0);
+    bind_vertex_array(0);
 
 #if 1
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 #endif
 }
 
+static void
+render(void) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    update_shader_watcher(&SHADER_WATCHER);
+
+    use_program(PROGRAM.id);
+    bind_vertex_array(VAO);
+    glDrawElements(GL_TRIANGLES, HELLO_TRIANGLE_INDEX_COUNT, GL_UNSIGNED_SHORT,
+                   0);
+}
+
 int
-main(void) {
+main(int argc, char **argv) {
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        return run_headless("hello_triangle", &headless, init, render);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("Failed to initialize SDL: %s\n", SDL_GetError());
         return -1;
@@ -112,10 +112,16 @@ main(void) {
 
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
+    FramePacerOptions pacing;
+    parse_frame_pacer_options(argc, argv, &pacing);
+    init_frame_pacer(&FRAME_PACER, &pacing);
+
     init();
 
     bool running = true;
     while (running) {
+        begin_frame(&FRAME_PACER);
+
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             switch (e.type) {
@@ -133,17 +139,13 @@ main(void) {
             }
         }
 
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glUseProgram(PROGRAM);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        render();
 
-        SDL_GL_SwapWindow(window);
+        end_frame(&FRAME_PACER, window);
     }
 
+    print_frame_pacer_report(&FRAME_PACER);
+
     SDL_GL_DeleteContext(glcontext);
     SDL_DestroyWindow(window);
 
@@ -0,0 +1,7 @@
+#version 330 core
+
+out vec4 color;
+
+void main() {
+    color = vec4(1.0, 0.5, 0.2, 1.0);
+}
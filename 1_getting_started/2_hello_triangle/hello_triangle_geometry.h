@@ -0,0 +1,24 @@
+#ifndef HELLO_TRIANGLE_GEOMETRY_H
+#define HELLO_TRIANGLE_GEOMETRY_H
+
+// The quad drawn by hello_triangle.c, shared with benchmarks/soft_raster.c
+// so its golden image follows the sample.
+
+GLfloat HELLO_TRIANGLE_VERTICES[] = {
+    0.5f,  0.5f, 0.0f, // Top Right
+    0.5f, -0.5f, 0.0f, // Bottom Right
+   -0.5f, -0.5f, 0.0f, // Bottom Left
+   -0.5f,  0.5f, 0.0f, // Top Left
+};
+
+#define HELLO_TRIANGLE_VERTEX_STRIDE 3
+
+// Four vertices only need 16-bit indices.
+GLushort HELLO_TRIANGLE_INDICES[] = {
+    0, 1, 3, // First Triangle
+    1, 2, 3, // Second Triangle
+};
+
+#define HELLO_TRIANGLE_INDEX_COUNT 6
+
+#endif
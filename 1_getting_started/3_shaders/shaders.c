@@ -4,60 +4,54 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 
+#include "common/headless.h"
+#include "common/frame_pacer.h"
+#include "common/profiler.h"
 #include "common/shader.h"
+#include "common/shader_watcher.h"
+
+#include "shaders_geometry.h"
 
 #define WINDOW_WIDTH 960
 #define WINDOW_HEIGHT 540
 
-char *VERTEX_SHADER = "                                                       \
-#version 330 core                                                           \n\
-                                                                            \n\
-layout (location = 0)                                                       \n\
-in vec3 pos;                                                                \n\
-                                                                            \n\
-layout (location = 1)                                                       \n\
-in vec3 color;                                                              \n\
-                                                                            \n\
-out vec3 vertex_color;                                                      \n\
-                                                                            \n\
-void main() {                                                               \n\
-    gl_Position = vec4(pos.xyz, 1.0);                                       \n\
-    vertex_color = color;                                                   \n\
-}                                                                             \
-";
-
-char *FRAGMENT_SHADER = "                                                     \
-#version 330 core                                                           \n\
-                                                                            \n\
-in vec3 vertex_color;                                                       \n\
-                                                                            \n\
-out vec4 color;                                                             \n\
-                                                                            \n\
-void main() {                                                               \n\
-    color = vec4(vertex_color, 1.0f);                                       \n\
-}                                                                             \
-";
-
-GLfloat VERTICES[] = {
-    // Positions        // Colors
-    0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, // Bottom Right
-   -0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, // Bottom Left
-    0.0f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f, // Top
+enum {
+    UNIFORM_COLOR,
+    UNIFORM_COUNT,
+};
+
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "color",
 };
 
 GLuint VAO, VBO;
-GLuint PROGRAM;
+Program PROGRAM;
+ShaderWatcher SHADER_WATCHER;
+
+FramePacer FRAME_PACER;
+
+// Set from --trace before init().
+const char *TRACE_PATH;
+Profiler PROFILER;
 
 static void
 init(void) {
-    PROGRAM = compile_program_raw(VERTEX_SHADER, FRAGMENT_SHADER);
+    init_profiler(&PROFILER, TRACE_PATH);
+
+    // Edit either file while the sample runs to see it reload.
+    init_shader_watcher(&SHADER_WATCHER);
+    submit_watched_program(&SHADER_WATCHER, &PROGRAM, "shaders.vert",
+                           "shaders.frag", UNIFORM_NAMES, UNIFORM_COUNT);
+    finish_program(&PROGRAM);
+    print_program_cache_report();
 
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    bind_vertex_array(VAO);
 
     glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VERTICES), VERTICES, GL_STATIC_DRAW);
+    bind_buffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(SHADERS_VERTICES), SHADERS_VERTICES,
+                 GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
     glEnableVertexAttribArray(0);
@@ -66,15 +60,59 @@ init(void) {
                           (GLvoid *)(3 * sizeof(GLfloat)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    bind_vertex_array(0);
 
 #if 0
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 #endif
 }
 
+static void
+render(void) {
+    update_profiler(&PROFILER);
+
+    begin_zone(&PROFILER, "clear");
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    end_zone(&PROFILER);
+
+    begin_zone(&PROFILER, "shader reload");
+    update_shader_watcher(&SHADER_WATCHER);
+    end_zone(&PROFILER);
+
+    GLfloat time = SDL_GetTicks() / 1000.0f;
+    GLfloat green = (sin(time) / 2 ) + 0.5;
+
+    begin_zone(&PROFILER, "bind program");
+    use_program(PROGRAM.id);
+    end_zone(&PROFILER);
+
+    begin_zone(&PROFILER, "uniforms");
+    glUniform4f(PROGRAM.uniforms[UNIFORM_COLOR], 0.0f, green, 0.0f, 1.0f);
+    end_zone(&PROFILER);
+
+    begin_zone(&PROFILER, "draw");
+    bind_vertex_array(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, SHADERS_VERTEX_COUNT);
+    end_zone(&PROFILER);
+}
+
+static void
+cleanup(void) {
+    close_profiler(&PROFILER);
+}
+
 int
-main(void) {
+main(int argc, char **argv) {
+    TRACE_PATH = parse_trace_path(argc, argv);
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.shutdown = cleanup;
+        return run_headless("shaders", &headless, init, render);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("Failed to initialize SDL: %s\n", SDL_GetError());
         return -1;
@@ -118,10 +156,16 @@ main(void) {
 
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
+    FramePacerOptions pacing;
+    parse_frame_pacer_options(argc, argv, &pacing);
+    init_frame_pacer(&FRAME_PACER, &pacing);
+
     init();
 
     bool running = true;
     while (running) {
+        begin_frame(&FRAME_PACER);
+
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             switch (e.type) {
@@ -139,22 +183,16 @@ main(void) {
             }
         }
 
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        render();
 
-        GLfloat time = SDL_GetTicks() / 1000.0f;
-        GLfloat green = (sin(time) / 2 ) + 0.5;
-
-        GLint color_location = glGetUniformLocation(PROGRAM, "color");
+        begin_zone(&PROFILER, "swap");
+        end_frame(&FRAME_PACER, window);
+        end_zone(&PROFILER);
+    }
 
-        glUseProgram(PROGRAM);
-        glUniform4f(color_location, 0.0f, green, 0.0f, 1.0f);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
+    cleanup();
 
-        SDL_GL_SwapWindow(window);
-    }
+    print_frame_pacer_report(&FRAME_PACER);
 
     SDL_GL_DeleteContext(glcontext);
     SDL_DestroyWindow(window);
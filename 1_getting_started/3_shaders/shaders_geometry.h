@@ -0,0 +1,17 @@
+#ifndef SHADERS_GEOMETRY_H
+#define SHADERS_GEOMETRY_H
+
+// The triangle drawn by shaders.c, shared with benchmarks/soft_raster.c so
+// its golden image follows the sample.
+
+GLfloat SHADERS_VERTICES[] = {
+    // Positions        // Colors
+    0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, // Bottom Right
+   -0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, // Bottom Left
+    0.0f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f, // Top
+};
+
+#define SHADERS_VERTEX_COUNT 3
+#define SHADERS_VERTEX_STRIDE 6
+
+#endif
@@ -4,14 +4,23 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 
-#include <SOIL/SOIL.h>
-
+#include "common/headless.h"
+#include "common/frame_pacer.h"
+#include "common/mesh_packing.h"
+#include "common/profiler.h"
 #include "common/shader.h"
+#include "common/shader_watcher.h"
+#include "common/texture_loader.h"
+
+#include "textures_geometry.h"
 
 #define WINDOW_WIDTH 960
 #define WINDOW_HEIGHT 540
 
-char *VERTEX_SHADER = "                                                       \
+// PROGRAM comes from textures.vert and textures.frag and reloads when they
+// change. The fallback is built in so there is always something to draw while
+// PROGRAM links or if the files are missing.
+char *FALLBACK_VERTEX_SHADER = "                                              \
 #version 330 core                                                           \n\
                                                                             \n\
 layout (location = 0)                                                       \n\
@@ -33,102 +42,149 @@ void main() {                                                               \n\
 }                                                                             \
 ";
 
-char *FRAGMENT_SHADER = "                                                     \
+char *FALLBACK_FRAGMENT_SHADER = "                                            \
 #version 330 core                                                           \n\
                                                                             \n\
-uniform sampler2D texture0;                                                 \n\
-uniform sampler2D texture1;                                                 \n\
-                                                                            \n\
 in vec3 vertex_color;                                                       \n\
 in vec2 vertex_texcoord;                                                    \n\
                                                                             \n\
 out vec4 color;                                                             \n\
                                                                             \n\
 void main() {                                                               \n\
-    color = mix(texture(texture0, vertex_texcoord),                         \n\
-                texture(texture1, vertex_texcoord),                         \n\
-                0.2);                                                       \n\
+    color = vec4(vertex_color, 1.0);                                        \n\
 }                                                                             \
 ";
 
-GLfloat VERTICES[] = {
-    // Positions       // Colors         // Texture Coords
-    0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, // Top Right
-    0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, // Bottom Right
-   -0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // Bottom Left
-   -0.5f,  0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, // Top Left
+// Packed to 16 bytes per vertex and 16-bit indices at init.
+MeshAttribute ATTRIBUTES[] = {
+    {0, 3, MESH_POSITION},
+    {1, 3, MESH_COLOR},
+    {2, 2, MESH_TEXCOORD},
 };
 
-GLuint INDICES[] = {
-    0, 1, 3, // First Triangle
-    1, 2, 3, // Second Triangle
+enum {
+    UNIFORM_TEXTURES,
+    UNIFORM_COUNT,
 };
 
-GLuint VAO, VBO, EBO;
-GLuint PROGRAM;
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "textures",
+};
 
-GLuint TEXTURE0, TEXTURE1;
+// Both images are 512x512 and become the layers of one texture array, so the
+// quad samples them from a single bound texture.
+#define TEXTURE_LAYER_COUNT 2
 
-static void
-init(void) {
-    PROGRAM = compile_program_raw(VERTEX_SHADER, FRAGMENT_SHADER);
+const char *TEXTURE_PATHS[TEXTURE_LAYER_COUNT] = {
+    "container.jpg",
+    "awesomeface.png",
+};
 
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+GLuint VAO, VBO, EBO;
+PackedMesh MESH;
+Program PROGRAM, FALLBACK_PROGRAM;
+ShaderWatcher SHADER_WATCHER;
 
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VERTICES), VERTICES, GL_STATIC_DRAW);
+TextureLoader TEXTURE_LOADER;
+int TEXTURES;
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(0);
+FramePacer FRAME_PACER;
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
-                          (GLvoid *)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
+// Set from --trace before init().
+const char *TRACE_PATH;
+Profiler PROFILER;
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
-                          (GLvoid *)(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
+static void
+init(void) {
+    init_profiler(&PROFILER, TRACE_PATH);
+
+    // Decoding starts right away on the loader's worker threads and overlaps
+    // with shader compilation below.
+    init_texture_loader(&TEXTURE_LOADER, DEFAULT_TEXTURE_UPLOAD_BUDGET);
+    TEXTURES = request_streamed_texture_array(&TEXTURE_LOADER, TEXTURE_PATHS,
+                                              TEXTURE_LAYER_COUNT);
+
+    // Submit the real program first so the driver compiles it in the
+    // background while the fallback is built.
+    init_shader_watcher(&SHADER_WATCHER);
+    submit_watched_program(&SHADER_WATCHER, &PROGRAM, "textures.vert",
+                           "textures.frag", UNIFORM_NAMES, UNIFORM_COUNT);
+    FALLBACK_PROGRAM = create_program(FALLBACK_VERTEX_SHADER,
+                                      FALLBACK_FRAGMENT_SHADER, 0, 0);
+    if (PROGRAM.status != PROGRAM_COMPILING) {
+        print_program_cache_report();
+    }
 
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(INDICES), INDICES,
-                 GL_STATIC_DRAW);
+    pack_mesh(&MESH, TEXTURES_VERTICES, TEXTURES_VERTEX_COUNT, ATTRIBUTES, 3,
+              TEXTURES_INDICES, TEXTURES_INDEX_COUNT, true);
+    upload_packed_mesh(&MESH, &VAO, &VBO, &EBO);
+    free_packed_mesh(&MESH);
 
-    glBindVertexArray(0);
+    bind_vertex_array(0);
 
 #if 0
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 #endif
+}
 
-    int image_width, image_height;
-    unsigned char *image = SOIL_load_image("container.jpg",
-                                           &image_width,
-                                           &image_height,
-                                           0, SOIL_LOAD_RGB);
-    glGenTextures(1, &TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, TEXTURE0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0,
-                 GL_RGB, GL_UNSIGNED_BYTE, image);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    SOIL_free_image_data(image);
-
-    image = SOIL_load_image("awesomeface.png", &image_width, &image_height, 0,
-                            SOIL_LOAD_RGB);
-    glGenTextures(1, &TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, TEXTURE1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0,
-                 GL_RGB, GL_UNSIGNED_BYTE, image);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    SOIL_free_image_data(image);
+static void
+render(void) {
+    update_profiler(&PROFILER);
+
+    begin_zone(&PROFILER, "clear");
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    end_zone(&PROFILER);
+
+    begin_zone(&PROFILER, "texture upload");
+    update_texture_loader(&TEXTURE_LOADER);
+    end_zone(&PROFILER);
+
+    begin_zone(&PROFILER, "shader reload");
+    update_shader_watcher(&SHADER_WATCHER);
+    if (PROGRAM.status == PROGRAM_COMPILING && poll_program(&PROGRAM)) {
+        print_program_cache_report();
+    }
+    end_zone(&PROFILER);
+
+    begin_zone(&PROFILER, "bind program");
+    if (PROGRAM.status == PROGRAM_READY) {
+        use_program(PROGRAM.id);
+
+        // textures was bound to unit 0 when the program was linked. The id
+        // only changes once, from the placeholder to the finished array, so
+        // gl_state.h skips this bind on every other frame.
+        active_texture(GL_TEXTURE0);
+        bind_texture(GL_TEXTURE_2D_ARRAY,
+                     get_streamed_texture_array(&TEXTURE_LOADER, TEXTURES));
+    } else {
+        use_program(FALLBACK_PROGRAM.id);
+    }
+    end_zone(&PROFILER);
 
+    begin_zone(&PROFILER, "draw");
+    bind_vertex_array(VAO);
+    glDrawElements(GL_TRIANGLES, MESH.index_count, MESH.index_type, 0);
+    end_zone(&PROFILER);
+}
+
+static void
+cleanup(void) {
+    shutdown_texture_loader(&TEXTURE_LOADER);
+    close_profiler(&PROFILER);
 }
 
 int
-main(void) {
+main(int argc, char **argv) {
+    TRACE_PATH = parse_trace_path(argc, argv);
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.shutdown = cleanup;
+        return run_headless("textures", &headless, init, render);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("Failed to initialize SDL: %s\n", SDL_GetError());
         return -1;
@@ -168,10 +224,16 @@ main(void) {
 
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
+    FramePacerOptions pacing;
+    parse_frame_pacer_options(argc, argv, &pacing);
+    init_frame_pacer(&FRAME_PACER, &pacing);
+
     init();
 
     bool running = true;
     while (running) {
+        begin_frame(&FRAME_PACER);
+
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             switch (e.type) {
@@ -189,25 +251,16 @@ main(void) {
             }
         }
 
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glUseProgram(PROGRAM);
+        render();
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, TEXTURE0);
-        glUniform1i(glGetUniformLocation(PROGRAM, "texture0"), 0);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, TEXTURE1);
-        glUniform1i(glGetUniformLocation(PROGRAM, "texture1"), 1);
+        begin_zone(&PROFILER, "swap");
+        end_frame(&FRAME_PACER, window);
+        end_zone(&PROFILER);
+    }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    cleanup();
 
-        SDL_GL_SwapWindow(window);
-    }
+    print_frame_pacer_report(&FRAME_PACER);
 
     SDL_GL_DeleteContext(glcontext);
     SDL_DestroyWindow(window);
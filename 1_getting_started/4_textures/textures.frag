@@ -0,0 +1,15 @@
+#version 330 core
+
+// Layer 0 holds the container and layer 1 the face.
+uniform sampler2DArray textures;
+
+in vec3 vertex_color;
+in vec2 vertex_texcoord;
+
+out vec4 color;
+
+void main() {
+    color = mix(texture(textures, vec3(vertex_texcoord, 0.0)),
+                texture(textures, vec3(vertex_texcoord, 1.0)),
+                0.2);
+}
@@ -0,0 +1,25 @@
+#ifndef TEXTURES_GEOMETRY_H
+#define TEXTURES_GEOMETRY_H
+
+// The textured quad drawn by textures.c. Benchmarks that draw the same quad
+// include this instead of keeping their own copy, so they follow the sample.
+
+GLfloat TEXTURES_VERTICES[] = {
+    // Positions       // Colors         // Texture Coords
+    0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, // Top Right
+    0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, // Bottom Right
+   -0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // Bottom Left
+   -0.5f,  0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, // Top Left
+};
+
+#define TEXTURES_VERTEX_COUNT 4
+#define TEXTURES_VERTEX_STRIDE 8
+
+GLuint TEXTURES_INDICES[] = {
+    0, 1, 3, // First Triangle
+    1, 2, 3, // Second Triangle
+};
+
+#define TEXTURES_INDEX_COUNT 6
+
+#endif
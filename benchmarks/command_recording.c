@@ -0,0 +1,385 @@
+// Multi-threaded draw recording with one GL submission thread.
+//
+// A scene of moving objects is traversed every frame by the job system
+// (common/job_system.h): each job animates and culls a batch of objects and
+// records a DrawPacket per visible one into its thread's CommandBuffer
+// (common/render_commands.h). The GL thread then merges and sorts the packets
+// by state and replays them. Objects use one of two programs, two shapes and
+// TEXTURE_COUNT textures, picked at random, so unsorted they would change
+// state on almost every draw.
+//
+// The report has the per-frame record, merge and submit times with --threads
+// workers, followed by a sweep that times recording alone with 1 to N
+// threads.
+//
+//   command_recording --headless --threads 4 --objects 50000
+
+#include <math.h>
+#include <stdbool.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/headless.h"
+#include "common/random.h"
+#include "common/render_commands.h"
+#include "common/shader.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_OBJECT_COUNT 50000
+#define RECORD_BATCH_SIZE 512
+#define PROGRAM_COUNT 2
+#define SHAPE_COUNT 2
+#define TEXTURE_COUNT 16
+#define SCALING_FRAMES 20
+
+char *VERTEX_SHADER = "                                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+// xy: offset, z: scale, w: rotation                                        \n\
+uniform vec4 transform;                                                     \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec2 pos;                                                                \n\
+                                                                            \n\
+out vec2 vertex_texcoord;                                                   \n\
+                                                                            \n\
+void main() {                                                               \n\
+    float c = cos(transform.w), s = sin(transform.w);                       \n\
+    vec2 p = mat2(c, s, -s, c) * pos * transform.z + transform.xy;          \n\
+    gl_Position = vec4(p, 0.0, 1.0);                                        \n\
+    vertex_texcoord = pos + 0.5;                                            \n\
+}                                                                             \
+";
+
+char *TEXTURED_FRAGMENT_SHADER = "                                            \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform vec4 color;                                                         \n\
+uniform sampler2D image;                                                    \n\
+                                                                            \n\
+in vec2 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 frag_color;                                                        \n\
+                                                                            \n\
+void main() {                                                               \n\
+    frag_color = texture(image, vertex_texcoord) * color;                   \n\
+}                                                                             \
+";
+
+char *FLAT_FRAGMENT_SHADER = "                                                \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform vec4 color;                                                         \n\
+                                                                            \n\
+out vec4 frag_color;                                                        \n\
+                                                                            \n\
+void main() {                                                               \n\
+    frag_color = color;                                                     \n\
+}                                                                             \
+";
+
+// The first two match DRAW_PACKET_TRANSFORM and DRAW_PACKET_COLOR.
+enum {
+    UNIFORM_TRANSFORM,
+    UNIFORM_COLOR,
+    UNIFORM_IMAGE,
+    UNIFORM_COUNT,
+};
+
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "transform",
+    "color",
+    "image",
+};
+
+GLfloat QUAD_VERTICES[] = {
+    0.5f,  0.5f,
+    0.5f, -0.5f,
+   -0.5f, -0.5f,
+   -0.5f,  0.5f,
+};
+
+GLushort QUAD_INDICES[] = {
+    0, 1, 3,
+    1, 2, 3,
+};
+
+GLfloat TRIANGLE_VERTICES[] = {
+    0.0f,  0.5f,
+    0.5f, -0.5f,
+   -0.5f, -0.5f,
+};
+
+GLushort TRIANGLE_INDICES[] = {
+    0, 1, 2,
+};
+
+typedef struct SceneObject {
+    GLfloat x, y;
+    GLfloat vx, vy;
+    GLfloat scale;
+    GLfloat angle;
+    GLfloat spin;
+    GLfloat color[4];
+    int program;
+    int shape;
+    int texture;
+} SceneObject;
+
+int OBJECT_COUNT = DEFAULT_OBJECT_COUNT;
+int THREAD_COUNT;
+SceneObject *OBJECTS;
+int FRAME;
+
+Program PROGRAMS[PROGRAM_COUNT];
+GLuint VAOS[SHAPE_COUNT], VBOS[SHAPE_COUNT], EBOS[SHAPE_COUNT];
+GLsizei INDEX_COUNTS[SHAPE_COUNT];
+GLuint TEXTURES[TEXTURE_COUNT];
+
+JobSystem JOBS;
+RenderQueue QUEUE;
+
+// Totals over every frame, for the report.
+double RECORD_MS, MERGE_MS, SUBMIT_MS;
+
+static void
+create_shape(int shape, GLfloat *vertices, GLsizeiptr vertices_size,
+             GLushort *indices, GLsizeiptr indices_size) {
+    glGenVertexArrays(1, &VAOS[shape]);
+    bind_vertex_array(VAOS[shape]);
+
+    glGenBuffers(1, &VBOS[shape]);
+    bind_buffer(GL_ARRAY_BUFFER, VBOS[shape]);
+    glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &EBOS[shape]);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBOS[shape]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, indices,
+                 GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    INDEX_COUNTS[shape] = indices_size / sizeof(GLushort);
+}
+
+static void
+init(void) {
+    PROGRAMS[0] = create_program(VERTEX_SHADER, TEXTURED_FRAGMENT_SHADER,
+                                 UNIFORM_NAMES, UNIFORM_COUNT);
+    PROGRAMS[1] = create_program(VERTEX_SHADER, FLAT_FRAGMENT_SHADER,
+                                 UNIFORM_NAMES, UNIFORM_COUNT);
+
+    create_shape(0, QUAD_VERTICES, sizeof(QUAD_VERTICES), QUAD_INDICES,
+                 sizeof(QUAD_INDICES));
+    create_shape(1, TRIANGLE_VERTICES, sizeof(TRIANGLE_VERTICES),
+                 TRIANGLE_INDICES, sizeof(TRIANGLE_INDICES));
+    bind_vertex_array(0);
+
+    glGenTextures(TEXTURE_COUNT, TEXTURES);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < TEXTURE_COUNT; ++i) {
+        GLubyte pixels[2 * 2 * 3];
+        for (int p = 0; p < 4; ++p) {
+            bool on = (p == 0 || p == 3);
+            pixels[p * 3 + 0] = on ? (GLubyte)(i * 16) : 40;
+            pixels[p * 3 + 1] = on ? (GLubyte)(255 - i * 16) : 40;
+            pixels[p * 3 + 2] = on ? 200 : 40;
+        }
+        bind_texture(GL_TEXTURE_2D, TEXTURES[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB,
+                     GL_UNSIGNED_BYTE, pixels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    OBJECTS = malloc(OBJECT_COUNT * sizeof(SceneObject));
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        SceneObject *object = &OBJECTS[i];
+        object->x = random_float() * 2.0f - 1.0f;
+        object->y = random_float() * 2.0f - 1.0f;
+        object->vx = (random_float() - 0.5f) * 0.01f;
+        object->vy = (random_float() - 0.5f) * 0.01f;
+        object->scale = 0.005f + random_float() * 0.02f;
+        object->angle = random_float() * 6.2831853f;
+        object->spin = (random_float() - 0.5f) * 0.1f;
+        object->color[0] = 0.5f + random_float() * 0.5f;
+        object->color[1] = 0.5f + random_float() * 0.5f;
+        object->color[2] = 0.5f + random_float() * 0.5f;
+        object->color[3] = 1.0f;
+        object->program = (int)(random_float() * PROGRAM_COUNT);
+        object->shape = (int)(random_float() * SHAPE_COUNT);
+        object->texture = (int)(random_float() * TEXTURE_COUNT);
+    }
+
+    init_job_system(&JOBS, THREAD_COUNT);
+}
+
+// Animates objects [begin, end), culls them against the viewport and records
+// a packet for each one left.
+static void
+record_objects(void *data, int begin, int end, int thread) {
+    RenderQueue *queue = data;
+    CommandBuffer *buffer = &queue->buffers[thread];
+
+    for (int i = begin; i < end; ++i) {
+        SceneObject *object = &OBJECTS[i];
+
+        object->x += object->vx;
+        object->y += object->vy;
+        if (object->x < -1.0f || object->x > 1.0f) {
+            object->vx = -object->vx;
+        }
+        if (object->y < -1.0f || object->y > 1.0f) {
+            object->vy = -object->vy;
+        }
+        object->angle += object->spin;
+
+        // A rotated shape fits in a circle of radius scale.
+        GLfloat radius = object->scale;
+        if (object->x + radius < -1.0f || object->x - radius > 1.0f ||
+            object->y + radius < -1.0f || object->y - radius > 1.0f) {
+            continue;
+        }
+
+        GLfloat pulse = 0.75f + 0.25f * sinf(FRAME * 0.05f + i * 0.01f);
+
+        DrawPacket packet;
+        packet.key = make_draw_key(object->program, object->shape,
+                                   object->texture, object->y * 0.5f + 0.5f);
+        packet.program = PROGRAMS[object->program].id;
+        packet.vertex_array = VAOS[object->shape];
+        packet.texture = TEXTURES[object->texture];
+        packet.index_count = INDEX_COUNTS[object->shape];
+        packet.uniforms = PROGRAMS[object->program].uniforms;
+        packet.transform[0] = object->x;
+        packet.transform[1] = object->y;
+        packet.transform[2] = object->scale;
+        packet.transform[3] = object->angle;
+        packet.color[0] = object->color[0] * pulse;
+        packet.color[1] = object->color[1] * pulse;
+        packet.color[2] = object->color[2] * pulse;
+        packet.color[3] = object->color[3];
+        record_draw(buffer, &packet);
+    }
+}
+
+static void
+render(void) {
+    FRAME++;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    begin_render_queue(&QUEUE);
+    run_parallel_for(&JOBS, OBJECT_COUNT, RECORD_BATCH_SIZE, record_objects,
+                     &QUEUE);
+    RECORD_MS += milliseconds_since(start);
+
+    start = SDL_GetPerformanceCounter();
+    merge_render_queue(&QUEUE);
+    MERGE_MS += milliseconds_since(start);
+
+    start = SDL_GetPerformanceCounter();
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    submit_render_queue(&QUEUE);
+    SUBMIT_MS += milliseconds_since(start);
+}
+
+static int
+compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+// Median recording time with `thread_count` threads. Runs on the calling
+// thread plus a fresh job system, with no GL involved.
+static double
+measure_recording(int thread_count) {
+    JobSystem *jobs = malloc(sizeof(JobSystem));
+    init_job_system(jobs, thread_count);
+
+    double times[SCALING_FRAMES];
+    for (int i = 0; i < SCALING_FRAMES; ++i) {
+        FRAME++;
+        Uint64 start = SDL_GetPerformanceCounter();
+        begin_render_queue(&QUEUE);
+        run_parallel_for(jobs, OBJECT_COUNT, RECORD_BATCH_SIZE,
+                         record_objects, &QUEUE);
+        times[i] = milliseconds_since(start);
+    }
+
+    shutdown_job_system(jobs);
+    free(jobs);
+
+    qsort(times, SCALING_FRAMES, sizeof(double), compare_doubles);
+    return times[SCALING_FRAMES / 2];
+}
+
+static void
+report(HeadlessReport *report) {
+    int stolen = 0;
+    for (int i = 0; i < JOBS.thread_count; ++i) {
+        stolen += JOBS.jobs_stolen[i];
+    }
+
+    printf(",\"threads\":%d,\"objects\":%d,\"draws_per_frame\":%d,"
+           "\"record_ms\":%.3f,\"merge_ms\":%.3f,\"submit_ms\":%.3f,"
+           "\"jobs_stolen\":%d",
+           JOBS.thread_count, OBJECT_COUNT, QUEUE.count,
+           RECORD_MS / report->frames, MERGE_MS / report->frames,
+           SUBMIT_MS / report->frames, stolen);
+
+    int max_threads = SDL_GetCPUCount();
+    if (max_threads > MAX_JOB_THREADS) {
+        max_threads = MAX_JOB_THREADS;
+    }
+
+    printf(",\"scaling\":[");
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; ++threads) {
+        double ms = measure_recording(threads);
+        if (threads == 1) {
+            single = ms;
+        }
+        printf("%s{\"threads\":%d,\"record_ms\":%.3f,\"speedup\":%.2f}",
+               threads > 1 ? "," : "", threads, ms,
+               ms > 0 ? single / ms : 0.0);
+    }
+    printf("]");
+}
+
+static void
+cleanup(void) {
+    shutdown_job_system(&JOBS);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--objects") == 0) {
+            OBJECT_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            THREAD_COUNT = atoi(argv[i + 1]);
+        }
+    }
+    if (OBJECT_COUNT < 1) {
+        OBJECT_COUNT = 1;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        headless.shutdown = cleanup;
+        return run_headless("command_recording", &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--threads N] [--objects N]\n", argv[0]);
+    return -1;
+}
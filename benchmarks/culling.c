@@ -0,0 +1,409 @@
+// Frustum, grid and occlusion culling of a city of boxes.
+//
+// --objects boxes are laid out on city blocks and drawn one glDrawElements
+// per box, with a camera walking a loop at street level. --cull picks what
+// runs in front of the draw calls:
+//
+//   none     every box is drawn.
+//   frustum  every box's bounding sphere is tested with cull_spheres().
+//   grid     the boxes are bucketed in a CullingGrid and whole cells are
+//            accepted or rejected before any sphere is tested.
+//
+// --occlusion adds GPU occlusion queries on top: the nearest --occluders
+// boxes are drawn first, then every other box's bounds are tested against
+// their depth and the box is drawn under conditional rendering. It works best
+// with --cull grid, which emits the boxes roughly front to back.
+//
+//   culling --headless --cull grid --occlusion --objects 50000
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/culling.h"
+#include "common/cube_mesh.h"
+#include "common/headless.h"
+#include "common/random.h"
+#include "common/shader.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_OBJECT_COUNT 50000
+#define DEFAULT_OCCLUDER_COUNT 64
+#define BLOCK_SIZE 12.0f
+#define STREET_WIDTH 6.0f
+#define GRID_CELL_SIZE 24.0f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 400.0f
+
+typedef enum CullMode {
+    CULL_NONE,
+    CULL_FRUSTUM,
+    CULL_GRID,
+} CullMode;
+
+const char *CULL_MODE_NAMES[] = {
+    "none",
+    "frustum",
+    "grid",
+};
+
+char *VERTEX_SHADER = "                                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform mat4 view_projection;                                               \n\
+uniform vec3 offset;                                                        \n\
+uniform vec3 scale;                                                         \n\
+uniform vec3 object_color;                                                  \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec3 normal;                                                             \n\
+                                                                            \n\
+out vec3 vertex_color;                                                      \n\
+                                                                            \n\
+void main() {                                                               \n\
+    gl_Position = view_projection * vec4(pos * scale + offset, 1.0);        \n\
+    vec3 light = normalize(vec3(0.4, 1.0, 0.3));                            \n\
+    float diffuse = max(dot(normal, light), 0.0);                           \n\
+    vertex_color = object_color * (0.4 + 0.6 * diffuse);                    \n\
+}                                                                             \
+";
+
+char *FRAGMENT_SHADER = "                                                     \
+#version 330 core                                                           \n\
+                                                                            \n\
+in vec3 vertex_color;                                                       \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = vec4(vertex_color, 1.0);                                        \n\
+}                                                                             \
+";
+
+enum {
+    UNIFORM_VIEW_PROJECTION,
+    UNIFORM_OFFSET,
+    UNIFORM_SCALE,
+    UNIFORM_OBJECT_COLOR,
+    UNIFORM_COUNT,
+};
+
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "view_projection",
+    "offset",
+    "scale",
+    "object_color",
+};
+
+typedef struct Objects {
+    float *x;
+    float *y;
+    float *z;
+    float *radius;
+    // Half the box's size along each axis.
+    float *half[3];
+    GLfloat (*color)[3];
+} Objects;
+
+int OBJECT_COUNT = DEFAULT_OBJECT_COUNT;
+int OCCLUDER_COUNT = DEFAULT_OCCLUDER_COUNT;
+CullMode CULL_MODE = CULL_GRID;
+bool OCCLUSION = false;
+
+Objects OBJECTS;
+CullingGrid GRID;
+OcclusionCuller OCCLUSION_CULLER;
+float CITY_SIZE;
+
+GLuint VAO, VBO, EBO;
+Program PROGRAM;
+
+int FRAME;
+// Sums over every frame rendered, for per-frame averages.
+CullingStats TOTALS;
+double CULL_MS;
+
+// A few buildings per block, blocks in a square around the origin.
+static void
+create_city(void) {
+    int count = OBJECT_COUNT;
+    OBJECTS.x = heap_alloc(count * sizeof(float));
+    OBJECTS.y = heap_alloc(count * sizeof(float));
+    OBJECTS.z = heap_alloc(count * sizeof(float));
+    OBJECTS.radius = heap_alloc(count * sizeof(float));
+    for (int axis = 0; axis < 3; ++axis) {
+        OBJECTS.half[axis] = heap_alloc(count * sizeof(float));
+    }
+    OBJECTS.color = heap_alloc(count * sizeof(*OBJECTS.color));
+
+    int buildings_per_block = 4;
+    int blocks = (count + buildings_per_block - 1) / buildings_per_block;
+    int blocks_per_side = (int)ceilf(sqrtf((float)blocks));
+    float pitch = BLOCK_SIZE + STREET_WIDTH;
+    CITY_SIZE = blocks_per_side * pitch;
+
+    for (int i = 0; i < count; ++i) {
+        int block = i / buildings_per_block;
+        int lot = i % buildings_per_block;
+        float block_x = (block % blocks_per_side) * pitch - CITY_SIZE * 0.5f;
+        float block_z = (block / blocks_per_side) * pitch - CITY_SIZE * 0.5f;
+        float lot_size = BLOCK_SIZE * 0.5f;
+
+        float width = lot_size * (0.6f + random_float() * 0.35f);
+        float depth = lot_size * (0.6f + random_float() * 0.35f);
+        float height = 2.0f + random_float() * random_float() * 30.0f;
+
+        float half_x = width * 0.5f, half_y = height * 0.5f;
+        float half_z = depth * 0.5f;
+        OBJECTS.x[i] = block_x + (lot % 2 + 0.5f) * lot_size;
+        OBJECTS.y[i] = half_y;
+        OBJECTS.z[i] = block_z + (lot / 2 + 0.5f) * lot_size;
+        OBJECTS.half[0][i] = half_x;
+        OBJECTS.half[1][i] = half_y;
+        OBJECTS.half[2][i] = half_z;
+        OBJECTS.radius[i] = sqrtf(half_x * half_x + half_y * half_y +
+                                  half_z * half_z);
+
+        float shade = 0.5f + random_float() * 0.4f;
+        OBJECTS.color[i][0] = shade;
+        OBJECTS.color[i][1] = shade * (0.9f + random_float() * 0.1f);
+        OBJECTS.color[i][2] = shade * (0.8f + random_float() * 0.2f);
+    }
+}
+
+static void
+init(void) {
+    PROGRAM = create_program(VERTEX_SHADER, FRAGMENT_SHADER, UNIFORM_NAMES,
+                             UNIFORM_COUNT);
+
+    glGenVertexArrays(1, &VAO);
+    bind_vertex_array(VAO);
+
+    glGenBuffers(1, &VBO);
+    bind_buffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES,
+                 GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat),
+                          (GLvoid *)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    glGenBuffers(1, &EBO);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBE_INDICES), CUBE_INDICES,
+                 GL_STATIC_DRAW);
+
+    bind_vertex_array(0);
+
+    create_city();
+
+    init_culling_grid(&GRID, OBJECT_COUNT);
+    build_culling_grid(&GRID, OBJECTS.x, OBJECTS.y, OBJECTS.z, OBJECTS.radius,
+                       OBJECT_COUNT, GRID_CELL_SIZE);
+
+    if (OCCLUSION && !init_occlusion_culler(&OCCLUSION_CULLER, OBJECT_COUNT)) {
+        printf("Failed to create the occlusion culler\n");
+        OCCLUSION = false;
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+}
+
+static void
+get_object_bounds(int id, Vec3 *min, Vec3 *max) {
+    Vec3 center = vec3(OBJECTS.x[id], OBJECTS.y[id], OBJECTS.z[id]);
+    Vec3 half = vec3(OBJECTS.half[0][id], OBJECTS.half[1][id],
+                     OBJECTS.half[2][id]);
+    *min = vec3_sub(center, half);
+    *max = vec3_add(center, half);
+}
+
+static void
+draw_object(int id) {
+    glUniform3f(PROGRAM.uniforms[UNIFORM_OFFSET], OBJECTS.x[id],
+                OBJECTS.y[id], OBJECTS.z[id]);
+    glUniform3f(PROGRAM.uniforms[UNIFORM_SCALE], OBJECTS.half[0][id] * 2.0f,
+                OBJECTS.half[1][id] * 2.0f, OBJECTS.half[2][id] * 2.0f);
+    glUniform3fv(PROGRAM.uniforms[UNIFORM_OBJECT_COLOR], 1,
+                 OBJECTS.color[id]);
+    glDrawElements(GL_TRIANGLES, CUBE_INDEX_COUNT, GL_UNSIGNED_SHORT, 0);
+}
+
+static void
+use_scene_program(const Mat4 *view_projection) {
+    use_program(PROGRAM.id);
+    glUniformMatrix4fv(PROGRAM.uniforms[UNIFORM_VIEW_PROJECTION], 1, GL_FALSE,
+                       view_projection->m);
+    bind_vertex_array(VAO);
+}
+
+static void
+add_culling_stats(CullingStats *total, const CullingStats *stats) {
+    total->objects += stats->objects;
+    total->cells_tested += stats->cells_tested;
+    total->cells_culled += stats->cells_culled;
+    total->cells_inside += stats->cells_inside;
+    total->objects_tested += stats->objects_tested;
+    total->objects_culled += stats->objects_culled;
+    total->objects_drawn += stats->objects_drawn;
+    total->occlusion_queries += stats->occlusion_queries;
+    total->objects_occluded += stats->objects_occluded;
+}
+
+static void
+render(void) {
+    glClearColor(0.6f, 0.7f, 0.8f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Around a loop a little inside the city, looking along it.
+    float angle = FRAME * 0.004f;
+    float loop = CITY_SIZE * 0.3f;
+    Vec3 eye = vec3(cosf(angle) * loop, 1.7f, sinf(angle) * loop);
+    Vec3 target = vec3(cosf(angle + 0.3f) * loop, 3.0f,
+                       sinf(angle + 0.3f) * loop);
+    Mat4 projection = mat4_perspective(1.0f, (float)WINDOW_WIDTH /
+                                       WINDOW_HEIGHT, CAMERA_NEAR,
+                                       CAMERA_FAR);
+    Mat4 view = mat4_look_at(eye, target, vec3(0, 1, 0));
+    Mat4 view_projection = mat4_multiply(projection, view);
+    Frustum frustum = frustum_from_matrix(view_projection);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    switch (CULL_MODE) {
+        case CULL_NONE: {
+            begin_culling(&GRID);
+            for (int slot = 0; slot < GRID.count; ++slot) {
+                GRID.visible[GRID.visible_count++] = slot;
+            }
+            GRID.stats.objects_drawn = GRID.visible_count;
+        } break;
+
+        case CULL_FRUSTUM: {
+            cull_grid_objects(&GRID, &frustum);
+        } break;
+
+        case CULL_GRID: {
+            if (OCCLUSION) {
+                sort_cells_front_to_back(&GRID, eye);
+            }
+            cull_grid(&GRID, &frustum);
+        } break;
+    }
+    CULL_MS += milliseconds_since(start);
+
+    use_scene_program(&view_projection);
+
+    if (!OCCLUSION) {
+        for (int i = 0; i < GRID.visible_count; ++i) {
+            draw_object(GRID.ids[GRID.visible[i]]);
+        }
+    } else {
+        // The nearest boxes fill the depth buffer the others are tested
+        // against.
+        int occluders = OCCLUDER_COUNT < GRID.visible_count ?
+                        OCCLUDER_COUNT : GRID.visible_count;
+        for (int i = 0; i < occluders; ++i) {
+            draw_object(GRID.ids[GRID.visible[i]]);
+        }
+
+        begin_occlusion_queries(&OCCLUSION_CULLER, &view_projection, eye,
+                                CAMERA_NEAR, &GRID.stats);
+        for (int i = occluders; i < GRID.visible_count; ++i) {
+            int id = GRID.ids[GRID.visible[i]];
+            Vec3 min, max;
+            get_object_bounds(id, &min, &max);
+            issue_occlusion_query(&OCCLUSION_CULLER, id, min, max);
+        }
+        end_occlusion_queries(&OCCLUSION_CULLER);
+
+        use_scene_program(&view_projection);
+        for (int i = occluders; i < GRID.visible_count; ++i) {
+            int id = GRID.ids[GRID.visible[i]];
+            begin_occlusion_draw(&OCCLUSION_CULLER, id);
+            draw_object(id);
+            end_occlusion_draw(&OCCLUSION_CULLER, id);
+        }
+    }
+
+    add_culling_stats(&TOTALS, &GRID.stats);
+    FRAME++;
+}
+
+static void
+report(HeadlessReport *report) {
+    (void)report;
+    double frames = FRAME > 0 ? FRAME : 1;
+    printf(",\"cull\":\"%s\",\"occlusion\":%s,\"objects\":%d,\"cells\":%d,"
+           "\"cull_ms\":%.4f,\"cells_tested\":%.1f,\"cells_culled\":%.1f,"
+           "\"cells_inside\":%.1f,\"objects_tested\":%.1f,"
+           "\"objects_culled\":%.1f,\"objects_drawn\":%.1f,"
+           "\"occlusion_queries\":%.1f,\"objects_occluded\":%.1f",
+           CULL_MODE_NAMES[CULL_MODE], OCCLUSION ? "true" : "false",
+           OBJECT_COUNT, GRID.cell_count, CULL_MS / frames,
+           TOTALS.cells_tested / frames, TOTALS.cells_culled / frames,
+           TOTALS.cells_inside / frames, TOTALS.objects_tested / frames,
+           TOTALS.objects_culled / frames, TOTALS.objects_drawn / frames,
+           TOTALS.occlusion_queries / frames,
+           TOTALS.objects_occluded / frames);
+}
+
+static void
+cleanup(void) {
+    if (OCCLUSION) {
+        free_occlusion_culler(&OCCLUSION_CULLER);
+    }
+    free_culling_grid(&GRID);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--occlusion") == 0) {
+            OCCLUSION = true;
+        } else if (i + 1 < argc) {
+            if (strcmp(argv[i], "--objects") == 0) {
+                OBJECT_COUNT = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "--occluders") == 0) {
+                OCCLUDER_COUNT = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "--cull") == 0) {
+                for (int mode = 0; mode <= CULL_GRID; ++mode) {
+                    if (strcmp(argv[i + 1], CULL_MODE_NAMES[mode]) == 0) {
+                        CULL_MODE = mode;
+                    }
+                }
+            }
+        }
+    }
+    if (OBJECT_COUNT < 1) {
+        OBJECT_COUNT = 1;
+    }
+    if (OCCLUDER_COUNT < 0) {
+        OCCLUDER_COUNT = 0;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        headless.shutdown = cleanup;
+        return run_headless("culling", &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--cull none|frustum|grid] [--occlusion] "
+           "[--occluders N] [--objects N]\n", argv[0]);
+    return -1;
+}
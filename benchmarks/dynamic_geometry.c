@@ -0,0 +1,321 @@
+// Per-frame geometry upload: persistent-mapped stream buffer versus
+// glBufferData orphaning versus plain glBufferSubData.
+//
+// Every frame rebuilds a grid of animated quads on the CPU and uploads its
+// vertices, indices and a small uniform block, then draws it:
+//
+//   stream:  everything is sub-allocated from one StreamBuffer
+//            (common/stream_buffer.h) and drawn with glDrawElementsBaseVertex.
+//   orphan:  glBufferData(..., 0, GL_STREAM_DRAW) then glBufferSubData on
+//            separate vertex, index and uniform buffers.
+//   subdata: glBufferSubData into the same buffers without orphaning, which
+//            makes the driver wait for (or copy around) the previous draw.
+//
+// The CPU-side copy is built in the frame arena (common/memory.h), so once it
+// has grown to fit a frame the report shows heap_allocs 0.
+//
+//   dynamic_geometry --headless --mode stream --quads 20000 --stream-size 4
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/headless.h"
+#include "common/shader.h"
+#include "common/stream_buffer.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_QUAD_COUNT 20000
+
+char *VERTEX_SHADER = "                                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+layout (std140) uniform Stream {                                            \n\
+    vec4 tint;                                                              \n\
+};                                                                          \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec2 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec4 color;                                                              \n\
+                                                                            \n\
+out vec4 vertex_color;                                                      \n\
+                                                                            \n\
+void main() {                                                               \n\
+    gl_Position = vec4(pos, 0.0, 1.0);                                      \n\
+    vertex_color = color * tint;                                            \n\
+}                                                                             \
+";
+
+char *FRAGMENT_SHADER = "                                                     \
+#version 330 core                                                           \n\
+                                                                            \n\
+in vec4 vertex_color;                                                       \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = vertex_color;                                                   \n\
+}                                                                             \
+";
+
+typedef enum UploadMode {
+    UPLOAD_STREAM,
+    UPLOAD_ORPHAN,
+    UPLOAD_SUBDATA,
+} UploadMode;
+
+const char *UPLOAD_MODE_NAMES[] = {
+    "stream",
+    "orphan",
+    "subdata",
+};
+
+typedef struct Vertex {
+    GLfloat pos[2];
+    GLubyte color[4];
+} Vertex;
+
+// Mirrors the std140 Stream block.
+typedef struct StreamUniforms {
+    GLfloat tint[4];
+} StreamUniforms;
+
+int QUAD_COUNT = DEFAULT_QUAD_COUNT;
+UploadMode MODE = UPLOAD_STREAM;
+GLsizeiptr STREAM_SIZE = DEFAULT_STREAM_BUFFER_SIZE;
+
+// Rebuilt in the frame arena every frame.
+Vertex *VERTICES;
+GLuint *INDICES;
+int FRAME;
+
+GLuint VAO, VBO, EBO, UBO;
+Program PROGRAM;
+UniformBlockLayout *STREAM_BLOCK;
+StreamBuffer STREAM;
+
+static void
+set_vertex_attributes(void) {
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid *)offsetof(Vertex, pos));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                          (GLvoid *)offsetof(Vertex, color));
+    glEnableVertexAttribArray(1);
+}
+
+static void
+init(void) {
+    STREAM_BLOCK = register_uniform_block("Stream", sizeof(StreamUniforms));
+    PROGRAM = create_program(VERTEX_SHADER, FRAGMENT_SHADER, 0, 0);
+
+    glGenVertexArrays(1, &VAO);
+    bind_vertex_array(VAO);
+
+    if (MODE == UPLOAD_STREAM) {
+        init_stream_buffer(&STREAM, STREAM_SIZE);
+        bind_buffer(GL_ARRAY_BUFFER, STREAM.buffer);
+        bind_buffer(GL_ELEMENT_ARRAY_BUFFER, STREAM.buffer);
+    } else {
+        glGenBuffers(1, &VBO);
+        bind_buffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, QUAD_COUNT * 4 * sizeof(Vertex), 0,
+                     GL_STREAM_DRAW);
+
+        glGenBuffers(1, &EBO);
+        bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, QUAD_COUNT * 6 * sizeof(GLuint),
+                     0, GL_STREAM_DRAW);
+
+        glGenBuffers(1, &UBO);
+        bind_buffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(StreamUniforms), 0,
+                     GL_STREAM_DRAW);
+    }
+    set_vertex_attributes();
+}
+
+// Rebuilds the grid as a ripple moving across it.
+static void
+build_geometry(void) {
+    int columns = 1;
+    while (columns * columns < QUAD_COUNT) {
+        columns++;
+    }
+    GLfloat size = 2.0f / columns;
+    GLfloat phase = FRAME * 0.05f;
+
+    for (int i = 0; i < QUAD_COUNT; ++i) {
+        int x = i % columns;
+        int y = i / columns;
+        GLfloat x0 = -1.0f + x * size;
+        GLfloat y0 = -1.0f + y * size;
+        GLfloat scale = 0.5f + 0.4f * sinf(phase + (x + y) * 0.2f);
+        GLfloat inset = size * (1.0f - scale) * 0.5f;
+        GLubyte shade = (GLubyte)(128 + 127 * scale);
+
+        Vertex *v = VERTICES + i * 4;
+        GLfloat corners[4][2] = {
+            {x0 + inset, y0 + inset},
+            {x0 + size - inset, y0 + inset},
+            {x0 + size - inset, y0 + size - inset},
+            {x0 + inset, y0 + size - inset},
+        };
+        for (int k = 0; k < 4; ++k) {
+            v[k].pos[0] = corners[k][0];
+            v[k].pos[1] = corners[k][1];
+            v[k].color[0] = shade;
+            v[k].color[1] = (GLubyte)(x * 255 / columns);
+            v[k].color[2] = (GLubyte)(y * 255 / columns);
+            v[k].color[3] = 255;
+        }
+
+        GLuint *index = INDICES + i * 6;
+        GLuint base = i * 4;
+        index[0] = base;
+        index[1] = base + 1;
+        index[2] = base + 2;
+        index[3] = base;
+        index[4] = base + 2;
+        index[5] = base + 3;
+    }
+}
+
+static void
+render(void) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    StreamUniforms uniforms = {
+        .tint = {1.0f, 0.8f + 0.2f * sinf(FRAME * 0.1f), 1.0f, 1.0f},
+    };
+    GLsizeiptr vertex_bytes = QUAD_COUNT * 4 * sizeof(Vertex);
+    GLsizeiptr index_bytes = QUAD_COUNT * 6 * sizeof(GLuint);
+
+    VERTICES = allocate_frame_memory(vertex_bytes);
+    INDICES = allocate_frame_memory(index_bytes);
+
+    FRAME++;
+    build_geometry();
+
+    use_program(PROGRAM.id);
+    bind_vertex_array(VAO);
+
+    if (MODE == UPLOAD_STREAM) {
+        begin_stream_frame(&STREAM);
+
+        GLintptr vertex_offset, index_offset, uniform_offset;
+        void *vertices = allocate_stream_vertices(&STREAM, QUAD_COUNT * 4,
+                                                  sizeof(Vertex),
+                                                  &vertex_offset);
+        if (vertices) {
+            memcpy(vertices, VERTICES, vertex_bytes);
+        }
+        void *indices = allocate_stream_indices(&STREAM, QUAD_COUNT * 6,
+                                                sizeof(GLuint),
+                                                &index_offset);
+        if (indices) {
+            memcpy(indices, INDICES, index_bytes);
+        }
+        void *block = allocate_stream_uniforms(&STREAM, sizeof(uniforms),
+                                               &uniform_offset);
+        if (block) {
+            memcpy(block, &uniforms, sizeof(uniforms));
+        }
+        commit_stream(&STREAM);
+
+        if (vertices && indices && block) {
+            bind_buffer_range(GL_UNIFORM_BUFFER, STREAM_BLOCK->binding,
+                              STREAM.buffer, uniform_offset,
+                              sizeof(uniforms));
+            glDrawElementsBaseVertex(GL_TRIANGLES, QUAD_COUNT * 6,
+                                     GL_UNSIGNED_INT,
+                                     (GLvoid *)index_offset,
+                                     vertex_offset / sizeof(Vertex));
+        }
+
+        end_stream_frame(&STREAM);
+        return;
+    }
+
+    bool orphan = MODE == UPLOAD_ORPHAN;
+
+    bind_buffer(GL_ARRAY_BUFFER, VBO);
+    if (orphan) {
+        glBufferData(GL_ARRAY_BUFFER, vertex_bytes, 0, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_bytes, VERTICES);
+
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    if (orphan) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, 0, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_bytes, INDICES);
+
+    bind_buffer(GL_UNIFORM_BUFFER, UBO);
+    if (orphan) {
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(uniforms), 0, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uniforms), &uniforms);
+    bind_buffer_range(GL_UNIFORM_BUFFER, STREAM_BLOCK->binding, UBO, 0,
+                      sizeof(uniforms));
+
+    glDrawElements(GL_TRIANGLES, QUAD_COUNT * 6, GL_UNSIGNED_INT, 0);
+}
+
+static void
+report(HeadlessReport *report) {
+    GLsizeiptr bytes = QUAD_COUNT * (4 * sizeof(Vertex) + 6 * sizeof(GLuint)) +
+                       sizeof(StreamUniforms);
+    double seconds = report->cpu_ms.median / 1000.0;
+    printf(",\"mode\":\"%s\",\"quads\":%d,\"bytes_per_frame\":%ld,"
+           "\"upload_bytes_per_sec\":%.0f",
+           UPLOAD_MODE_NAMES[MODE], QUAD_COUNT, (long)bytes,
+           seconds > 0 ? bytes / seconds : 0.0);
+    if (MODE == UPLOAD_STREAM) {
+        print_stream_buffer_report(&STREAM);
+    }
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--quads") == 0) {
+            QUAD_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--stream-size") == 0) {
+            STREAM_SIZE = (GLsizeiptr)atoi(argv[i + 1]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--mode") == 0) {
+            for (int mode = 0; mode < 3; ++mode) {
+                if (strcmp(argv[i + 1], UPLOAD_MODE_NAMES[mode]) == 0) {
+                    MODE = mode;
+                }
+            }
+        }
+    }
+    if (QUAD_COUNT < 1) {
+        QUAD_COUNT = 1;
+    }
+    if (STREAM_SIZE < 1024 * 1024) {
+        STREAM_SIZE = 1024 * 1024;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        return run_headless("dynamic_geometry", &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--mode stream|orphan|subdata] [--quads N] "
+           "[--stream-size MB]\n", argv[0]);
+    return -1;
+}
@@ -0,0 +1,461 @@
+// GPU-driven indirect drawing versus one draw call per object.
+//
+// --instances objects, each a cube, octahedron or sphere from one shared
+// MeshBuffer, are scattered around a camera that turns in place. --mode
+// picks how the visible ones are found and drawn:
+//
+//   loop        cull_spheres() on the CPU, then per visible object set its
+//               attributes with glVertexAttrib*() and call
+//               glDrawElementsBaseVertex(), the way a straightforward loop
+//               would.
+//   multi_draw  cull_spheres() on the CPU, then write a
+//               DrawElementsIndirectCommand per visible object and submit
+//               them with one glMultiDrawElementsIndirect().
+//   gpu         a compute shader culls every instance and writes the
+//               commands, and one multi-draw (with the count from the GPU
+//               under ARB_indirect_parameters) submits them. The CPU does
+//               no per-object work at all.
+//
+// The per-instance attributes come from the instance buffer with a divisor
+// of 1 and each command's base_instance, so the indirect modes need no
+// per-object state changes.
+//
+//   indirect_draw --headless --mode gpu --instances 100000
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/cube_mesh.h"
+#include "common/headless.h"
+#include "common/indirect_draw.h"
+#include "common/random.h"
+#include "common/shader.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_INSTANCE_COUNT 100000
+#define SPHERE_RINGS 8
+#define SPHERE_SEGMENTS 12
+#define VERTEX_FLOATS 6
+
+typedef enum DrawMode {
+    DRAW_LOOP,
+    DRAW_MULTI_DRAW,
+    DRAW_GPU,
+} DrawMode;
+
+const char *DRAW_MODE_NAMES[] = {
+    "loop",
+    "multi_draw",
+    "gpu",
+};
+
+char *VERTEX_SHADER = "                                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform mat4 view_projection;                                               \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec3 normal;                                                             \n\
+                                                                            \n\
+// xyz: centre, w: scale                                                    \n\
+layout (location = 2)                                                       \n\
+in vec4 instance_center_scale;                                              \n\
+                                                                            \n\
+layout (location = 3)                                                       \n\
+in vec4 instance_color;                                                     \n\
+                                                                            \n\
+out vec3 vertex_color;                                                      \n\
+                                                                            \n\
+void main() {                                                               \n\
+    vec3 p = pos * instance_center_scale.w + instance_center_scale.xyz;     \n\
+    gl_Position = view_projection * vec4(p, 1.0);                           \n\
+    vec3 light = normalize(vec3(0.4, 1.0, 0.3));                            \n\
+    float diffuse = max(dot(normal, light), 0.0);                           \n\
+    vertex_color = instance_color.rgb * (0.4 + 0.6 * diffuse);              \n\
+}                                                                             \
+";
+
+char *FRAGMENT_SHADER = "                                                     \
+#version 330 core                                                           \n\
+                                                                            \n\
+in vec3 vertex_color;                                                       \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = vec4(vertex_color, 1.0);                                        \n\
+}                                                                             \
+";
+
+enum {
+    UNIFORM_VIEW_PROJECTION,
+    UNIFORM_COUNT,
+};
+
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "view_projection",
+};
+
+int INSTANCE_COUNT = DEFAULT_INSTANCE_COUNT;
+DrawMode MODE = DRAW_GPU;
+
+GpuCullInstance *INSTANCES;
+// Bounding spheres of the instances for the CPU modes.
+float *CENTERS[3];
+float *RADII;
+uint8_t *VISIBLE;
+int VISIBLE_COUNT;
+
+MeshBuffer MESHES;
+IndirectRenderer RENDERER;
+GLuint INSTANCE_VBO;
+Program PROGRAM;
+
+int FRAME;
+int DRAW_CALLS;
+Frustum FRUSTUM;
+
+static void
+set_vertex(GLfloat *vertex, Vec3 pos, Vec3 normal) {
+    vertex[0] = pos.x;
+    vertex[1] = pos.y;
+    vertex[2] = pos.z;
+    vertex[3] = normal.x;
+    vertex[4] = normal.y;
+    vertex[5] = normal.z;
+}
+
+static int
+add_cube(void) {
+    // The mesh buffer takes 32-bit indices.
+    GLuint indices[CUBE_INDEX_COUNT];
+    for (int i = 0; i < CUBE_INDEX_COUNT; ++i) {
+        indices[i] = CUBE_INDICES[i];
+    }
+    return add_mesh_to_buffer(&MESHES, CUBE_VERTICES, CUBE_VERTEX_COUNT,
+                              indices, CUBE_INDEX_COUNT);
+}
+
+// Flat shaded, so three vertices per face.
+static int
+add_octahedron(void) {
+    Vec3 corners[6] = {
+        {0.6f, 0, 0}, {-0.6f, 0, 0}, {0, 0.6f, 0},
+        {0, -0.6f, 0}, {0, 0, 0.6f}, {0, 0, -0.6f},
+    };
+    GLfloat vertices[24 * VERTEX_FLOATS];
+    GLuint indices[24];
+
+    int vertex = 0;
+    for (int face = 0; face < 8; ++face) {
+        Vec3 x = corners[face & 1 ? 1 : 0];
+        Vec3 y = corners[face & 2 ? 3 : 2];
+        Vec3 z = corners[face & 4 ? 5 : 4];
+        // Counter-clockwise from outside, whichever octant this is.
+        if ((face & 1) ^ ((face >> 1) & 1) ^ ((face >> 2) & 1)) {
+            Vec3 swap = y;
+            y = z;
+            z = swap;
+        }
+        Vec3 normal = vec3_normalize(vec3_cross(vec3_sub(y, x),
+                                                vec3_sub(z, x)));
+        Vec3 points[3] = {x, y, z};
+        for (int i = 0; i < 3; ++i) {
+            set_vertex(&vertices[vertex * VERTEX_FLOATS], points[i], normal);
+            indices[vertex] = vertex;
+            vertex++;
+        }
+    }
+
+    return add_mesh_to_buffer(&MESHES, vertices, 24, indices, 24);
+}
+
+static int
+add_sphere(void) {
+    GLfloat vertices[(SPHERE_RINGS + 1) * (SPHERE_SEGMENTS + 1) *
+                     VERTEX_FLOATS];
+    GLuint indices[SPHERE_RINGS * SPHERE_SEGMENTS * 6];
+
+    int vertex_count = 0;
+    for (int ring = 0; ring <= SPHERE_RINGS; ++ring) {
+        float theta = ring * 3.14159265f / SPHERE_RINGS;
+        for (int segment = 0; segment <= SPHERE_SEGMENTS; ++segment) {
+            float phi = segment * 6.28318531f / SPHERE_SEGMENTS;
+            Vec3 normal = vec3(sinf(theta) * cosf(phi), cosf(theta),
+                               -sinf(theta) * sinf(phi));
+            set_vertex(&vertices[vertex_count * VERTEX_FLOATS],
+                       vec3_scale(normal, 0.5f), normal);
+            vertex_count++;
+        }
+    }
+
+    int index_count = 0;
+    for (int ring = 0; ring < SPHERE_RINGS; ++ring) {
+        for (int segment = 0; segment < SPHERE_SEGMENTS; ++segment) {
+            GLuint a = ring * (SPHERE_SEGMENTS + 1) + segment;
+            GLuint b = a + SPHERE_SEGMENTS + 1;
+            indices[index_count++] = a;
+            indices[index_count++] = b;
+            indices[index_count++] = a + 1;
+            indices[index_count++] = a + 1;
+            indices[index_count++] = b;
+            indices[index_count++] = b + 1;
+        }
+    }
+
+    return add_mesh_to_buffer(&MESHES, vertices, vertex_count, indices,
+                              index_count);
+}
+
+static void
+create_instances(void) {
+    INSTANCES = heap_alloc(INSTANCE_COUNT * sizeof(GpuCullInstance));
+    for (int axis = 0; axis < 3; ++axis) {
+        CENTERS[axis] = heap_alloc(INSTANCE_COUNT * sizeof(float));
+    }
+    RADII = heap_alloc(INSTANCE_COUNT * sizeof(float));
+    VISIBLE = heap_alloc(INSTANCE_COUNT);
+
+    for (int i = 0; i < INSTANCE_COUNT; ++i) {
+        GpuCullInstance *instance = &INSTANCES[i];
+        instance->center[0] = random_float() * 200.0f - 100.0f;
+        instance->center[1] = random_float() * 200.0f - 100.0f;
+        instance->center[2] = random_float() * 200.0f - 100.0f;
+        instance->scale = 0.5f + random_float() * 1.5f;
+        instance->mesh = (GLuint)(random_float() * MESHES.range_count);
+
+        GLubyte color[4] = {
+            (GLubyte)(128 + random_float() * 127),
+            (GLubyte)(128 + random_float() * 127),
+            (GLubyte)(128 + random_float() * 127),
+            255,
+        };
+        memcpy(&instance->data[0], color, sizeof(color));
+        instance->data[1] = 0;
+        instance->data[2] = 0;
+
+        CENTERS[0][i] = instance->center[0];
+        CENTERS[1][i] = instance->center[1];
+        CENTERS[2][i] = instance->center[2];
+        RADII[i] = MESHES.ranges[instance->mesh].radius * instance->scale;
+    }
+}
+
+static void
+init(void) {
+    PROGRAM = create_program(VERTEX_SHADER, FRAGMENT_SHADER, UNIFORM_NAMES,
+                             UNIFORM_COUNT);
+
+    init_mesh_buffer(&MESHES, VERTEX_FLOATS * sizeof(GLfloat), 1024, 1024);
+    add_cube();
+    add_octahedron();
+    add_sphere();
+
+    create_instances();
+
+    if (MODE != DRAW_LOOP &&
+        !init_indirect_renderer(&RENDERER, &MESHES, INSTANCE_COUNT)) {
+        MODE = DRAW_LOOP;
+    }
+    if (MODE == DRAW_GPU && !RENDERER.gpu_culling) {
+        printf("GPU culling is not supported, using multi_draw\n");
+        MODE = DRAW_MULTI_DRAW;
+    }
+
+    bind_vertex_array(MESHES.vao);
+    bind_buffer(GL_ARRAY_BUFFER, MESHES.vbo);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+                          VERTEX_FLOATS * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+                          VERTEX_FLOATS * sizeof(GLfloat),
+                          (GLvoid *)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    // The culling shader reads the same buffer as an SSBO.
+    glGenBuffers(1, &INSTANCE_VBO);
+    bind_buffer(GL_ARRAY_BUFFER, INSTANCE_VBO);
+    glBufferData(GL_ARRAY_BUFFER, INSTANCE_COUNT * sizeof(GpuCullInstance),
+                 INSTANCES, GL_STATIC_DRAW);
+
+    // The loop sets these with glVertexAttrib*() instead.
+    if (MODE != DRAW_LOOP) {
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE,
+                              sizeof(GpuCullInstance),
+                              (GLvoid *)offsetof(GpuCullInstance, center));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(2);
+
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              sizeof(GpuCullInstance),
+                              (GLvoid *)offsetof(GpuCullInstance, data));
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(3);
+    }
+
+    bind_vertex_array(0);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+}
+
+static void
+draw_loop(void) {
+    for (int i = 0; i < INSTANCE_COUNT; ++i) {
+        if (!VISIBLE[i]) {
+            continue;
+        }
+        GpuCullInstance *instance = &INSTANCES[i];
+        const MeshRange *range = &MESHES.ranges[instance->mesh];
+        glVertexAttrib4f(2, instance->center[0], instance->center[1],
+                         instance->center[2], instance->scale);
+        glVertexAttrib4Nubv(3, (const GLubyte *)instance->data);
+        glDrawElementsBaseVertex(GL_TRIANGLES, range->index_count,
+                                 GL_UNSIGNED_INT,
+                                 (GLvoid *)(range->first_index *
+                                            sizeof(GLuint)),
+                                 range->base_vertex);
+    }
+    DRAW_CALLS = VISIBLE_COUNT;
+}
+
+static void
+draw_multi_draw(void) {
+    DrawElementsIndirectCommand *commands = allocate_frame_memory(
+        VISIBLE_COUNT * sizeof(DrawElementsIndirectCommand));
+    int count = 0;
+    for (int i = 0; i < INSTANCE_COUNT; ++i) {
+        if (VISIBLE[i]) {
+            commands[count++] = make_draw_command(&MESHES, INSTANCES[i].mesh,
+                                                  1, i);
+        }
+    }
+    submit_draw_commands(&RENDERER, commands, count);
+    draw_indirect(&RENDERER, &MESHES);
+    DRAW_CALLS = 1;
+}
+
+static void
+render(void) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    float angle = FRAME * 0.01f;
+    Mat4 projection = mat4_perspective(1.0f, (float)WINDOW_WIDTH /
+                                       WINDOW_HEIGHT, 0.1f, 150.0f);
+    Mat4 view = mat4_look_at(vec3(0, 0, 0),
+                             vec3(cosf(angle), 0.2f, sinf(angle)),
+                             vec3(0, 1, 0));
+    Mat4 view_projection = mat4_multiply(projection, view);
+    FRUSTUM = frustum_from_matrix(view_projection);
+
+    if (MODE == DRAW_GPU) {
+        cull_instances_on_gpu(&RENDERER, &FRUSTUM, INSTANCE_VBO,
+                              INSTANCE_COUNT);
+    } else {
+        VISIBLE_COUNT = cull_spheres(&FRUSTUM, CENTERS[0], CENTERS[1],
+                                     CENTERS[2], RADII, VISIBLE,
+                                     INSTANCE_COUNT);
+    }
+
+    use_program(PROGRAM.id);
+    glUniformMatrix4fv(PROGRAM.uniforms[UNIFORM_VIEW_PROJECTION], 1, GL_FALSE,
+                       view_projection.m);
+    bind_vertex_array(MESHES.vao);
+
+    switch (MODE) {
+        case DRAW_LOOP: {
+            draw_loop();
+        } break;
+
+        case DRAW_MULTI_DRAW: {
+            draw_multi_draw();
+        } break;
+
+        case DRAW_GPU: {
+            draw_indirect(&RENDERER, &MESHES);
+            DRAW_CALLS = 1;
+        } break;
+    }
+
+    FRAME++;
+}
+
+// The GPU's visible count is read back once, here, and checked against the
+// CPU's for the same frustum.
+static void
+report(HeadlessReport *report) {
+    double seconds = report->cpu_ms.median / 1000.0;
+    int cpu_visible = cull_spheres(&FRUSTUM, CENTERS[0], CENTERS[1],
+                                   CENTERS[2], RADII, VISIBLE,
+                                   INSTANCE_COUNT);
+    int visible = MODE == DRAW_GPU ? read_gpu_visible_count(&RENDERER) :
+                                     VISIBLE_COUNT;
+    printf(",\"mode\":\"%s\",\"instances\":%d,\"visible\":%d,"
+           "\"cpu_visible\":%d,\"draw_calls_per_frame\":%d,"
+           "\"indirect_parameters\":%s,\"instances_per_sec\":%.0f",
+           DRAW_MODE_NAMES[MODE], INSTANCE_COUNT, visible, cpu_visible,
+           DRAW_CALLS, RENDERER.indirect_parameters ? "true" : "false",
+           seconds > 0 ? INSTANCE_COUNT / seconds : 0.0);
+}
+
+static void
+cleanup(void) {
+    if (MODE != DRAW_LOOP) {
+        free_indirect_renderer(&RENDERER);
+    }
+    free_mesh_buffer(&MESHES);
+    delete_buffers(1, &INSTANCE_VBO);
+    glDeleteProgram(PROGRAM.id);
+
+    heap_free(INSTANCES);
+    for (int axis = 0; axis < 3; ++axis) {
+        heap_free(CENTERS[axis]);
+    }
+    heap_free(RADII);
+    heap_free(VISIBLE);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--instances") == 0) {
+            INSTANCE_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--mode") == 0) {
+            for (int mode = 0; mode <= DRAW_GPU; ++mode) {
+                if (strcmp(argv[i + 1], DRAW_MODE_NAMES[mode]) == 0) {
+                    MODE = mode;
+                }
+            }
+        }
+    }
+    if (INSTANCE_COUNT < 1) {
+        INSTANCE_COUNT = 1;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        headless.shutdown = cleanup;
+        return run_headless("indirect_draw", &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--mode loop|multi_draw|gpu] "
+           "[--instances N]\n", argv[0]);
+    return -1;
+}
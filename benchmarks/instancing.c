@@ -0,0 +1,279 @@
+// Instanced rendering versus one draw call per object.
+//
+// Both modes draw the textured quad from textures.c with the same VBO/EBO and
+// the same program. Per-object data (transform, colour, texture array layer)
+// lives in vertex attributes 3-5:
+//
+//   instanced: attributes come from an instance buffer with
+//              glVertexAttribDivisor(1) and everything is one
+//              glDrawElementsInstanced call.
+//   naive:     the instance arrays are left disabled and each object sets the
+//              current attribute values with glVertexAttrib*() before its own
+//              glDrawElements, the way a straightforward loop would.
+//
+//   instancing --headless --mode instanced --instances 100000
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/headless.h"
+#include "common/random.h"
+#include "common/shader.h"
+
+#include "1_getting_started/4_textures/textures_geometry.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_INSTANCE_COUNT 100000
+#define TEXTURE_LAYER_COUNT 4
+#define TEXTURE_SIZE 32
+
+char *VERTEX_SHADER = "                                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform float time;                                                         \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec3 color;                                                              \n\
+                                                                            \n\
+layout (location = 2)                                                       \n\
+in vec2 texcoord;                                                           \n\
+                                                                            \n\
+// xy: offset, z: scale, w: rotation                                        \n\
+layout (location = 3)                                                       \n\
+in vec4 instance_transform;                                                 \n\
+                                                                            \n\
+layout (location = 4)                                                       \n\
+in vec4 instance_color;                                                     \n\
+                                                                            \n\
+layout (location = 5)                                                       \n\
+in float instance_layer;                                                    \n\
+                                                                            \n\
+out vec3 vertex_color;                                                      \n\
+out vec3 vertex_texcoord;                                                   \n\
+                                                                            \n\
+void main() {                                                               \n\
+    float angle = instance_transform.w + time;                              \n\
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));  \n\
+    vec2 p = rotation * pos.xy * instance_transform.z +                     \n\
+             instance_transform.xy;                                         \n\
+    gl_Position = vec4(p, pos.z, 1.0);                                      \n\
+    vertex_color = color * instance_color.rgb;                              \n\
+    vertex_texcoord = vec3(texcoord, instance_layer);                       \n\
+}                                                                             \
+";
+
+char *FRAGMENT_SHADER = "                                                     \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2DArray layers;                                              \n\
+                                                                            \n\
+in vec3 vertex_color;                                                       \n\
+in vec3 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = texture(layers, vertex_texcoord) * vec4(vertex_color, 1.0);     \n\
+}                                                                             \
+";
+
+enum {
+    UNIFORM_TIME,
+    UNIFORM_LAYERS,
+    UNIFORM_COUNT,
+};
+
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "time",
+    "layers",
+};
+
+typedef struct InstanceData {
+    GLfloat transform[4];
+    GLubyte color[4];
+    GLfloat layer;
+} InstanceData;
+
+int INSTANCE_COUNT = DEFAULT_INSTANCE_COUNT;
+bool INSTANCED = true;
+InstanceData *INSTANCES;
+int DRAW_CALLS;
+
+GLuint VAO, VBO, EBO, INSTANCE_VBO;
+GLuint TEXTURE_ARRAY;
+Program PROGRAM;
+
+static void
+create_texture_array(void) {
+    GLubyte *pixels = malloc(TEXTURE_SIZE * TEXTURE_SIZE * 3 *
+                             TEXTURE_LAYER_COUNT);
+    for (int layer = 0; layer < TEXTURE_LAYER_COUNT; ++layer) {
+        for (int y = 0; y < TEXTURE_SIZE; ++y) {
+            for (int x = 0; x < TEXTURE_SIZE; ++x) {
+                bool on = ((x / (4 << (layer & 1))) + (y / 4)) & 1;
+                GLubyte *p = pixels + ((layer * TEXTURE_SIZE + y) *
+                                       TEXTURE_SIZE + x) * 3;
+                p[0] = on ? 255 : 40;
+                p[1] = on ? (GLubyte)(255 - layer * 60) : 40;
+                p[2] = on ? (GLubyte)(layer * 60) : 40;
+            }
+        }
+    }
+
+    glGenTextures(1, &TEXTURE_ARRAY);
+    bind_texture(GL_TEXTURE_2D_ARRAY, TEXTURE_ARRAY);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, TEXTURE_SIZE, TEXTURE_SIZE,
+                 TEXTURE_LAYER_COUNT, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+
+    free(pixels);
+}
+
+static void
+init(void) {
+    PROGRAM = create_program(VERTEX_SHADER, FRAGMENT_SHADER, UNIFORM_NAMES,
+                             UNIFORM_COUNT);
+
+    INSTANCES = malloc(INSTANCE_COUNT * sizeof(InstanceData));
+    for (int i = 0; i < INSTANCE_COUNT; ++i) {
+        InstanceData *instance = &INSTANCES[i];
+        instance->transform[0] = random_float() * 2.0f - 1.0f;
+        instance->transform[1] = random_float() * 2.0f - 1.0f;
+        instance->transform[2] = 0.01f + random_float() * 0.04f;
+        instance->transform[3] = random_float() * 6.2831853f;
+        instance->color[0] = (GLubyte)(128 + random_float() * 127);
+        instance->color[1] = (GLubyte)(128 + random_float() * 127);
+        instance->color[2] = (GLubyte)(128 + random_float() * 127);
+        instance->color[3] = 255;
+        instance->layer = (GLfloat)(int)(random_float() * TEXTURE_LAYER_COUNT);
+    }
+
+    glGenVertexArrays(1, &VAO);
+    bind_vertex_array(VAO);
+
+    glGenBuffers(1, &VBO);
+    bind_buffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(TEXTURES_VERTICES),
+                 TEXTURES_VERTICES, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
+                          (GLvoid *)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
+                          (GLvoid *)(6 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(2);
+
+    glGenBuffers(1, &EBO);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(TEXTURES_INDICES),
+                 TEXTURES_INDICES, GL_STATIC_DRAW);
+
+    if (INSTANCED) {
+        glGenBuffers(1, &INSTANCE_VBO);
+        bind_buffer(GL_ARRAY_BUFFER, INSTANCE_VBO);
+        glBufferData(GL_ARRAY_BUFFER, INSTANCE_COUNT * sizeof(InstanceData),
+                     INSTANCES, GL_STATIC_DRAW);
+
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (GLvoid *)offsetof(InstanceData, transform));
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(3);
+
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              sizeof(InstanceData),
+                              (GLvoid *)offsetof(InstanceData, color));
+        glVertexAttribDivisor(4, 1);
+        glEnableVertexAttribArray(4);
+
+        glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (GLvoid *)offsetof(InstanceData, layer));
+        glVertexAttribDivisor(5, 1);
+        glEnableVertexAttribArray(5);
+    }
+
+    bind_vertex_array(0);
+
+    create_texture_array();
+}
+
+static void
+render(void) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    use_program(PROGRAM.id);
+    glUniform1f(PROGRAM.uniforms[UNIFORM_TIME], SDL_GetTicks() / 1000.0f);
+
+    // layers was bound to unit 0 when the program was linked.
+    active_texture(GL_TEXTURE0);
+    bind_texture(GL_TEXTURE_2D_ARRAY, TEXTURE_ARRAY);
+
+    bind_vertex_array(VAO);
+    if (INSTANCED) {
+        glDrawElementsInstanced(GL_TRIANGLES, TEXTURES_INDEX_COUNT,
+                                GL_UNSIGNED_INT, 0, INSTANCE_COUNT);
+        DRAW_CALLS = 1;
+    } else {
+        for (int i = 0; i < INSTANCE_COUNT; ++i) {
+            InstanceData *instance = &INSTANCES[i];
+            glVertexAttrib4fv(3, instance->transform);
+            glVertexAttrib4Nubv(4, instance->color);
+            glVertexAttrib1f(5, instance->layer);
+            glDrawElements(GL_TRIANGLES, TEXTURES_INDEX_COUNT,
+                           GL_UNSIGNED_INT, 0);
+        }
+        DRAW_CALLS = INSTANCE_COUNT;
+    }
+}
+
+static void
+report(HeadlessReport *report) {
+    double seconds = report->cpu_ms.median / 1000.0;
+    printf(",\"mode\":\"%s\",\"instances\":%d,\"draw_calls_per_frame\":%d,"
+           "\"instances_per_sec\":%.0f",
+           INSTANCED ? "instanced" : "naive", INSTANCE_COUNT, DRAW_CALLS,
+           seconds > 0 ? INSTANCE_COUNT / seconds : 0.0);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--instances") == 0) {
+            INSTANCE_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--mode") == 0) {
+            INSTANCED = strcmp(argv[i + 1], "naive") != 0;
+        }
+    }
+    if (INSTANCE_COUNT < 1) {
+        INSTANCE_COUNT = 1;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        return run_headless(INSTANCED ? "instancing_instanced" :
+                                        "instancing_naive",
+                            &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--mode instanced|naive] [--instances N]\n",
+           argv[0]);
+    return -1;
+}
@@ -0,0 +1,579 @@
+// A bloom post-process chain built with common/render_graph.h.
+//
+// Every frame declares the same graph:
+//
+//   scene       --objects cubes, some brighter than 1 -> hdr, depth
+//   bright      hdr -> bright (half size)
+//   blur_h      bright -> bloom_h
+//   blur_v      bloom_h -> bloom
+//   depth_view  depth -> depth_view
+//   composite   hdr + bloom -> backbuffer, tone mapped
+//   overlay     depth_view -> backbuffer corner, with --debug-view only
+//
+// Nothing reads depth_view unless --debug-view adds the overlay, so the
+// depth_view pass is culled by default; with --no-bloom the composite stops
+// reading bloom and the three bloom passes are culled too. bright and bloom
+// are never alive at the same time and share one texture; --no-alias gives
+// every resource its own to compare the transient memory.
+//
+// The scene pass streams its uniforms through common/uniform_ring.h: the
+// camera block once per frame, then one Object block per cube.
+//
+//   render_graph --headless --debug-view
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/cube_mesh.h"
+#include "common/headless.h"
+#include "common/random.h"
+#include "common/render_graph.h"
+#include "common/shader.h"
+#include "common/uniform_ring.h"
+#include "common/vector_math.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_OBJECT_COUNT 200
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100.0f
+
+char *SCENE_VERTEX_SHADER = "                                                 \
+#version 330 core                                                           \n\
+                                                                            \n\
+// Uploaded once per frame.                                                 \n\
+layout (std140) uniform Camera {                                            \n\
+    mat4 view_projection;                                                   \n\
+};                                                                          \n\
+                                                                            \n\
+// Uploaded once per draw.                                                  \n\
+layout (std140) uniform Object {                                            \n\
+    vec4 offset_scale;                                                      \n\
+    vec4 object_color;                                                      \n\
+};                                                                          \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec3 normal;                                                             \n\
+                                                                            \n\
+out vec3 vertex_normal;                                                     \n\
+                                                                            \n\
+void main() {                                                               \n\
+    vec3 p = pos * offset_scale.w + offset_scale.xyz;                       \n\
+    gl_Position = view_projection * vec4(p, 1.0);                           \n\
+    vertex_normal = normal;                                                 \n\
+}                                                                             \
+";
+
+char *SCENE_FRAGMENT_SHADER = "                                               \
+#version 330 core                                                           \n\
+                                                                            \n\
+layout (std140) uniform Object {                                            \n\
+    vec4 offset_scale;                                                      \n\
+    // Values above 1 are what the bloom picks up.                          \n\
+    vec4 object_color;                                                      \n\
+};                                                                          \n\
+                                                                            \n\
+in vec3 vertex_normal;                                                      \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    vec3 light = normalize(vec3(0.4, 1.0, 0.3));                            \n\
+    float diffuse = max(dot(normalize(vertex_normal), light), 0.0);         \n\
+    color = vec4(object_color.rgb * (0.2 + 0.8 * diffuse), 1.0);            \n\
+}                                                                             \
+";
+
+char *FULLSCREEN_VERTEX_SHADER = "                                            \
+#version 330 core                                                           \n\
+                                                                            \n\
+out vec2 vertex_texcoord;                                                   \n\
+                                                                            \n\
+// One triangle covering the screen, from gl_VertexID alone.                \n\
+void main() {                                                               \n\
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);                 \n\
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);                            \n\
+    vertex_texcoord = p;                                                    \n\
+}                                                                             \
+";
+
+char *BRIGHT_FRAGMENT_SHADER = "                                              \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2D source;                                                   \n\
+                                                                            \n\
+in vec2 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    vec3 c = texture(source, vertex_texcoord).rgb;                          \n\
+    color = vec4(max(c - vec3(1.0), vec3(0.0)), 1.0);                       \n\
+}                                                                             \
+";
+
+char *BLUR_FRAGMENT_SHADER = "                                                \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2D source;                                                   \n\
+// One texel along the blur axis.                                           \n\
+uniform vec2 direction;                                                     \n\
+                                                                            \n\
+in vec2 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    float weights[5] = float[](0.227, 0.195, 0.122, 0.054, 0.016);          \n\
+    vec3 sum = texture(source, vertex_texcoord).rgb * weights[0];           \n\
+    for (int i = 1; i < 5; ++i) {                                           \n\
+        vec2 offset = direction * float(i);                                 \n\
+        sum += texture(source, vertex_texcoord + offset).rgb * weights[i];  \n\
+        sum += texture(source, vertex_texcoord - offset).rgb * weights[i];  \n\
+    }                                                                       \n\
+    color = vec4(sum, 1.0);                                                 \n\
+}                                                                             \
+";
+
+char *COMPOSITE_FRAGMENT_SHADER = "                                           \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2D scene;                                                    \n\
+uniform sampler2D bloom;                                                    \n\
+uniform float bloom_strength;                                               \n\
+                                                                            \n\
+in vec2 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    vec3 c = texture(scene, vertex_texcoord).rgb +                          \n\
+             texture(bloom, vertex_texcoord).rgb * bloom_strength;          \n\
+    c = c / (c + vec3(1.0));                                                \n\
+    color = vec4(pow(c, vec3(1.0 / 2.2)), 1.0);                             \n\
+}                                                                             \
+";
+
+char *DEPTH_VIEW_FRAGMENT_SHADER = "                                          \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2D depth;                                                    \n\
+uniform float near;                                                         \n\
+uniform float far;                                                          \n\
+                                                                            \n\
+in vec2 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    float z = texture(depth, vertex_texcoord).r * 2.0 - 1.0;                \n\
+    float distance = 2.0 * near * far / (far + near - z * (far - near));    \n\
+    color = vec4(vec3(1.0 - distance / far), 1.0);                          \n\
+}                                                                             \
+";
+
+char *COPY_FRAGMENT_SHADER = "                                                \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2D source;                                                   \n\
+                                                                            \n\
+in vec2 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = texture(source, vertex_texcoord);                               \n\
+}                                                                             \
+";
+
+// The bright pass, blur and copy shaders only share `source`.
+enum {
+    POST_UNIFORM_SOURCE,
+    POST_UNIFORM_DIRECTION,
+    POST_UNIFORM_COUNT,
+};
+
+const char *POST_UNIFORM_NAMES[POST_UNIFORM_COUNT] = {
+    "source",
+    "direction",
+};
+
+enum {
+    COMPOSITE_UNIFORM_SCENE,
+    COMPOSITE_UNIFORM_BLOOM,
+    COMPOSITE_UNIFORM_BLOOM_STRENGTH,
+    COMPOSITE_UNIFORM_COUNT,
+};
+
+const char *COMPOSITE_UNIFORM_NAMES[COMPOSITE_UNIFORM_COUNT] = {
+    "scene",
+    "bloom",
+    "bloom_strength",
+};
+
+enum {
+    DEPTH_VIEW_UNIFORM_DEPTH,
+    DEPTH_VIEW_UNIFORM_NEAR,
+    DEPTH_VIEW_UNIFORM_FAR,
+    DEPTH_VIEW_UNIFORM_COUNT,
+};
+
+const char *DEPTH_VIEW_UNIFORM_NAMES[DEPTH_VIEW_UNIFORM_COUNT] = {
+    "depth",
+    "near",
+    "far",
+};
+
+// Mirror the std140 Camera and Object blocks of the scene shaders; each
+// SceneObject is pushed to the uniform ring as is.
+typedef struct CameraUniforms {
+    GLfloat view_projection[16];
+} CameraUniforms;
+
+typedef struct SceneObject {
+    GLfloat offset_scale[4];
+    GLfloat color[4];
+} SceneObject;
+
+// Resource handles of the frame being declared, for the pass functions.
+typedef struct FrameResources {
+    int hdr;
+    int depth;
+    int bright;
+    int bloom_h;
+    int bloom;
+    int depth_view;
+} FrameResources;
+
+int OBJECT_COUNT = DEFAULT_OBJECT_COUNT;
+bool BLOOM = true;
+bool DEBUG_VIEW = false;
+bool ALIASING = true;
+
+SceneObject *OBJECTS;
+RenderGraph GRAPH;
+FrameResources RESOURCES;
+
+GLuint CUBE_VAO, CUBE_VBO, CUBE_EBO;
+// Fullscreen passes draw from gl_VertexID, but core profile still wants a
+// VAO bound.
+GLuint EMPTY_VAO;
+
+UniformRing UNIFORM_RING;
+UniformBlockLayout *CAMERA_BLOCK;
+UniformBlockLayout *OBJECT_BLOCK;
+
+Program SCENE_PROGRAM;
+Program BRIGHT_PROGRAM;
+Program BLUR_PROGRAM;
+Program COMPOSITE_PROGRAM;
+Program DEPTH_VIEW_PROGRAM;
+Program COPY_PROGRAM;
+
+int FRAME;
+
+static void
+init(void) {
+    // Registered before linking so the program's layouts are checked against
+    // the structs.
+    CAMERA_BLOCK = register_uniform_block("Camera", sizeof(CameraUniforms));
+    OBJECT_BLOCK = register_uniform_block("Object", sizeof(SceneObject));
+
+    // One camera push and one push per object each frame, every one of them
+    // padded out to the buffer offset alignment.
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    GLsizeiptr slot = (sizeof(CameraUniforms) + alignment - 1) / alignment *
+                      alignment;
+    init_uniform_ring(&UNIFORM_RING, slot * (OBJECT_COUNT + 1));
+
+    SCENE_PROGRAM = create_program(SCENE_VERTEX_SHADER, SCENE_FRAGMENT_SHADER,
+                                   0, 0);
+    BRIGHT_PROGRAM = create_program(FULLSCREEN_VERTEX_SHADER,
+                                    BRIGHT_FRAGMENT_SHADER,
+                                    POST_UNIFORM_NAMES, POST_UNIFORM_COUNT);
+    BLUR_PROGRAM = create_program(FULLSCREEN_VERTEX_SHADER,
+                                  BLUR_FRAGMENT_SHADER, POST_UNIFORM_NAMES,
+                                  POST_UNIFORM_COUNT);
+    COMPOSITE_PROGRAM = create_program(FULLSCREEN_VERTEX_SHADER,
+                                       COMPOSITE_FRAGMENT_SHADER,
+                                       COMPOSITE_UNIFORM_NAMES,
+                                       COMPOSITE_UNIFORM_COUNT);
+    DEPTH_VIEW_PROGRAM = create_program(FULLSCREEN_VERTEX_SHADER,
+                                        DEPTH_VIEW_FRAGMENT_SHADER,
+                                        DEPTH_VIEW_UNIFORM_NAMES,
+                                        DEPTH_VIEW_UNIFORM_COUNT);
+    COPY_PROGRAM = create_program(FULLSCREEN_VERTEX_SHADER,
+                                  COPY_FRAGMENT_SHADER, POST_UNIFORM_NAMES,
+                                  POST_UNIFORM_COUNT);
+
+    glGenVertexArrays(1, &CUBE_VAO);
+    bind_vertex_array(CUBE_VAO);
+
+    glGenBuffers(1, &CUBE_VBO);
+    bind_buffer(GL_ARRAY_BUFFER, CUBE_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES,
+                 GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat),
+                          (GLvoid *)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    glGenBuffers(1, &CUBE_EBO);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, CUBE_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBE_INDICES), CUBE_INDICES,
+                 GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &EMPTY_VAO);
+    bind_vertex_array(0);
+
+    OBJECTS = heap_alloc(OBJECT_COUNT * sizeof(SceneObject));
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        SceneObject *object = &OBJECTS[i];
+        object->offset_scale[0] = random_float() * 40.0f - 20.0f;
+        object->offset_scale[1] = random_float() * 10.0f - 5.0f;
+        object->offset_scale[2] = random_float() * 40.0f - 20.0f;
+        object->offset_scale[3] = 0.5f + random_float() * 1.5f;
+        // One in eight glows.
+        float brightness = random_float() < 0.125f ? 4.0f : 0.8f;
+        object->color[0] = (0.3f + random_float() * 0.7f) * brightness;
+        object->color[1] = (0.3f + random_float() * 0.7f) * brightness;
+        object->color[2] = (0.3f + random_float() * 0.7f) * brightness;
+        object->color[3] = 1.0f;
+    }
+
+    init_render_graph(&GRAPH);
+    GRAPH.aliasing = ALIASING;
+}
+
+static void
+draw_fullscreen(GLuint program, int resource) {
+    use_program(program);
+    active_texture(GL_TEXTURE0);
+    bind_texture(GL_TEXTURE_2D, get_render_texture(&GRAPH, resource));
+    bind_vertex_array(EMPTY_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void
+scene_pass(RenderGraph *graph, void *data) {
+    (void)data;
+
+    float angle = FRAME * 0.01f;
+    Vec3 eye = vec3(cosf(angle) * 30.0f, 8.0f, sinf(angle) * 30.0f);
+    Mat4 projection = mat4_perspective(1.0f, (float)graph->width /
+                                       graph->height, CAMERA_NEAR,
+                                       CAMERA_FAR);
+    Mat4 view = mat4_look_at(eye, vec3(0, 0, 0), vec3(0, 1, 0));
+    Mat4 view_projection = mat4_multiply(projection, view);
+
+    CameraUniforms camera;
+    memcpy(camera.view_projection, view_projection.m,
+           sizeof(camera.view_projection));
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    begin_uniform_ring_frame(&UNIFORM_RING);
+    GLintptr offset = push_uniforms(&UNIFORM_RING, &camera, sizeof(camera));
+    bind_uniforms(&UNIFORM_RING, CAMERA_BLOCK, offset, sizeof(camera));
+
+    use_program(SCENE_PROGRAM.id);
+    bind_vertex_array(CUBE_VAO);
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        SceneObject *object = &OBJECTS[i];
+        offset = push_uniforms(&UNIFORM_RING, object, sizeof(*object));
+        bind_uniforms(&UNIFORM_RING, OBJECT_BLOCK, offset, sizeof(*object));
+        glDrawElements(GL_TRIANGLES, CUBE_INDEX_COUNT, GL_UNSIGNED_SHORT, 0);
+    }
+    end_uniform_ring_frame(&UNIFORM_RING);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+}
+
+static void
+bright_pass(RenderGraph *graph, void *data) {
+    (void)graph;
+    FrameResources *resources = data;
+    draw_fullscreen(BRIGHT_PROGRAM.id, resources->hdr);
+}
+
+static void
+blur_h_pass(RenderGraph *graph, void *data) {
+    FrameResources *resources = data;
+    int width = graph->resources[resources->bright].width;
+    use_program(BLUR_PROGRAM.id);
+    glUniform2f(BLUR_PROGRAM.uniforms[POST_UNIFORM_DIRECTION], 1.0f / width,
+                0.0f);
+    draw_fullscreen(BLUR_PROGRAM.id, resources->bright);
+}
+
+static void
+blur_v_pass(RenderGraph *graph, void *data) {
+    FrameResources *resources = data;
+    int height = graph->resources[resources->bloom_h].height;
+    use_program(BLUR_PROGRAM.id);
+    glUniform2f(BLUR_PROGRAM.uniforms[POST_UNIFORM_DIRECTION], 0.0f,
+                1.0f / height);
+    draw_fullscreen(BLUR_PROGRAM.id, resources->bloom_h);
+}
+
+static void
+depth_view_pass(RenderGraph *graph, void *data) {
+    (void)graph;
+    FrameResources *resources = data;
+    use_program(DEPTH_VIEW_PROGRAM.id);
+    glUniform1f(DEPTH_VIEW_PROGRAM.uniforms[DEPTH_VIEW_UNIFORM_NEAR],
+                CAMERA_NEAR);
+    glUniform1f(DEPTH_VIEW_PROGRAM.uniforms[DEPTH_VIEW_UNIFORM_FAR],
+                CAMERA_FAR);
+    draw_fullscreen(DEPTH_VIEW_PROGRAM.id, resources->depth);
+}
+
+static void
+composite_pass(RenderGraph *graph, void *data) {
+    (void)graph;
+    FrameResources *resources = data;
+    use_program(COMPOSITE_PROGRAM.id);
+    glUniform1f(
+        COMPOSITE_PROGRAM.uniforms[COMPOSITE_UNIFORM_BLOOM_STRENGTH],
+        BLOOM ? 1.0f : 0.0f);
+    // bloom was bound to unit 1 when the program was linked.
+    active_texture(GL_TEXTURE1);
+    bind_texture(GL_TEXTURE_2D,
+                 BLOOM ? get_render_texture(graph, resources->bloom) : 0);
+    draw_fullscreen(COMPOSITE_PROGRAM.id, resources->hdr);
+}
+
+// Bottom right quarter of the backbuffer.
+static void
+overlay_pass(RenderGraph *graph, void *data) {
+    FrameResources *resources = data;
+    glViewport(graph->width / 2, 0, graph->width / 2, graph->height / 2);
+    draw_fullscreen(COPY_PROGRAM.id, resources->depth_view);
+}
+
+static void
+render(void) {
+    GLint backbuffer_fbo;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &backbuffer_fbo);
+
+    int width = WINDOW_WIDTH, height = WINDOW_HEIGHT;
+    RenderGraph *graph = &GRAPH;
+    FrameResources *r = &RESOURCES;
+
+    begin_render_graph(graph, width, height);
+    int backbuffer = import_render_target(graph, "backbuffer",
+                                          backbuffer_fbo);
+    r->hdr = create_render_texture(graph, "hdr", 0, 0, GL_RGBA16F);
+    r->depth = create_render_texture(graph, "depth", 0, 0,
+                                     GL_DEPTH24_STENCIL8);
+    r->bright = create_render_texture(graph, "bright", width / 2,
+                                      height / 2, GL_RGBA16F);
+    r->bloom_h = create_render_texture(graph, "bloom_h", width / 2,
+                                       height / 2, GL_RGBA16F);
+    r->bloom = create_render_texture(graph, "bloom", width / 2, height / 2,
+                                     GL_RGBA16F);
+    r->depth_view = create_render_texture(graph, "depth_view", width / 2,
+                                          height / 2, GL_RGBA8);
+
+    int pass = add_render_pass(graph, "scene", scene_pass, r);
+    write_render_resource(graph, pass, r->hdr);
+    write_render_resource(graph, pass, r->depth);
+    clear_render_pass(graph, pass, 0.02f, 0.02f, 0.04f, 1.0f);
+
+    pass = add_render_pass(graph, "bright", bright_pass, r);
+    read_render_resource(graph, pass, r->hdr);
+    write_render_resource(graph, pass, r->bright);
+
+    pass = add_render_pass(graph, "blur_h", blur_h_pass, r);
+    read_render_resource(graph, pass, r->bright);
+    write_render_resource(graph, pass, r->bloom_h);
+
+    pass = add_render_pass(graph, "blur_v", blur_v_pass, r);
+    read_render_resource(graph, pass, r->bloom_h);
+    write_render_resource(graph, pass, r->bloom);
+
+    pass = add_render_pass(graph, "depth_view", depth_view_pass, r);
+    read_render_resource(graph, pass, r->depth);
+    write_render_resource(graph, pass, r->depth_view);
+
+    pass = add_render_pass(graph, "composite", composite_pass, r);
+    read_render_resource(graph, pass, r->hdr);
+    if (BLOOM) {
+        read_render_resource(graph, pass, r->bloom);
+    }
+    write_render_resource(graph, pass, backbuffer);
+
+    if (DEBUG_VIEW) {
+        pass = add_render_pass(graph, "overlay", overlay_pass, r);
+        read_render_resource(graph, pass, r->depth_view);
+        write_render_resource(graph, pass, backbuffer);
+    }
+
+    execute_render_graph(graph);
+
+    FRAME++;
+}
+
+static void
+report(HeadlessReport *report) {
+    (void)report;
+    printf(",\"objects\":%d,\"bloom\":%s,\"debug_view\":%s,\"aliasing\":%s",
+           OBJECT_COUNT, BLOOM ? "true" : "false",
+           DEBUG_VIEW ? "true" : "false", ALIASING ? "true" : "false");
+    printf(",\"uniform_ring\":{\"frame_size\":%ld,\"peak_used\":%ld,"
+           "\"overflows\":%d}", (long)UNIFORM_RING.frame_size,
+           (long)UNIFORM_RING.peak_used, UNIFORM_RING.overflows);
+    print_render_graph_report(&GRAPH);
+}
+
+static void
+cleanup(void) {
+    free_render_graph(&GRAPH);
+    heap_free(OBJECTS);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-bloom") == 0) {
+            BLOOM = false;
+        } else if (strcmp(argv[i], "--debug-view") == 0) {
+            DEBUG_VIEW = true;
+        } else if (strcmp(argv[i], "--no-alias") == 0) {
+            ALIASING = false;
+        } else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            OBJECT_COUNT = atoi(argv[i + 1]);
+        }
+    }
+    if (OBJECT_COUNT < 1) {
+        OBJECT_COUNT = 1;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        headless.shutdown = cleanup;
+        return run_headless("render_graph", &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--no-bloom] [--debug-view] [--no-alias] "
+           "[--objects N]\n", argv[0]);
+    return -1;
+}
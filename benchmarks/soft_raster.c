@@ -0,0 +1,362 @@
+// The samples' scenes drawn by the CPU reference rasterizer
+// (common/soft_raster.h), for pixel regression checks and throughput numbers
+// on hosts without a GPU.
+//
+//   hello_triangle  the orange quad from hello_triangle.c, filled (the
+//                   sample draws it as lines)
+//   shaders         the vertex-colored triangle from shaders.c
+//   textures        the container and face from textures.c; the images are
+//                   read from --texture-dir
+//   stress          --triangles random vertex-colored triangles, --size
+//                   pixels across, for triangle and fill rate
+//
+//   soft_raster --scene shaders --write shaders.ppm
+//   soft_raster --scene shaders --compare shaders.ppm [--tolerance 1]
+//
+// Frame times and rates are printed as JSON like the headless benchmarks.
+// With --compare the exit code is non-zero if any pixel differs from the
+// golden image by more than --tolerance in any channel.
+
+#include <stdbool.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include <SOIL/SOIL.h>
+
+#include "common/headless.h"
+#include "common/random.h"
+#include "common/shader.h"
+#include "common/soft_raster.h"
+
+#include "1_getting_started/2_hello_triangle/hello_triangle_geometry.h"
+#include "1_getting_started/3_shaders/shaders_geometry.h"
+#include "1_getting_started/4_textures/textures_geometry.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_FRAMES 100
+#define DEFAULT_TRIANGLE_COUNT 100000
+#define DEFAULT_TRIANGLE_SIZE 16.0f
+
+typedef enum Scene {
+    SCENE_HELLO_TRIANGLE,
+    SCENE_SHADERS,
+    SCENE_TEXTURES,
+    SCENE_STRESS,
+    SCENE_COUNT,
+} Scene;
+
+const char *SCENE_NAMES[SCENE_COUNT] = {
+    "hello_triangle",
+    "shaders",
+    "textures",
+    "stress",
+};
+
+const float CLEAR_COLOR[4] = {0.2f, 0.3f, 0.3f, 1.0f};
+
+// The varyings of the textures scene: color, then texcoord.
+#define TEXTURES_TEXCOORD_VARYING 3
+
+typedef struct TextureUniforms {
+    SoftTexture texture0;
+    SoftTexture texture1;
+} TextureUniforms;
+
+Scene SCENE = SCENE_COUNT;
+int WIDTH = WINDOW_WIDTH;
+int HEIGHT = WINDOW_HEIGHT;
+int THREAD_COUNT;
+int FRAMES = DEFAULT_FRAMES;
+int TRIANGLE_COUNT = DEFAULT_TRIANGLE_COUNT;
+float TRIANGLE_SIZE = DEFAULT_TRIANGLE_SIZE;
+const char *TEXTURE_DIR = ".";
+const char *WRITE_PATH;
+const char *COMPARE_PATH;
+int TOLERANCE;
+
+SoftRasterizer RASTER;
+JobSystem JOBS;
+SoftDraw DRAW;
+TextureUniforms TEXTURE_UNIFORMS;
+GLfloat *STRESS_VERTICES;
+
+// hello_triangle.frag
+static void
+shade_hello_triangle(SoftFragments *fragments, const void *uniforms) {
+    (void)uniforms;
+    for (int lane = 0; lane < 4; ++lane) {
+        fragments->color[0][lane] = 1.0f;
+        fragments->color[1][lane] = 0.5f;
+        fragments->color[2][lane] = 0.2f;
+        fragments->color[3][lane] = 1.0f;
+    }
+}
+
+// textures.frag: mix of array layers 0 and 1 at the same UV, 0.2. Here each
+// layer is its own texture, sampled trilinearly with GL_REPEAT like the
+// sample's array.
+static void
+shade_textures(SoftFragments *fragments, const void *uniforms) {
+    const TextureUniforms *textures = uniforms;
+    float texel0[4][4], texel1[4][4];
+    sample_soft_texture(&textures->texture0, fragments,
+                        TEXTURES_TEXCOORD_VARYING, texel0);
+    sample_soft_texture(&textures->texture1, fragments,
+                        TEXTURES_TEXCOORD_VARYING, texel1);
+    for (int c = 0; c < 4; ++c) {
+        for (int lane = 0; lane < 4; ++lane) {
+            float x = texel0[c][lane];
+            fragments->color[c][lane] = x + (texel1[c][lane] - x) * 0.2f;
+        }
+    }
+}
+
+static void
+shade_vertex_color(SoftFragments *fragments, const void *uniforms) {
+    (void)uniforms;
+    for (int c = 0; c < 3; ++c) {
+        memcpy(fragments->color[c], fragments->varyings[c],
+               sizeof(fragments->color[c]));
+    }
+    for (int lane = 0; lane < 4; ++lane) {
+        fragments->color[3][lane] = 1.0f;
+    }
+}
+
+// Decoded as RGB like the texture loader's layers. The sample uploads the
+// baked .ctex layers instead when they exist, and those are block compressed,
+// so golden images come from the decoded path.
+static bool
+load_soft_texture(SoftTexture *texture, const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", TEXTURE_DIR, name);
+
+    int width, height;
+    unsigned char *pixels = SOIL_load_image(path, &width, &height, 0,
+                                            SOIL_LOAD_RGB);
+    if (!pixels) {
+        printf("Failed to load image %s: %s\n", path, SOIL_last_result());
+        return false;
+    }
+
+    init_soft_texture(texture, pixels, width, height, 3);
+    SOIL_free_image_data(pixels);
+
+    return true;
+}
+
+// Each triangle gets its own three vertices: position and color.
+static void
+create_stress_triangles(void) {
+    STRESS_VERTICES = heap_alloc(TRIANGLE_COUNT * 3 * 5 * sizeof(GLfloat));
+
+    float size_x = TRIANGLE_SIZE * 2.0f / WIDTH;
+    float size_y = TRIANGLE_SIZE * 2.0f / HEIGHT;
+    for (int i = 0; i < TRIANGLE_COUNT; ++i) {
+        float cx = random_float() * 2.0f - 1.0f;
+        float cy = random_float() * 2.0f - 1.0f;
+        for (int k = 0; k < 3; ++k) {
+            GLfloat *v = STRESS_VERTICES + (i * 3 + k) * 5;
+            v[0] = cx + (random_float() - 0.5f) * size_x;
+            v[1] = cy + (random_float() - 0.5f) * size_y;
+            v[2] = random_float();
+            v[3] = random_float();
+            v[4] = random_float();
+        }
+    }
+}
+
+static bool
+init(void) {
+    if (!init_soft_rasterizer(&RASTER, WIDTH, HEIGHT)) {
+        return false;
+    }
+    init_job_system(&JOBS, THREAD_COUNT);
+
+    memset(&DRAW, 0, sizeof(DRAW));
+    DRAW.texcoord_varying = -1;
+
+    switch (SCENE) {
+        case SCENE_HELLO_TRIANGLE: {
+            DRAW.vertices = HELLO_TRIANGLE_VERTICES;
+            DRAW.stride = HELLO_TRIANGLE_VERTEX_STRIDE;
+            DRAW.indices = HELLO_TRIANGLE_INDICES;
+            DRAW.index_type = GL_UNSIGNED_SHORT;
+            DRAW.count = HELLO_TRIANGLE_INDEX_COUNT;
+            DRAW.shader = shade_hello_triangle;
+        } break;
+
+        case SCENE_SHADERS: {
+            // shaders.frag: the vertex color, alpha 1
+            DRAW.vertices = SHADERS_VERTICES;
+            DRAW.stride = SHADERS_VERTEX_STRIDE;
+            DRAW.varying_offset = 3;
+            DRAW.varying_count = 3;
+            DRAW.count = SHADERS_VERTEX_COUNT;
+            DRAW.shader = shade_vertex_color;
+        } break;
+
+        case SCENE_TEXTURES: {
+            if (!load_soft_texture(&TEXTURE_UNIFORMS.texture0,
+                                   "container.jpg") ||
+                !load_soft_texture(&TEXTURE_UNIFORMS.texture1,
+                                   "awesomeface.png")) {
+                return false;
+            }
+
+            DRAW.vertices = TEXTURES_VERTICES;
+            DRAW.stride = TEXTURES_VERTEX_STRIDE;
+            DRAW.varying_offset = 3;
+            DRAW.varying_count = 5;
+            DRAW.indices = TEXTURES_INDICES;
+            DRAW.index_type = GL_UNSIGNED_INT;
+            DRAW.count = TEXTURES_INDEX_COUNT;
+            DRAW.texcoord_varying = TEXTURES_TEXCOORD_VARYING;
+            DRAW.shader = shade_textures;
+            DRAW.uniforms = &TEXTURE_UNIFORMS;
+        } break;
+
+        case SCENE_STRESS: {
+            create_stress_triangles();
+
+            DRAW.vertices = STRESS_VERTICES;
+            DRAW.stride = 5;
+            DRAW.varying_offset = 2;
+            DRAW.varying_count = 3;
+            DRAW.count = TRIANGLE_COUNT * 3;
+            DRAW.shader = shade_vertex_color;
+        } break;
+
+        default: {
+        } break;
+    }
+
+    return true;
+}
+
+static void
+render(void) {
+    soft_clear(&RASTER, CLEAR_COLOR);
+    soft_draw(&RASTER, &DRAW);
+    flush_soft_rasterizer(&RASTER, &JOBS);
+}
+
+static int
+run(void) {
+    if (!init()) {
+        return -1;
+    }
+
+    // One untimed frame to warm up the bins.
+    render();
+    reset_soft_raster_stats(&RASTER);
+
+    double *cpu_ms = heap_alloc(FRAMES * sizeof(double));
+    double total_ms = 0;
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        render();
+        cpu_ms[frame] = milliseconds_since(start);
+        total_ms += cpu_ms[frame];
+    }
+
+    int result = 0;
+    SoftImageDiff diff = {0};
+    if (WRITE_PATH && !save_soft_raster_ppm(&RASTER, WRITE_PATH)) {
+        result = -1;
+    }
+    if (COMPARE_PATH) {
+        if (!compare_soft_raster_ppm(&RASTER, COMPARE_PATH, TOLERANCE,
+                                     &diff) ||
+            diff.mismatched_pixels > 0) {
+            result = -1;
+        }
+    }
+
+    SoftRasterStats *stats = &RASTER.stats;
+    double seconds = total_ms / 1000.0;
+
+    printf("{\"sample\":\"soft_raster\",\"scene\":");
+    print_json_string(SCENE_NAMES[SCENE]);
+    printf(",\"width\":%d,\"height\":%d,\"threads\":%d,\"frames\":%d,",
+           WIDTH, HEIGHT, JOBS.thread_count, FRAMES);
+    print_frame_time_stats("cpu_ms",
+                           compute_frame_time_stats(cpu_ms, FRAMES));
+    printf(",\"triangles_per_frame\":%d,\"culled_per_frame\":%d,"
+           "\"bin_entries_per_frame\":%.0f,\"fragments_per_frame\":%.0f,"
+           "\"triangles_per_sec\":%.0f,\"fragments_per_sec\":%.0f",
+           stats->triangles / FRAMES, stats->triangles_culled / FRAMES,
+           (double)stats->bin_entries / FRAMES,
+           (double)stats->fragments / FRAMES,
+           seconds > 0 ? stats->triangles / seconds : 0.0,
+           seconds > 0 ? stats->fragments / seconds : 0.0);
+    if (COMPARE_PATH) {
+        printf(",\"golden\":");
+        print_json_string(COMPARE_PATH);
+        printf(",\"tolerance\":%d,\"mismatched_pixels\":%d,"
+               "\"max_difference\":%d",
+               TOLERANCE, diff.mismatched_pixels, diff.max_difference);
+    }
+    printf(",\"passed\":%s}\n", result == 0 ? "true" : "false");
+    fflush(stdout);
+
+    heap_free(cpu_ms);
+    shutdown_job_system(&JOBS);
+    free_soft_rasterizer(&RASTER);
+
+    return result;
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--scene") == 0) {
+            for (int scene = 0; scene < SCENE_COUNT; ++scene) {
+                if (strcmp(argv[i + 1], SCENE_NAMES[scene]) == 0) {
+                    SCENE = scene;
+                }
+            }
+        } else if (strcmp(argv[i], "--width") == 0) {
+            WIDTH = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--height") == 0) {
+            HEIGHT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            THREAD_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            FRAMES = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--triangles") == 0) {
+            TRIANGLE_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--size") == 0) {
+            TRIANGLE_SIZE = (float)atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--texture-dir") == 0) {
+            TEXTURE_DIR = argv[i + 1];
+        } else if (strcmp(argv[i], "--write") == 0) {
+            WRITE_PATH = argv[i + 1];
+        } else if (strcmp(argv[i], "--compare") == 0) {
+            COMPARE_PATH = argv[i + 1];
+        } else if (strcmp(argv[i], "--tolerance") == 0) {
+            TOLERANCE = atoi(argv[i + 1]);
+        }
+    }
+    if (FRAMES < 1) {
+        FRAMES = 1;
+    }
+    if (TRIANGLE_COUNT < 1) {
+        TRIANGLE_COUNT = 1;
+    }
+
+    if (SCENE != SCENE_COUNT) {
+        return run();
+    }
+
+    printf("Usage: %s --scene hello_triangle|shaders|textures|stress "
+           "[--width W] [--height H] [--threads N] [--frames N] "
+           "[--triangles N] [--size PIXELS] "
+           "[--texture-dir DIR] [--write PPM] [--compare PPM] "
+           "[--tolerance N]\n", argv[0]);
+    return -1;
+}
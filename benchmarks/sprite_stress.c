@@ -0,0 +1,194 @@
+// Sprite batcher stress test: draws --sprites textured quads per frame,
+// spread across SPRITE_TEXTURE_COUNT textures and two layers, and reports
+// sprites/sec and draw calls per frame alongside the usual frame times.
+//
+// With --atlas the textures are packed into one TextureAtlas instead, so the
+// batch only breaks on layer changes.
+//
+//   sprite_stress --headless --sprites 50000 --frames 500 [--atlas]
+
+#include <stdbool.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include <SOIL/SOIL.h>
+
+#include "common/headless.h"
+#include "common/random.h"
+#include "common/shader.h"
+#include "common/sprite_batch.h"
+#include "common/texture_atlas.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+#define DEFAULT_SPRITE_COUNT 50000
+#define SPRITE_TEXTURE_COUNT 8
+#define SPRITE_TEXTURE_SIZE 32
+#define SPRITE_ATLAS_SIZE 256
+
+typedef struct SpriteInstance {
+    GLfloat x, y;
+    GLfloat dx, dy;
+    GLfloat size;
+    int texture;
+    uint32_t layer;
+} SpriteInstance;
+
+int SPRITE_COUNT = DEFAULT_SPRITE_COUNT;
+SpriteInstance *INSTANCES;
+
+SpriteBatch BATCH;
+GLuint TEXTURES[SPRITE_TEXTURE_COUNT];
+
+bool USE_ATLAS;
+TextureAtlas ATLAS;
+AtlasRegion *ATLAS_REGIONS[SPRITE_TEXTURE_COUNT];
+
+// Checkerboards in distinct colours; no image files needed.
+static void
+fill_checker_pixels(int index, GLubyte *pixels) {
+    GLubyte r = (GLubyte)(64 + (index * 97) % 192);
+    GLubyte g = (GLubyte)(64 + (index * 57) % 192);
+    GLubyte b = (GLubyte)(64 + (index * 151) % 192);
+
+    for (int y = 0; y < SPRITE_TEXTURE_SIZE; ++y) {
+        for (int x = 0; x < SPRITE_TEXTURE_SIZE; ++x) {
+            bool on = ((x / 8) + (y / 8)) & 1;
+            GLubyte *p = pixels + (y * SPRITE_TEXTURE_SIZE + x) * 3;
+            p[0] = on ? r : r / 2;
+            p[1] = on ? g : g / 2;
+            p[2] = on ? b : b / 2;
+        }
+    }
+}
+
+static GLuint
+create_checker_texture(int index) {
+    GLubyte pixels[SPRITE_TEXTURE_SIZE * SPRITE_TEXTURE_SIZE * 3];
+    fill_checker_pixels(index, pixels);
+
+    GLuint result;
+    glGenTextures(1, &result);
+    bind_texture(GL_TEXTURE_2D, result);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SPRITE_TEXTURE_SIZE,
+                 SPRITE_TEXTURE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    bind_texture(GL_TEXTURE_2D, 0);
+
+    return result;
+}
+
+static void
+init(void) {
+    if (!init_sprite_batch(&BATCH, SPRITE_COUNT)) {
+        exit(-1);
+    }
+
+    if (USE_ATLAS) {
+        init_texture_atlas(&ATLAS, SPRITE_ATLAS_SIZE, 1);
+        for (int i = 0; i < SPRITE_TEXTURE_COUNT; ++i) {
+            GLubyte pixels[SPRITE_TEXTURE_SIZE * SPRITE_TEXTURE_SIZE * 3];
+            fill_checker_pixels(i, pixels);
+            int handle = add_atlas_image(&ATLAS, pixels, SPRITE_TEXTURE_SIZE,
+                                         SPRITE_TEXTURE_SIZE);
+            if (handle < 0) {
+                exit(-1);
+            }
+            ATLAS_REGIONS[i] = get_atlas_region(&ATLAS, handle);
+        }
+        print_texture_atlas_report(&ATLAS);
+    } else {
+        for (int i = 0; i < SPRITE_TEXTURE_COUNT; ++i) {
+            TEXTURES[i] = create_checker_texture(i);
+        }
+    }
+
+    INSTANCES = malloc(SPRITE_COUNT * sizeof(SpriteInstance));
+    for (int i = 0; i < SPRITE_COUNT; ++i) {
+        SpriteInstance *instance = &INSTANCES[i];
+        instance->x = random_float() * 2.0f - 1.0f;
+        instance->y = random_float() * 2.0f - 1.0f;
+        instance->dx = (random_float() - 0.5f) * 0.01f;
+        instance->dy = (random_float() - 0.5f) * 0.01f;
+        instance->size = 0.01f + random_float() * 0.03f;
+        instance->texture = (int)(random_float() * SPRITE_TEXTURE_COUNT);
+        instance->layer = random_float() < 0.5f ? 0 : 1;
+    }
+}
+
+static void
+render(void) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    begin_sprite_batch(&BATCH);
+    for (int i = 0; i < SPRITE_COUNT; ++i) {
+        SpriteInstance *instance = &INSTANCES[i];
+
+        instance->x += instance->dx;
+        instance->y += instance->dy;
+        if (instance->x < -1.0f || instance->x > 1.0f) {
+            instance->dx = -instance->dx;
+        }
+        if (instance->y < -1.0f || instance->y > 1.0f) {
+            instance->dy = -instance->dy;
+        }
+
+        if (USE_ATLAS) {
+            AtlasRegion *region = ATLAS_REGIONS[instance->texture];
+            draw_array_sprite(&BATCH, ATLAS.texture, region->layer,
+                              instance->layer, instance->x, instance->y,
+                              instance->size, instance->size,
+                              region->u0, region->v0, region->u1, region->v1,
+                              1.0f, 1.0f, 1.0f);
+        } else {
+            draw_sprite(&BATCH, TEXTURES[instance->texture], instance->layer,
+                        instance->x, instance->y, instance->size,
+                        instance->size, 0.0f, 0.0f, 1.0f, 1.0f,
+                        1.0f, 1.0f, 1.0f);
+        }
+    }
+    end_sprite_batch(&BATCH);
+}
+
+static void
+report(HeadlessReport *report) {
+    double seconds = report->cpu_ms.median / 1000.0;
+    printf(",\"atlas\":%s", USE_ATLAS ? "true" : "false");
+    printf(",\"sprites_per_frame\":%d,\"draw_calls_per_frame\":%d,"
+           "\"stalls_last_frame\":%d,\"flushes_per_frame\":%d,"
+           "\"sprites_per_sec\":%.0f",
+           BATCH.stats.sprites, BATCH.stats.draw_calls, BATCH.stats.stalls,
+           BATCH.stats.flushes,
+           seconds > 0 ? BATCH.stats.sprites / seconds : 0.0);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+            SPRITE_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--atlas") == 0) {
+            USE_ATLAS = true;
+        }
+    }
+    if (SPRITE_COUNT < 1) {
+        SPRITE_COUNT = 1;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        return run_headless("sprite_stress", &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--sprites N] [--atlas] [--frames N] "
+           "[--warmup N]\n", argv[0]);
+    return -1;
+}
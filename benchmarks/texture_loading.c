@@ -0,0 +1,180 @@
+// Compares the two ways an image can reach the GPU:
+//
+//   soil: SOIL_load_image + glTexImage2D + glGenerateMipmap
+//   ctex: mmap a baked .ctex + glCompressedTexImage2D per level
+//
+//   texture_loading [--iterations N] container.jpg awesomeface.png
+//
+// The baked file is expected next to each image with a .ctex extension (run
+// build.sh to produce them). Each iteration ends with glFinish() so the GPU
+// side of the upload is included. Prints one JSON object per image.
+
+#include <stdbool.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include <SOIL/SOIL.h>
+
+#include "common/headless.h"
+#include "common/compressed_texture.h"
+
+#define DEFAULT_ITERATIONS 20
+
+static GLuint
+load_soil_texture(const char *path) {
+    GLuint result = 0;
+
+    int image_width, image_height;
+    unsigned char *image = SOIL_load_image(path, &image_width, &image_height,
+                                           0, SOIL_LOAD_RGB);
+    if (image) {
+        glGenTextures(1, &result);
+        bind_texture(GL_TEXTURE_2D, result);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0,
+                     GL_RGB, GL_UNSIGNED_BYTE, image);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        bind_texture(GL_TEXTURE_2D, 0);
+        SOIL_free_image_data(image);
+    }
+
+    return result;
+}
+
+// Uncompressed formats are counted as the driver reports them; RGB8 is
+// usually padded to four bytes per texel.
+static long
+get_texture_memory(GLuint texture) {
+    long result = 0;
+
+    bind_texture(GL_TEXTURE_2D, texture);
+    for (GLint level = 0; ; ++level) {
+        GLint width = 0, height = 0, compressed = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH,
+                                 &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT,
+                                 &height);
+        if (width == 0 || height == 0) {
+            break;
+        }
+
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED,
+                                 &compressed);
+        if (compressed) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level,
+                                     GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            result += size;
+        } else {
+            result += (long)width * height * 4;
+        }
+    }
+    bind_texture(GL_TEXTURE_2D, 0);
+
+    return result;
+}
+
+typedef GLuint (*TextureLoadFunc)(const char *path);
+
+// Returns the GPU memory of the last texture loaded, or -1 on failure.
+static long
+measure_texture_load(TextureLoadFunc load, const char *path, int iterations,
+                     double *samples) {
+    long result = -1;
+
+    for (int i = 0; i < iterations; ++i) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        GLuint texture = load(path);
+        glFinish();
+        samples[i] = performance_counter_to_ms(SDL_GetPerformanceCounter() -
+                                               start);
+
+        if (!texture) {
+            return -1;
+        }
+
+        if (i == iterations - 1) {
+            result = get_texture_memory(texture);
+        }
+        delete_textures(1, &texture);
+    }
+
+    return result;
+}
+
+int
+main(int argc, char **argv) {
+    int iterations = DEFAULT_ITERATIONS;
+    int first_image = 1;
+
+    if (argc > 2 && strcmp(argv[1], "--iterations") == 0) {
+        iterations = atoi(argv[2]);
+        first_image = 3;
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+    if (first_image >= argc) {
+        printf("Usage: %s [--iterations N] image...\n", argv[0]);
+        return -1;
+    }
+
+    SDL_Init(SDL_INIT_TIMER);
+
+    HeadlessContext ctx;
+    if (!create_headless_context(&ctx)) {
+        destroy_headless_context(&ctx);
+        return -1;
+    }
+
+    double *soil_ms = malloc(iterations * sizeof(double));
+    double *ctex_ms = malloc(iterations * sizeof(double));
+
+    for (int i = first_image; i < argc; ++i) {
+        const char *image_path = argv[i];
+
+        char baked_path[256];
+        snprintf(baked_path, sizeof(baked_path), "%s", image_path);
+        char *extension = strrchr(baked_path, '.');
+        if (!extension || (size_t)(extension - baked_path) + 6 >
+                          sizeof(baked_path)) {
+            printf("Unsupported image path: %s\n", image_path);
+            continue;
+        }
+        strcpy(extension, ".ctex");
+
+        long soil_bytes = measure_texture_load(load_soil_texture, image_path,
+                                               iterations, soil_ms);
+        long ctex_bytes = measure_texture_load(load_compressed_texture,
+                                               baked_path, iterations,
+                                               ctex_ms);
+
+        printf("{\"image\":");
+        print_json_string(image_path);
+        printf(",\"iterations\":%d,", iterations);
+        if (soil_bytes >= 0) {
+            print_frame_time_stats("soil_ms",
+                                   compute_frame_time_stats(soil_ms,
+                                                            iterations));
+            printf(",\"soil_bytes\":%ld,", soil_bytes);
+        }
+        if (ctex_bytes >= 0) {
+            print_frame_time_stats("ctex_ms",
+                                   compute_frame_time_stats(ctex_ms,
+                                                            iterations));
+            printf(",\"ctex_bytes\":%ld,", ctex_bytes);
+        }
+        printf("\"renderer\":");
+        print_json_string((const char *)glGetString(GL_RENDERER));
+        printf("}\n");
+    }
+
+    free(soil_ms);
+    free(ctex_ms);
+
+    destroy_headless_context(&ctx);
+    SDL_Quit();
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Batch transform and frustum culling throughput for each SIMD level in
+// common/vector_math.h, against its scalar version.
+//
+// --count objects with random positions and bounding spheres are transformed
+// to clip space and culled against a perspective camera --iterations times
+// per level. Every level must reproduce the scalar results exactly.
+//
+//   vector_math --count 10000 --iterations 1000
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/memory.h"
+#include "common/random.h"
+#include "common/shader.h"
+#include "common/vector_math.h"
+
+#define DEFAULT_OBJECT_COUNT 10000
+#define DEFAULT_ITERATIONS 1000
+
+typedef struct Objects {
+    float *x;
+    float *y;
+    float *z;
+    float *radius;
+} Objects;
+
+typedef struct ClipPositions {
+    float *x;
+    float *y;
+    float *z;
+    float *w;
+} ClipPositions;
+
+int OBJECT_COUNT = DEFAULT_OBJECT_COUNT;
+int ITERATIONS = DEFAULT_ITERATIONS;
+
+static void
+alloc_clip_positions(ClipPositions *clip) {
+    clip->x = heap_alloc(OBJECT_COUNT * sizeof(float));
+    clip->y = heap_alloc(OBJECT_COUNT * sizeof(float));
+    clip->z = heap_alloc(OBJECT_COUNT * sizeof(float));
+    clip->w = heap_alloc(OBJECT_COUNT * sizeof(float));
+}
+
+static void
+free_clip_positions(ClipPositions *clip) {
+    heap_free(clip->x);
+    heap_free(clip->y);
+    heap_free(clip->z);
+    heap_free(clip->w);
+}
+
+static bool
+clip_positions_equal(const ClipPositions *a, const ClipPositions *b) {
+    size_t size = OBJECT_COUNT * sizeof(float);
+    return memcmp(a->x, b->x, size) == 0 && memcmp(a->y, b->y, size) == 0 &&
+           memcmp(a->z, b->z, size) == 0 && memcmp(a->w, b->w, size) == 0;
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--count") == 0) {
+            OBJECT_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--iterations") == 0) {
+            ITERATIONS = atoi(argv[i + 1]);
+        }
+    }
+    if (OBJECT_COUNT < 1) {
+        OBJECT_COUNT = 1;
+    }
+    if (ITERATIONS < 1) {
+        ITERATIONS = 1;
+    }
+
+    Objects objects = {
+        heap_alloc(OBJECT_COUNT * sizeof(float)),
+        heap_alloc(OBJECT_COUNT * sizeof(float)),
+        heap_alloc(OBJECT_COUNT * sizeof(float)),
+        heap_alloc(OBJECT_COUNT * sizeof(float)),
+    };
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        objects.x[i] = random_float() * 200.0f - 100.0f;
+        objects.y[i] = random_float() * 200.0f - 100.0f;
+        objects.z[i] = random_float() * 200.0f - 100.0f;
+        objects.radius[i] = 0.5f + random_float() * 1.5f;
+    }
+
+    Mat4 projection = mat4_perspective(1.0f, 16.0f / 9.0f, 0.1f, 150.0f);
+    Mat4 view = mat4_look_at(vec3(0, 0, 0), vec3(0.3f, 0.1f, -1.0f),
+                             vec3(0, 1, 0));
+    Mat4 view_projection = mat4_multiply(projection, view);
+    Frustum frustum = frustum_from_matrix(view_projection);
+
+    ClipPositions reference_clip, clip;
+    alloc_clip_positions(&reference_clip);
+    alloc_clip_positions(&clip);
+    uint8_t *reference_visible = heap_alloc(OBJECT_COUNT);
+    uint8_t *visible = heap_alloc(OBJECT_COUNT);
+
+    set_simd_level(SIMD_SCALAR);
+    transform_points(&view_projection, objects.x, objects.y, objects.z,
+                     reference_clip.x, reference_clip.y, reference_clip.z,
+                     reference_clip.w, OBJECT_COUNT);
+    int reference_count = cull_spheres(&frustum, objects.x, objects.y,
+                                       objects.z, objects.radius,
+                                       reference_visible, OBJECT_COUNT);
+
+    SimdLevel detected = detect_simd_level();
+    bool passed = true;
+    double scalar_transform_ns = 0, scalar_cull_ns = 0;
+
+    printf("{\"sample\":\"vector_math\",\"count\":%d,\"iterations\":%d,"
+           "\"detected\":\"%s\",\"visible\":%d,\"levels\":[",
+           OBJECT_COUNT, ITERATIONS, get_simd_level_name(detected),
+           reference_count);
+
+    for (int level = SIMD_SCALAR; level <= (int)detected; ++level) {
+        set_simd_level(level);
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            transform_points(&view_projection, objects.x, objects.y,
+                             objects.z, clip.x, clip.y, clip.z, clip.w,
+                             OBJECT_COUNT);
+        }
+        double transform_ns = milliseconds_since(start) * 1.0e6 /
+                              ((double)ITERATIONS * OBJECT_COUNT);
+
+        int count = 0;
+        start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            count = cull_spheres(&frustum, objects.x, objects.y, objects.z,
+                                 objects.radius, visible, OBJECT_COUNT);
+        }
+        double cull_ns = milliseconds_since(start) * 1.0e6 /
+                         ((double)ITERATIONS * OBJECT_COUNT);
+
+        bool matches = clip_positions_equal(&clip, &reference_clip) &&
+                       count == reference_count &&
+                       memcmp(visible, reference_visible, OBJECT_COUNT) == 0;
+        passed = passed && matches;
+
+        if (level == SIMD_SCALAR) {
+            scalar_transform_ns = transform_ns;
+            scalar_cull_ns = cull_ns;
+        }
+
+        printf("%s{\"simd\":\"%s\",\"transform_ns_per_object\":%.3f,"
+               "\"cull_ns_per_object\":%.3f,\"transform_speedup\":%.2f,"
+               "\"cull_speedup\":%.2f,\"matches_scalar\":%s}",
+               level > SIMD_SCALAR ? "," : "",
+               get_simd_level_name(level), transform_ns, cull_ns,
+               transform_ns > 0 ? scalar_transform_ns / transform_ns : 0.0,
+               cull_ns > 0 ? scalar_cull_ns / cull_ns : 0.0,
+               matches ? "true" : "false");
+    }
+    printf("],\"passed\":%s}\n", passed ? "true" : "false");
+
+    free_clip_positions(&reference_clip);
+    free_clip_positions(&clip);
+    heap_free(reference_visible);
+    heap_free(visible);
+    heap_free(objects.x);
+    heap_free(objects.y);
+    heap_free(objects.z);
+    heap_free(objects.radius);
+
+    return passed ? 0 : -1;
+}
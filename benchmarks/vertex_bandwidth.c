@@ -0,0 +1,244 @@
+// Vertex fetch bandwidth with full float versus packed vertex formats.
+//
+// Both modes draw the same grid mesh, with the position/color/texcoord layout
+// from textures.c, through common/mesh_packing.h:
+//
+//   float:  3 + 3 + 2 GLfloat per vertex (32 bytes) and GLuint indices.
+//   packed: half float positions, normalized GL_UNSIGNED_BYTE colors and
+//           GL_UNSIGNED_SHORT texcoords (16 bytes) and GLushort indices.
+//
+// Rasterization is discarded so the GPU time is vertex fetch and shading
+// only. The vertex shader folds every attribute into gl_Position (scaled by
+// a uniform that is always 0) so none of them can be optimized away.
+//
+// --mesh draws an OBJ or .cmesh file (common/mesh_loader.h) instead of the
+// grid, with normals in the color slot. OBJ files are drawn in file order
+// unless --optimize is given, so the two can be compared along with their
+// ACMR and ATVR.
+//
+//   vertex_bandwidth --headless --format packed --grid 256 --draws 64
+//   vertex_bandwidth --headless --mesh bunny.obj --optimize
+
+#include <stdbool.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include "common/headless.h"
+#include "common/mesh_loader.h"
+#include "common/shader.h"
+
+#define WINDOW_WIDTH 960
+#define WINDOW_HEIGHT 540
+
+// 256 x 256 vertices is the most that still fits 16-bit indices.
+#define DEFAULT_GRID_SIZE 256
+#define DEFAULT_DRAW_COUNT 64
+
+char *VERTEX_SHADER = "                                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform float zero;                                                         \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec3 color;                                                              \n\
+                                                                            \n\
+layout (location = 2)                                                       \n\
+in vec2 texcoord;                                                           \n\
+                                                                            \n\
+void main() {                                                               \n\
+    vec3 rest = color + vec3(texcoord, 0.0);                                \n\
+    gl_Position = vec4(pos + rest * zero, 1.0);                             \n\
+}                                                                             \
+";
+
+char *FRAGMENT_SHADER = "                                                     \
+#version 330 core                                                           \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = vec4(1.0);                                                      \n\
+}                                                                             \
+";
+
+enum {
+    UNIFORM_ZERO,
+    UNIFORM_COUNT,
+};
+
+const char *UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "zero",
+};
+
+MeshAttribute ATTRIBUTES[] = {
+    {0, 3, MESH_POSITION},
+    {1, 3, MESH_COLOR},
+    {2, 2, MESH_TEXCOORD},
+};
+
+int GRID_SIZE = DEFAULT_GRID_SIZE;
+int DRAW_COUNT = DEFAULT_DRAW_COUNT;
+bool PACKED = true;
+const char *MESH_PATH;
+bool OPTIMIZE;
+VertexCacheStats CACHE_STATS;
+
+PackedMesh MESH;
+GLuint VAO, VBO, EBO;
+Program PROGRAM;
+
+static bool
+load_benchmark_mesh(void) {
+    Mesh mesh;
+    if (!load_mesh(&mesh, MESH_PATH)) {
+        return false;
+    }
+    if (OPTIMIZE) {
+        optimize_mesh(&mesh);
+    }
+
+    CACHE_STATS = compute_vertex_cache_stats(mesh.indices, mesh.index_count,
+                                             mesh.vertex_count,
+                                             VERTEX_CACHE_SIZE);
+    pack_mesh(&MESH, mesh.vertices, mesh.vertex_count,
+              MESH_VERTEX_ATTRIBUTES, 3, mesh.indices, mesh.index_count,
+              PACKED);
+    free_mesh(&mesh);
+
+    return true;
+}
+
+static void
+init(void) {
+    PROGRAM = create_program(VERTEX_SHADER, FRAGMENT_SHADER, UNIFORM_NAMES,
+                             UNIFORM_COUNT);
+
+    if (MESH_PATH) {
+        if (load_benchmark_mesh()) {
+            upload_packed_mesh(&MESH, &VAO, &VBO, &EBO);
+            free_packed_mesh(&MESH);
+        }
+        glEnable(GL_RASTERIZER_DISCARD);
+        return;
+    }
+
+    int vertex_count = GRID_SIZE * GRID_SIZE;
+    GLfloat *vertices = malloc(vertex_count * 8 * sizeof(GLfloat));
+    for (int y = 0; y < GRID_SIZE; ++y) {
+        for (int x = 0; x < GRID_SIZE; ++x) {
+            GLfloat u = (GLfloat)x / (GRID_SIZE - 1);
+            GLfloat v = (GLfloat)y / (GRID_SIZE - 1);
+            GLfloat *vertex = vertices + (y * GRID_SIZE + x) * 8;
+            vertex[0] = u * 2.0f - 1.0f;
+            vertex[1] = v * 2.0f - 1.0f;
+            vertex[2] = 0.0f;
+            vertex[3] = u;
+            vertex[4] = v;
+            vertex[5] = 1.0f - u;
+            vertex[6] = u;
+            vertex[7] = v;
+        }
+    }
+
+    int quads = GRID_SIZE - 1;
+    int index_count = quads * quads * 6;
+    GLuint *indices = malloc(index_count * sizeof(GLuint));
+    GLuint *index = indices;
+    for (int y = 0; y < quads; ++y) {
+        for (int x = 0; x < quads; ++x) {
+            GLuint corner = y * GRID_SIZE + x;
+            *index++ = corner;
+            *index++ = corner + 1;
+            *index++ = corner + GRID_SIZE;
+            *index++ = corner + 1;
+            *index++ = corner + GRID_SIZE + 1;
+            *index++ = corner + GRID_SIZE;
+        }
+    }
+
+    pack_mesh(&MESH, vertices, vertex_count, ATTRIBUTES, 3, indices,
+              index_count, PACKED);
+    upload_packed_mesh(&MESH, &VAO, &VBO, &EBO);
+    free_packed_mesh(&MESH);
+
+    CACHE_STATS = compute_vertex_cache_stats(indices, index_count,
+                                             vertex_count, VERTEX_CACHE_SIZE);
+
+    free(vertices);
+    free(indices);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+}
+
+static void
+render(void) {
+    use_program(PROGRAM.id);
+    glUniform1f(PROGRAM.uniforms[UNIFORM_ZERO], 0.0f);
+
+    bind_vertex_array(VAO);
+    for (int i = 0; i < DRAW_COUNT; ++i) {
+        glDrawElements(GL_TRIANGLES, MESH.index_count, MESH.index_type, 0);
+    }
+}
+
+static void
+report(HeadlessReport *report) {
+    double seconds = report->gpu_ms.median / 1000.0;
+    double vertices = (double)MESH.vertex_count * DRAW_COUNT;
+    double bytes = ((double)MESH.vertex_count * MESH.vertex_size +
+                    (double)MESH.index_count * MESH.index_size) * DRAW_COUNT;
+
+    printf(",\"format\":\"%s\",\"vertices\":%d,\"indices\":%d,"
+           "\"draws_per_frame\":%d,\"bytes_per_vertex\":%d,"
+           "\"bytes_per_index\":%d,\"vertices_per_sec\":%.0f,"
+           "\"bytes_per_sec\":%.0f,\"acmr\":%.3f,\"atvr\":%.3f",
+           PACKED ? "packed" : "float", MESH.vertex_count, MESH.index_count,
+           DRAW_COUNT, MESH.vertex_size, MESH.index_size,
+           seconds > 0 ? vertices / seconds : 0.0,
+           seconds > 0 ? bytes / seconds : 0.0, CACHE_STATS.acmr,
+           CACHE_STATS.atvr);
+}
+
+int
+main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--grid") == 0) {
+            GRID_SIZE = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--draws") == 0) {
+            DRAW_COUNT = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--format") == 0) {
+            PACKED = strcmp(argv[i + 1], "float") != 0;
+        } else if (strcmp(argv[i], "--mesh") == 0) {
+            MESH_PATH = argv[i + 1];
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--optimize") == 0) {
+            OPTIMIZE = true;
+        }
+    }
+    if (GRID_SIZE < 2) {
+        GRID_SIZE = 2;
+    }
+    if (DRAW_COUNT < 1) {
+        DRAW_COUNT = 1;
+    }
+
+    HeadlessOptions headless;
+    if (parse_headless_options(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT,
+                               &headless)) {
+        headless.report = report;
+        return run_headless(PACKED ? "vertex_bandwidth_packed" :
+                                     "vertex_bandwidth_float",
+                            &headless, init, render);
+    }
+
+    printf("Usage: %s --headless [--format float|packed] [--grid N] "
+           "[--draws N] [--mesh path [--optimize]]\n", argv[0]);
+    return -1;
+}
@@ -1,40 +1,19 @@
 #!/bin/bash
 
-cd $(dirname $0)
-base=$(pwd)
-
-cc=gcc
-cflags="-W -Wall -g -std=c99 -I$base"
-ldflags="-lm -lSDL2 -lGLEW -lSOIL"
-srcs=(
-    $base/1_getting_started/1_hello_window/hello_window.c
-    $base/1_getting_started/2_hello_triangle/hello_triangle.c
-    $base/1_getting_started/3_shaders/shaders.c
-    $base/1_getting_started/4_textures/textures.c
-)
-
-case $OSTYPE in
-    darwin*)
-        ldflags="$ldflags -framework OpenGL"
-    ;;
+# Configures and builds everything with CMake. The first argument picks the
+# profile (Debug, Release or RelWithDebInfo); extra arguments are passed to
+# the configure step, e.g. ./build.sh Release -DLEARNOPENGL_LTO=ON.
 
-    linux*)
-        ldflags="$ldflags -lGL"
-    ;;
-
-    *)
-        echo "UNKNOWN: $OSTYPE"
-        exit
-    ;;
-esac
+cd $(dirname $0)
 
-[ ! -d "build" ] && mkdir build
+profile=${1:-RelWithDebInfo}
+shift
 
-cd build
+generator=()
+if [ ! -f build/CMakeCache.txt ] && command -v ninja > /dev/null
+then
+    generator=(-G Ninja)
+fi
 
-for src in ${srcs[@]}
-do
-    out=$(basename $src)
-    out=${out%.*}
-    $cc $cflags $src $ldflags -o $out
-done
+cmake -S . -B build "${generator[@]}" -DCMAKE_BUILD_TYPE=$profile "$@" &&
+cmake --build build --parallel
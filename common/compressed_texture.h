@@ -0,0 +1,257 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+// Baked, block-compressed textures (.ctex).
+//
+// tools/texture_baker.c decodes a source image once, builds the full mip
+// chain on the CPU and encodes every level as BC1, BC3 or BC7. At runtime the
+// file is memory-mapped and each level goes straight to
+// glCompressedTexImage2D, with no image decode and no glGenerateMipmap.
+// load_compressed_texture_array() does the same with one file per layer of a
+// GL_TEXTURE_2D_ARRAY.
+//
+// Layout: a CompressedTextureHeader followed by the level data. Offsets are
+// from the start of the file. Rows are stored in the order SOIL returns them,
+// so a baked texture samples exactly like the SOIL path.
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/gl_state.h"
+
+#define COMPRESSED_TEXTURE_MAGIC 0x58455443 // "CTEX"
+#define COMPRESSED_TEXTURE_VERSION 1
+#define COMPRESSED_TEXTURE_MAX_LEVELS 16
+#define COMPRESSED_TEXTURE_MAX_LAYERS 16
+
+typedef enum CompressedTextureFormat {
+    COMPRESSED_TEXTURE_BC1 = 1,
+    COMPRESSED_TEXTURE_BC3 = 3,
+    COMPRESSED_TEXTURE_BC7 = 7,
+} CompressedTextureFormat;
+
+typedef struct CompressedTextureLevel {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+} CompressedTextureLevel;
+
+typedef struct CompressedTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    CompressedTextureLevel levels[COMPRESSED_TEXTURE_MAX_LEVELS];
+} CompressedTextureHeader;
+
+static uint32_t
+get_compressed_block_size(uint32_t format) {
+    return format == COMPRESSED_TEXTURE_BC1 ? 8 : 16;
+}
+
+static uint32_t
+get_compressed_level_size(uint32_t format, uint32_t width, uint32_t height) {
+    return ((width + 3) / 4) * ((height + 3) / 4) *
+           get_compressed_block_size(format);
+}
+
+// Returns 0 if the driver cannot sample the format.
+static GLenum
+get_compressed_texture_gl_format(uint32_t format) {
+    switch (format) {
+        case COMPRESSED_TEXTURE_BC1: {
+            return GLEW_EXT_texture_compression_s3tc ?
+                   GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+        }
+
+        case COMPRESSED_TEXTURE_BC3: {
+            return GLEW_EXT_texture_compression_s3tc ?
+                   GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+        }
+
+        case COMPRESSED_TEXTURE_BC7: {
+            return GLEW_ARB_texture_compression_bptc ?
+                   GL_COMPRESSED_RGBA_BPTC_UNORM : 0;
+        }
+
+        default: return 0;
+    }
+}
+
+static bool
+is_compressed_texture_valid(const CompressedTextureHeader *header,
+                            size_t file_size) {
+    if (file_size < sizeof(*header) ||
+        header->magic != COMPRESSED_TEXTURE_MAGIC ||
+        header->version != COMPRESSED_TEXTURE_VERSION ||
+        header->level_count == 0 ||
+        header->level_count > COMPRESSED_TEXTURE_MAX_LEVELS) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->level_count; ++i) {
+        const CompressedTextureLevel *level = &header->levels[i];
+        if (level->size != get_compressed_level_size(header->format,
+                                                     level->width,
+                                                     level->height) ||
+            (size_t)level->offset + level->size > file_size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Maps a .ctex and checks it. Returns 0 if the file is missing or malformed;
+// otherwise the mapping is released with munmap(result, *size).
+static const CompressedTextureHeader *
+map_compressed_texture(const char *path, size_t *size) {
+    const CompressedTextureHeader *result = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            if (is_compressed_texture_valid(data, st.st_size)) {
+                result = data;
+                *size = st.st_size;
+            } else {
+                printf("Invalid compressed texture: %s\n", path);
+                munmap(data, st.st_size);
+            }
+        }
+    }
+
+    close(fd);
+
+    return result;
+}
+
+// Returns 0 if the file is missing, malformed or in a format the driver
+// does not support, so callers can fall back to decoding the source image.
+// Leaves GL_TEXTURE_2D unbound.
+static GLuint
+load_compressed_texture(const char *path) {
+    GLuint result = 0;
+
+    size_t size;
+    const CompressedTextureHeader *header = map_compressed_texture(path,
+                                                                   &size);
+    if (!header) {
+        return 0;
+    }
+
+    GLenum gl_format = get_compressed_texture_gl_format(header->format);
+    if (gl_format) {
+        glGenTextures(1, &result);
+        bind_texture(GL_TEXTURE_2D, result);
+        for (uint32_t i = 0; i < header->level_count; ++i) {
+            const CompressedTextureLevel *level = &header->levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, gl_format, level->width,
+                                   level->height, 0, level->size,
+                                   (const uint8_t *)header + level->offset);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        header->level_count - 1);
+        bind_texture(GL_TEXTURE_2D, 0);
+    }
+
+    munmap((void *)header, size);
+
+    return result;
+}
+
+static bool
+is_same_compressed_layout(const CompressedTextureHeader *a,
+                          const CompressedTextureHeader *b) {
+    if (a->format != b->format || a->level_count != b->level_count) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < a->level_count; ++i) {
+        if (a->levels[i].width != b->levels[i].width ||
+            a->levels[i].height != b->levels[i].height) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Like load_compressed_texture(), with one file per layer of a
+// GL_TEXTURE_2D_ARRAY. Every file must have the same format, size and level
+// count, or 0 is returned. Leaves GL_TEXTURE_2D_ARRAY unbound.
+static GLuint
+load_compressed_texture_array(const char **paths, int count) {
+    GLuint result = 0;
+
+    if (count < 1 || count > COMPRESSED_TEXTURE_MAX_LAYERS) {
+        return 0;
+    }
+
+    const CompressedTextureHeader *headers[COMPRESSED_TEXTURE_MAX_LAYERS];
+    size_t sizes[COMPRESSED_TEXTURE_MAX_LAYERS];
+    int mapped = 0;
+    bool complete = true;
+    for (; mapped < count; ++mapped) {
+        headers[mapped] = map_compressed_texture(paths[mapped],
+                                                 &sizes[mapped]);
+        if (!headers[mapped]) {
+            complete = false;
+            break;
+        }
+        if (!is_same_compressed_layout(headers[mapped], headers[0])) {
+            printf("Compressed texture %s does not match %s\n",
+                   paths[mapped], paths[0]);
+            complete = false;
+            ++mapped;
+            break;
+        }
+    }
+
+    GLenum gl_format = 0;
+    if (complete) {
+        gl_format = get_compressed_texture_gl_format(headers[0]->format);
+    }
+
+    if (gl_format) {
+        const CompressedTextureHeader *header = headers[0];
+        glGenTextures(1, &result);
+        bind_texture(GL_TEXTURE_2D_ARRAY, result);
+        for (uint32_t i = 0; i < header->level_count; ++i) {
+            const CompressedTextureLevel *level = &header->levels[i];
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, gl_format,
+                                   level->width, level->height, count, 0,
+                                   level->size * count, 0);
+            for (int layer = 0; layer < count; ++layer) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer,
+                                          level->width, level->height, 1,
+                                          gl_format, level->size,
+                                          (const uint8_t *)headers[layer] +
+                                          headers[layer]->levels[i].offset);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,
+                        header->level_count - 1);
+        bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    for (int i = 0; i < mapped; ++i) {
+        munmap((void *)headers[i], sizes[i]);
+    }
+
+    return result;
+}
+
+#endif
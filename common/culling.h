@@ -0,0 +1,540 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+// Visibility culling in front of the draw calls.
+//
+// CullingGrid buckets objects (bounding spheres) into a uniform grid by
+// centre and stores them sorted by cell as structure-of-arrays, so the
+// objects of a cell are one contiguous run for cull_spheres(). cull_grid()
+// classifies each occupied cell's bounds against the frustum first: cells
+// wholly outside are dropped and cells wholly inside are taken without
+// testing their objects, so only the cells crossing a frustum plane pay for
+// per-object SIMD tests. cull_grid_objects() tests every object instead, as
+// the baseline. Both leave the result in visible[] and count what they did
+// in stats.
+//
+// sort_cells_front_to_back() orders the cells by distance from the eye, so
+// the next cull emits objects roughly nearest first, which is what the
+// occlusion culler wants.
+//
+// OcclusionCuller adds GPU occlusion queries on top. For each object left
+// after frustum culling its bounding box is drawn, with colour and depth
+// writes off, inside a GL_ANY_SAMPLES_PASSED query, and the object itself is
+// then drawn inside glBeginConditionalRender() on that query, so the GPU
+// skips it if no sample of the box passed the depth test. The CPU never
+// waits for a result; how many objects the queries rejected is read back a
+// frame late, for the stats only.
+//
+// The grid is built once for objects that do not move. Moving objects mean
+// calling build_culling_grid() again, which does not allocate.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+#include "common/shader.h"
+#include "common/vector_math.h"
+
+#define MAX_CULLING_GRID_CELLS 4096
+
+typedef struct CullingStats {
+    int objects;
+    int cells_tested;
+    int cells_culled;
+    int cells_inside;
+    // Objects that went through a sphere test, the ones rejected by either a
+    // cell or sphere test, and the ones left to draw.
+    int objects_tested;
+    int objects_culled;
+    int objects_drawn;
+    // Filled in by the occlusion culler.
+    int occlusion_queries;
+    int objects_occluded;
+} CullingStats;
+
+typedef struct CullingCell {
+    // Bounds of the spheres in the cell, which may reach past the cell.
+    Vec3 min;
+    Vec3 max;
+    // The cell's objects are [begin, end) in the grid arrays.
+    int begin;
+    int end;
+    float distance;
+} CullingCell;
+
+typedef struct CullingGrid {
+    int capacity;
+    int count;
+
+    // Objects sorted by cell. ids[] maps a slot back to the caller's index.
+    float *x;
+    float *y;
+    float *z;
+    float *radius;
+    int *ids;
+
+    // Occupied cells only.
+    CullingCell *cells;
+    int cell_count;
+    int dims[3];
+    float cell_size;
+
+    // Output of the last cull: slots into the arrays above, so an object's
+    // position and id are one lookup away.
+    int *visible;
+    int visible_count;
+
+    CullingStats stats;
+
+    // Scratch.
+    int *object_cells;
+    int *cell_starts;
+    uint8_t *visible_flags;
+} CullingGrid;
+
+static void
+init_culling_grid(CullingGrid *grid, int capacity) {
+    memset(grid, 0, sizeof(*grid));
+    grid->capacity = capacity;
+    grid->x = heap_alloc(capacity * sizeof(float));
+    grid->y = heap_alloc(capacity * sizeof(float));
+    grid->z = heap_alloc(capacity * sizeof(float));
+    grid->radius = heap_alloc(capacity * sizeof(float));
+    grid->ids = heap_alloc(capacity * sizeof(int));
+    grid->cells = heap_alloc(MAX_CULLING_GRID_CELLS * sizeof(CullingCell));
+    grid->visible = heap_alloc(capacity * sizeof(int));
+    grid->object_cells = heap_alloc(capacity * sizeof(int));
+    grid->cell_starts = heap_alloc((MAX_CULLING_GRID_CELLS + 1) *
+                                   sizeof(int));
+    grid->visible_flags = heap_alloc(capacity);
+}
+
+static void
+free_culling_grid(CullingGrid *grid) {
+    heap_free(grid->x);
+    heap_free(grid->y);
+    heap_free(grid->z);
+    heap_free(grid->radius);
+    heap_free(grid->ids);
+    heap_free(grid->cells);
+    heap_free(grid->visible);
+    heap_free(grid->object_cells);
+    heap_free(grid->cell_starts);
+    heap_free(grid->visible_flags);
+    memset(grid, 0, sizeof(*grid));
+}
+
+static int
+get_grid_cell_coordinate(float value, float min, float cell_size, int dim) {
+    int result = (int)((value - min) / cell_size);
+    if (result < 0) {
+        result = 0;
+    }
+    if (result >= dim) {
+        result = dim - 1;
+    }
+    return result;
+}
+
+// Buckets `count` spheres (at most the grid's capacity) into cells of
+// `cell_size`, grown as needed to stay within MAX_CULLING_GRID_CELLS.
+static void
+build_culling_grid(CullingGrid *grid, const float *x, const float *y,
+                   const float *z, const float *radius, int count,
+                   float cell_size) {
+    if (count > grid->capacity) {
+        count = grid->capacity;
+    }
+    grid->count = count;
+    grid->cell_count = 0;
+    if (count == 0) {
+        return;
+    }
+
+    Vec3 min = vec3(x[0], y[0], z[0]);
+    Vec3 max = min;
+    for (int i = 1; i < count; ++i) {
+        min = vec3(fminf(min.x, x[i]), fminf(min.y, y[i]), fminf(min.z, z[i]));
+        max = vec3(fmaxf(max.x, x[i]), fmaxf(max.y, y[i]), fmaxf(max.z, z[i]));
+    }
+
+    if (cell_size <= 0.0f) {
+        cell_size = 1.0f;
+    }
+    Vec3 extent = vec3_sub(max, min);
+    for (;;) {
+        grid->dims[0] = (int)(extent.x / cell_size) + 1;
+        grid->dims[1] = (int)(extent.y / cell_size) + 1;
+        grid->dims[2] = (int)(extent.z / cell_size) + 1;
+        if ((long)grid->dims[0] * grid->dims[1] * grid->dims[2] <=
+            MAX_CULLING_GRID_CELLS) {
+            break;
+        }
+        cell_size *= 1.25f;
+    }
+    grid->cell_size = cell_size;
+    int dim_cells = grid->dims[0] * grid->dims[1] * grid->dims[2];
+
+    // Counting sort by cell.
+    int *starts = grid->cell_starts;
+    memset(starts, 0, (dim_cells + 1) * sizeof(int));
+    for (int i = 0; i < count; ++i) {
+        int cx = get_grid_cell_coordinate(x[i], min.x, cell_size,
+                                          grid->dims[0]);
+        int cy = get_grid_cell_coordinate(y[i], min.y, cell_size,
+                                          grid->dims[1]);
+        int cz = get_grid_cell_coordinate(z[i], min.z, cell_size,
+                                          grid->dims[2]);
+        int cell = (cz * grid->dims[1] + cy) * grid->dims[0] + cx;
+        grid->object_cells[i] = cell;
+        starts[cell + 1]++;
+    }
+    for (int cell = 0; cell < dim_cells; ++cell) {
+        starts[cell + 1] += starts[cell];
+    }
+
+    for (int cell = 0; cell < dim_cells; ++cell) {
+        if (starts[cell + 1] > starts[cell]) {
+            CullingCell *c = &grid->cells[grid->cell_count++];
+            c->begin = starts[cell];
+            c->end = starts[cell + 1];
+            c->min = vec3(INFINITY, INFINITY, INFINITY);
+            c->max = vec3(-INFINITY, -INFINITY, -INFINITY);
+            c->distance = 0.0f;
+        }
+    }
+
+    // starts[cell] becomes the next free slot of each cell.
+    for (int i = 0; i < count; ++i) {
+        int slot = starts[grid->object_cells[i]]++;
+        grid->x[slot] = x[i];
+        grid->y[slot] = y[i];
+        grid->z[slot] = z[i];
+        grid->radius[slot] = radius[i];
+        grid->ids[slot] = i;
+    }
+
+    for (int i = 0; i < grid->cell_count; ++i) {
+        CullingCell *c = &grid->cells[i];
+        for (int slot = c->begin; slot < c->end; ++slot) {
+            float r = grid->radius[slot];
+            c->min = vec3(fminf(c->min.x, grid->x[slot] - r),
+                          fminf(c->min.y, grid->y[slot] - r),
+                          fminf(c->min.z, grid->z[slot] - r));
+            c->max = vec3(fmaxf(c->max.x, grid->x[slot] + r),
+                          fmaxf(c->max.y, grid->y[slot] + r),
+                          fmaxf(c->max.z, grid->z[slot] + r));
+        }
+    }
+}
+
+static void
+begin_culling(CullingGrid *grid) {
+    memset(&grid->stats, 0, sizeof(grid->stats));
+    grid->stats.objects = grid->count;
+    grid->visible_count = 0;
+}
+
+// Sphere tests the objects in [begin, end) and appends the visible ones.
+static void
+cull_grid_range(CullingGrid *grid, const Frustum *frustum, int begin,
+                int end) {
+    int count = end - begin;
+    int visible = cull_spheres(frustum, grid->x + begin, grid->y + begin,
+                               grid->z + begin, grid->radius + begin,
+                               grid->visible_flags + begin, count);
+
+    for (int slot = begin; slot < end; ++slot) {
+        if (grid->visible_flags[slot]) {
+            grid->visible[grid->visible_count++] = slot;
+        }
+    }
+
+    grid->stats.objects_tested += count;
+    grid->stats.objects_culled += count - visible;
+}
+
+// Tests every object, ignoring the cells.
+static void
+cull_grid_objects(CullingGrid *grid, const Frustum *frustum) {
+    begin_culling(grid);
+    cull_grid_range(grid, frustum, 0, grid->count);
+    grid->stats.objects_drawn = grid->visible_count;
+}
+
+static void
+cull_grid(CullingGrid *grid, const Frustum *frustum) {
+    begin_culling(grid);
+
+    for (int i = 0; i < grid->cell_count; ++i) {
+        CullingCell *cell = &grid->cells[i];
+        grid->stats.cells_tested++;
+
+        switch (frustum_classify_aabb(frustum, cell->min, cell->max)) {
+            case FRUSTUM_OUTSIDE: {
+                grid->stats.cells_culled++;
+                grid->stats.objects_culled += cell->end - cell->begin;
+            } break;
+
+            case FRUSTUM_INSIDE: {
+                grid->stats.cells_inside++;
+                for (int slot = cell->begin; slot < cell->end; ++slot) {
+                    grid->visible[grid->visible_count++] = slot;
+                }
+            } break;
+
+            case FRUSTUM_INTERSECT: {
+                cull_grid_range(grid, frustum, cell->begin, cell->end);
+            } break;
+        }
+    }
+
+    grid->stats.objects_drawn = grid->visible_count;
+}
+
+static int
+compare_cell_distance(const void *a, const void *b) {
+    float x = ((const CullingCell *)a)->distance;
+    float y = ((const CullingCell *)b)->distance;
+    return (x > y) - (x < y);
+}
+
+// Orders cells by the distance from `eye` to their bounds, so cull_grid()
+// emits the nearest cells first. Cheap enough to call every frame.
+static void
+sort_cells_front_to_back(CullingGrid *grid, Vec3 eye) {
+    for (int i = 0; i < grid->cell_count; ++i) {
+        CullingCell *cell = &grid->cells[i];
+        Vec3 nearest = vec3(fminf(fmaxf(eye.x, cell->min.x), cell->max.x),
+                            fminf(fmaxf(eye.y, cell->min.y), cell->max.y),
+                            fminf(fmaxf(eye.z, cell->min.z), cell->max.z));
+        Vec3 d = vec3_sub(nearest, eye);
+        cell->distance = vec3_dot(d, d);
+    }
+    qsort(grid->cells, grid->cell_count, sizeof(CullingCell),
+          compare_cell_distance);
+}
+
+//
+// Occlusion queries
+//
+
+static char *OCCLUSION_VERTEX_SHADER = "                                      \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform mat4 view_projection;                                               \n\
+uniform vec3 box_min;                                                       \n\
+uniform vec3 box_max;                                                       \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+void main() {                                                               \n\
+    gl_Position = view_projection * vec4(mix(box_min, box_max, pos), 1.0);  \n\
+}                                                                             \
+";
+
+static char *OCCLUSION_FRAGMENT_SHADER = "                                    \
+#version 330 core                                                           \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = vec4(1.0);                                                      \n\
+}                                                                             \
+";
+
+enum {
+    OCCLUSION_UNIFORM_VIEW_PROJECTION,
+    OCCLUSION_UNIFORM_BOX_MIN,
+    OCCLUSION_UNIFORM_BOX_MAX,
+    OCCLUSION_UNIFORM_COUNT,
+};
+
+static const char *OCCLUSION_UNIFORM_NAMES[OCCLUSION_UNIFORM_COUNT] = {
+    "view_projection",
+    "box_min",
+    "box_max",
+};
+
+// The unit cube, scaled to each box by the vertex shader.
+static GLfloat OCCLUSION_BOX_VERTICES[] = {
+    0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,
+    0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1,
+};
+
+static GLushort OCCLUSION_BOX_INDICES[] = {
+    0, 2, 1,  0, 3, 2,
+    4, 5, 6,  4, 6, 7,
+    0, 1, 5,  0, 5, 4,
+    3, 6, 2,  3, 7, 6,
+    0, 4, 7,  0, 7, 3,
+    1, 2, 6,  1, 6, 5,
+};
+
+typedef struct OcclusionCuller {
+    Program program;
+    GLuint vao, vbo, ebo;
+
+    // One query per object id. query_frames[id] is the frame the query was
+    // last issued in, 0 for never.
+    int capacity;
+    GLuint *queries;
+    uint32_t *query_frames;
+    uint32_t frame;
+
+    // Boxes the eye is in (or nearly, given the near plane) cannot be
+    // tested, since their front faces are clipped away.
+    Vec3 eye;
+    float near;
+
+    CullingStats *stats;
+} OcclusionCuller;
+
+static bool
+init_occlusion_culler(OcclusionCuller *culler, int capacity) {
+    memset(culler, 0, sizeof(*culler));
+    culler->capacity = capacity;
+    culler->queries = heap_alloc(capacity * sizeof(GLuint));
+    culler->query_frames = heap_calloc(capacity, sizeof(uint32_t));
+    glGenQueries(capacity, culler->queries);
+
+    culler->program = create_program(OCCLUSION_VERTEX_SHADER,
+                                     OCCLUSION_FRAGMENT_SHADER,
+                                     OCCLUSION_UNIFORM_NAMES,
+                                     OCCLUSION_UNIFORM_COUNT);
+    if (!culler->program.id) {
+        return false;
+    }
+
+    glGenVertexArrays(1, &culler->vao);
+    bind_vertex_array(culler->vao);
+
+    glGenBuffers(1, &culler->vbo);
+    bind_buffer(GL_ARRAY_BUFFER, culler->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(OCCLUSION_BOX_VERTICES),
+                 OCCLUSION_BOX_VERTICES, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    glGenBuffers(1, &culler->ebo);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, culler->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(OCCLUSION_BOX_INDICES),
+                 OCCLUSION_BOX_INDICES, GL_STATIC_DRAW);
+
+    bind_vertex_array(0);
+    bind_buffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+static void
+free_occlusion_culler(OcclusionCuller *culler) {
+    glDeleteQueries(culler->capacity, culler->queries);
+    delete_vertex_arrays(1, &culler->vao);
+    delete_buffers(1, &culler->vbo);
+    delete_buffers(1, &culler->ebo);
+    glDeleteProgram(culler->program.id);
+    heap_free(culler->queries);
+    heap_free(culler->query_frames);
+    memset(culler, 0, sizeof(*culler));
+}
+
+// Starts issuing queries for this frame. Depth must already hold the
+// occluders (usually the first few objects, drawn without queries); until
+// end_occlusion_queries() only the boxes are drawn.
+static void
+begin_occlusion_queries(OcclusionCuller *culler, const Mat4 *view_projection,
+                        Vec3 eye, float near, CullingStats *stats) {
+    culler->frame++;
+    culler->eye = eye;
+    culler->near = near;
+    culler->stats = stats;
+
+    use_program(culler->program.id);
+    glUniformMatrix4fv(
+        culler->program.uniforms[OCCLUSION_UNIFORM_VIEW_PROJECTION], 1,
+        GL_FALSE, view_projection->m);
+    bind_vertex_array(culler->vao);
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+}
+
+// Issues the query for object `id` with bounds [min, max]. Its result from
+// an earlier frame, if the GPU has it by now, goes into the stats first.
+static void
+issue_occlusion_query(OcclusionCuller *culler, int id, Vec3 min, Vec3 max) {
+    if (id < 0 || id >= culler->capacity) {
+        return;
+    }
+
+    GLuint query = culler->queries[id];
+    if (culler->query_frames[id]) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint passed;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &passed);
+            if (!passed && culler->stats) {
+                culler->stats->objects_occluded++;
+            }
+        }
+    }
+
+    float margin = culler->near * 2.0f;
+    Vec3 eye = culler->eye;
+    if (eye.x > min.x - margin && eye.x < max.x + margin &&
+        eye.y > min.y - margin && eye.y < max.y + margin &&
+        eye.z > min.z - margin && eye.z < max.z + margin) {
+        culler->query_frames[id] = 0;
+        return;
+    }
+
+    glUniform3f(culler->program.uniforms[OCCLUSION_UNIFORM_BOX_MIN],
+                min.x, min.y, min.z);
+    glUniform3f(culler->program.uniforms[OCCLUSION_UNIFORM_BOX_MAX],
+                max.x, max.y, max.z);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    culler->query_frames[id] = culler->frame;
+    if (culler->stats) {
+        culler->stats->occlusion_queries++;
+    }
+}
+
+static void
+end_occlusion_queries(OcclusionCuller *culler) {
+    (void)culler;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+}
+
+static bool
+has_occlusion_query(OcclusionCuller *culler, int id) {
+    return id >= 0 && id < culler->capacity &&
+           culler->query_frames[id] == culler->frame;
+}
+
+// Wrap each object's draw calls in these. Objects without a query this
+// frame draw unconditionally. GL_QUERY_WAIT lets the GPU wait for the box,
+// which was issued well before, rather than draw when it is late; the CPU
+// does not wait either way.
+static void
+begin_occlusion_draw(OcclusionCuller *culler, int id) {
+    if (has_occlusion_query(culler, id)) {
+        glBeginConditionalRender(culler->queries[id], GL_QUERY_WAIT);
+    }
+}
+
+static void
+end_occlusion_draw(OcclusionCuller *culler, int id) {
+    if (has_occlusion_query(culler, id)) {
+        glEndConditionalRender();
+    }
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+// Frame pacing for the windowed samples.
+//
+//   --swap-interval N     0 = immediate, 1 = vsync, -1 = adaptive vsync
+//                         (falls back to 1 where unsupported)
+//   --fps N               cap the frame rate; 0 leaves it to the swap
+//   --frames-in-flight N  block on a fence once N frames are queued on the
+//                         GPU; 0 lets the driver decide
+//
+// begin_frame() marks when input is sampled and end_frame() swaps, fences the
+// frame and sleeps until the next frame is due. The limiter sleeps with
+// SDL_Delay() until FRAME_PACER_SPIN_MS before the deadline and spins the
+// rest, since SDL_Delay() alone can oversleep by a millisecond or more.
+//
+// Latency is measured from begin_frame() to the moment the frame's fence is
+// seen signaled, so it is an input-to-GPU-done estimate; the display adds at
+// most one refresh on top. Without a frames-in-flight limit fences are only
+// polled once a frame, which rounds latency up to the next frame boundary.
+
+#include "common/headless.h"
+
+#define FRAME_PACER_MAX_IN_FLIGHT 8
+#define FRAME_PACER_HISTORY 1024
+#define FRAME_PACER_SPIN_MS 2.0
+
+typedef struct FramePacerOptions {
+    int swap_interval;
+    double fps;
+    int frames_in_flight;
+} FramePacerOptions;
+
+typedef struct FrameInFlight {
+    GLsync fence;
+    Uint64 begin;
+} FrameInFlight;
+
+typedef struct FramePacer {
+    FramePacerOptions options;
+
+    Uint64 period;
+    Uint64 deadline;
+    Uint64 frame_begin;
+
+    FrameInFlight in_flight[FRAME_PACER_MAX_IN_FLIGHT];
+    int in_flight_first;
+    int in_flight_count;
+
+    double frame_ms[FRAME_PACER_HISTORY];
+    double latency_ms[FRAME_PACER_HISTORY];
+    int frame_count;
+    int latency_count;
+    double sleep_ms;
+    double spin_ms;
+    double fence_wait_ms;
+} FramePacer;
+
+// Unknown arguments are ignored so samples can mix these with their own.
+static void
+parse_frame_pacer_options(int argc, char **argv, FramePacerOptions *options) {
+    options->swap_interval = 1;
+    options->fps = 0;
+    options->frames_in_flight = 2;
+
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--swap-interval") == 0) {
+            options->swap_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0) {
+            options->fps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0) {
+            options->frames_in_flight = atoi(argv[++i]);
+        }
+    }
+
+    if (options->swap_interval < -1 || options->swap_interval > 1) {
+        options->swap_interval = 1;
+    }
+    if (options->fps < 0) {
+        options->fps = 0;
+    }
+    if (options->frames_in_flight < 0) {
+        options->frames_in_flight = 0;
+    }
+    if (options->frames_in_flight > FRAME_PACER_MAX_IN_FLIGHT) {
+        options->frames_in_flight = FRAME_PACER_MAX_IN_FLIGHT;
+    }
+}
+
+// Call once the GL context is current.
+static void
+init_frame_pacer(FramePacer *pacer, FramePacerOptions *options) {
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->options = *options;
+
+    if (SDL_GL_SetSwapInterval(options->swap_interval) < 0) {
+        if (options->swap_interval == -1) {
+            printf("Adaptive vsync is not supported, using vsync\n");
+            pacer->options.swap_interval = 1;
+        } else {
+            printf("Failed to set swap interval %d: %s\n",
+                   options->swap_interval, SDL_GetError());
+        }
+        SDL_GL_SetSwapInterval(pacer->options.swap_interval);
+    }
+
+    if (options->fps > 0) {
+        pacer->period = (Uint64)(SDL_GetPerformanceFrequency() /
+                                 options->fps);
+    }
+}
+
+// Call right before polling input. Also starts a new FRAME_ARENA frame and
+// memory stats count.
+static void
+begin_frame(FramePacer *pacer) {
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    reset_memory_stats();
+    begin_frame_arena(&FRAME_ARENA);
+
+    if (pacer->frame_begin) {
+        pacer->frame_ms[pacer->frame_count % FRAME_PACER_HISTORY] =
+            performance_counter_to_ms(now - pacer->frame_begin);
+        pacer->frame_count++;
+    }
+
+    pacer->frame_begin = now;
+}
+
+// Retires the oldest frame in flight. With `wait` it blocks until the GPU is
+// done with it; otherwise it returns false if it is still running.
+static bool
+retire_frame_in_flight(FramePacer *pacer, bool wait) {
+    FrameInFlight *frame = &pacer->in_flight[pacer->in_flight_first];
+
+    if (wait) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        glClientWaitSync(frame->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        pacer->fence_wait_ms +=
+            performance_counter_to_ms(SDL_GetPerformanceCounter() - start);
+    } else if (glClientWaitSync(frame->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+
+    pacer->latency_ms[pacer->latency_count % FRAME_PACER_HISTORY] =
+        performance_counter_to_ms(SDL_GetPerformanceCounter() - frame->begin);
+    pacer->latency_count++;
+
+    glDeleteSync(frame->fence);
+    frame->fence = 0;
+    pacer->in_flight_first = (pacer->in_flight_first + 1) %
+                             FRAME_PACER_MAX_IN_FLIGHT;
+    pacer->in_flight_count--;
+
+    return true;
+}
+
+static void
+wait_until(FramePacer *pacer, Uint64 deadline) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= deadline) {
+        return;
+    }
+
+    double remaining_ms = performance_counter_to_ms(deadline - now);
+    if (remaining_ms > FRAME_PACER_SPIN_MS) {
+        SDL_Delay((Uint32)(remaining_ms - FRAME_PACER_SPIN_MS));
+        Uint64 woke = SDL_GetPerformanceCounter();
+        pacer->sleep_ms += performance_counter_to_ms(woke - now);
+        now = woke;
+    }
+
+    Uint64 spin_start = now;
+    while (now < deadline) {
+        now = SDL_GetPerformanceCounter();
+    }
+    pacer->spin_ms += performance_counter_to_ms(now - spin_start);
+}
+
+// Replaces SDL_GL_SwapWindow() at the end of the loop.
+static void
+end_frame(FramePacer *pacer, SDL_Window *window) {
+    SDL_GL_SwapWindow(window);
+
+    if (pacer->in_flight_count == FRAME_PACER_MAX_IN_FLIGHT) {
+        retire_frame_in_flight(pacer, true);
+    }
+    int slot = (pacer->in_flight_first + pacer->in_flight_count) %
+               FRAME_PACER_MAX_IN_FLIGHT;
+    pacer->in_flight[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,
+                                               0);
+    pacer->in_flight[slot].begin = pacer->frame_begin;
+    pacer->in_flight_count++;
+
+    // Keep the CPU from running more than frames_in_flight frames ahead.
+    int limit = pacer->options.frames_in_flight;
+    while (limit > 0 && pacer->in_flight_count > limit) {
+        retire_frame_in_flight(pacer, true);
+    }
+    while (pacer->in_flight_count > 0 &&
+           retire_frame_in_flight(pacer, false)) {
+    }
+
+    if (pacer->period) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        pacer->deadline += pacer->period;
+
+        // After a hitch start over from now rather than rushing frames out to
+        // catch up.
+        if (pacer->deadline + pacer->period < now) {
+            pacer->deadline = now;
+        }
+
+        wait_until(pacer, pacer->deadline);
+    }
+}
+
+static FrameTimeStats
+compute_frame_pacer_stats(double *history, int count) {
+    if (count > FRAME_PACER_HISTORY) {
+        count = FRAME_PACER_HISTORY;
+    }
+
+    // compute_frame_time_stats() sorts in place.
+    double samples[FRAME_PACER_HISTORY];
+    memcpy(samples, history, count * sizeof(double));
+
+    return compute_frame_time_stats(samples, count);
+}
+
+// Prints one JSON object covering the last FRAME_PACER_HISTORY frames.
+static void
+print_frame_pacer_report(FramePacer *pacer) {
+    printf("{\"swap_interval\":%d,\"fps\":%.1f,\"frames_in_flight\":%d,"
+           "\"frames\":%d,",
+           pacer->options.swap_interval, pacer->options.fps,
+           pacer->options.frames_in_flight, pacer->frame_count);
+    print_frame_time_stats("frame_ms",
+                           compute_frame_pacer_stats(pacer->frame_ms,
+                                                     pacer->frame_count));
+    putchar(',');
+    print_frame_time_stats("latency_ms",
+                           compute_frame_pacer_stats(pacer->latency_ms,
+                                                     pacer->latency_count));
+    printf(",\"sleep_ms\":%.1f,\"spin_ms\":%.1f,\"fence_wait_ms\":%.1f",
+           pacer->sleep_ms, pacer->spin_ms, pacer->fence_wait_ms);
+    // From the last frame.
+    printf(",\"heap_allocs\":%d,\"arena_peak\":%lu}\n",
+           SDL_AtomicGet(&MEMORY_STATS.heap_allocs),
+           (unsigned long)MEMORY_STATS.arena_peak);
+}
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+// Shadow copy of the GL binding state.
+//
+// use_program(), bind_vertex_array(), bind_buffer(), bind_buffer_range(),
+// active_texture() and bind_texture() remember what is bound and skip the GL
+// call when nothing would change, so render loops can bind what they need
+// without unbinding afterwards. GL_STATE.stats counts issued and elided
+// calls; run_headless() resets it every frame.
+//
+// The cache is only correct if every bind goes through it. Code that calls GL
+// directly (or deletes objects behind its back) must call
+// invalidate_gl_state() afterwards. Deleting textures, buffers and vertex
+// arrays through the delete_* helpers keeps it in sync, since GL unbinds
+// deleted names and may hand them out again.
+
+#define MAX_GL_STATE_TEXTURE_UNITS 16
+#define MAX_GL_STATE_UNIFORM_BINDINGS 16
+
+// Never a valid object name, so the next bind is always issued.
+#define GL_STATE_UNKNOWN 0xFFFFFFFF
+
+typedef enum GLStateBufferTarget {
+    GL_STATE_ARRAY_BUFFER,
+    GL_STATE_ELEMENT_ARRAY_BUFFER,
+    GL_STATE_PIXEL_UNPACK_BUFFER,
+    GL_STATE_PIXEL_PACK_BUFFER,
+    GL_STATE_UNIFORM_BUFFER,
+    GL_STATE_COPY_READ_BUFFER,
+    GL_STATE_COPY_WRITE_BUFFER,
+    GL_STATE_DRAW_INDIRECT_BUFFER,
+    GL_STATE_BUFFER_TARGET_COUNT,
+} GLStateBufferTarget;
+
+typedef enum GLStateTextureTarget {
+    GL_STATE_TEXTURE_2D,
+    GL_STATE_TEXTURE_2D_ARRAY,
+    GL_STATE_TEXTURE_3D,
+    GL_STATE_TEXTURE_CUBE_MAP,
+    GL_STATE_TEXTURE_TARGET_COUNT,
+} GLStateTextureTarget;
+
+typedef struct GLStateBufferRange {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} GLStateBufferRange;
+
+typedef struct GLStateStats {
+    int issued;
+    int elided;
+} GLStateStats;
+
+typedef struct GLState {
+    GLuint program;
+    GLuint vertex_array;
+    GLuint buffers[GL_STATE_BUFFER_TARGET_COUNT];
+    GLenum active_texture;
+    GLuint textures[MAX_GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGET_COUNT];
+    GLStateBufferRange uniform_ranges[MAX_GL_STATE_UNIFORM_BINDINGS];
+
+    GLStateStats stats;
+} GLState;
+
+// A fresh context has everything bound to 0 and GL_TEXTURE0 active.
+static GLState GL_STATE = {.active_texture = GL_TEXTURE0};
+
+static void
+invalidate_gl_state(void) {
+    GL_STATE.program = GL_STATE_UNKNOWN;
+    GL_STATE.vertex_array = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_BUFFER_TARGET_COUNT; ++i) {
+        GL_STATE.buffers[i] = GL_STATE_UNKNOWN;
+    }
+    GL_STATE.active_texture = GL_STATE_UNKNOWN;
+    for (int unit = 0; unit < MAX_GL_STATE_TEXTURE_UNITS; ++unit) {
+        for (int i = 0; i < GL_STATE_TEXTURE_TARGET_COUNT; ++i) {
+            GL_STATE.textures[unit][i] = GL_STATE_UNKNOWN;
+        }
+    }
+    for (int i = 0; i < MAX_GL_STATE_UNIFORM_BINDINGS; ++i) {
+        GL_STATE.uniform_ranges[i].buffer = GL_STATE_UNKNOWN;
+    }
+}
+
+static void
+reset_gl_state_stats(void) {
+    GL_STATE.stats.issued = 0;
+    GL_STATE.stats.elided = 0;
+}
+
+// Returns true if the call must be issued, and records the new value.
+static bool
+update_gl_state(GLuint *cached, GLuint value) {
+    if (*cached == value) {
+        GL_STATE.stats.elided++;
+        return false;
+    }
+
+    *cached = value;
+    GL_STATE.stats.issued++;
+    return true;
+}
+
+static int
+get_gl_state_buffer_target(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return GL_STATE_ARRAY_BUFFER;
+        case GL_ELEMENT_ARRAY_BUFFER: return GL_STATE_ELEMENT_ARRAY_BUFFER;
+        case GL_PIXEL_UNPACK_BUFFER: return GL_STATE_PIXEL_UNPACK_BUFFER;
+        case GL_PIXEL_PACK_BUFFER: return GL_STATE_PIXEL_PACK_BUFFER;
+        case GL_UNIFORM_BUFFER: return GL_STATE_UNIFORM_BUFFER;
+        case GL_COPY_READ_BUFFER: return GL_STATE_COPY_READ_BUFFER;
+        case GL_COPY_WRITE_BUFFER: return GL_STATE_COPY_WRITE_BUFFER;
+        case GL_DRAW_INDIRECT_BUFFER: return GL_STATE_DRAW_INDIRECT_BUFFER;
+        default: return -1;
+    }
+}
+
+static int
+get_gl_state_texture_target(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return GL_STATE_TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return GL_STATE_TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_3D: return GL_STATE_TEXTURE_3D;
+        case GL_TEXTURE_CUBE_MAP: return GL_STATE_TEXTURE_CUBE_MAP;
+        default: return -1;
+    }
+}
+
+static void
+use_program(GLuint program) {
+    if (update_gl_state(&GL_STATE.program, program)) {
+        glUseProgram(program);
+    }
+}
+
+static void
+bind_vertex_array(GLuint vertex_array) {
+    if (update_gl_state(&GL_STATE.vertex_array, vertex_array)) {
+        glBindVertexArray(vertex_array);
+
+        // The element array binding is part of the VAO, so whatever we knew
+        // about it belonged to the previous one.
+        GL_STATE.buffers[GL_STATE_ELEMENT_ARRAY_BUFFER] = GL_STATE_UNKNOWN;
+    }
+}
+
+static void
+bind_buffer(GLenum target, GLuint buffer) {
+    int index = get_gl_state_buffer_target(target);
+    if (index < 0) {
+        GL_STATE.stats.issued++;
+        glBindBuffer(target, buffer);
+    } else if (update_gl_state(&GL_STATE.buffers[index], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// Only GL_UNIFORM_BUFFER ranges are cached. Like glBindBufferRange() this
+// also changes the generic binding for `target`.
+static void
+bind_buffer_range(GLenum target, GLuint index, GLuint buffer,
+                  GLintptr offset, GLsizeiptr size) {
+    if (target == GL_UNIFORM_BUFFER && index < MAX_GL_STATE_UNIFORM_BINDINGS) {
+        GLStateBufferRange *range = &GL_STATE.uniform_ranges[index];
+        if (range->buffer == buffer && range->offset == offset &&
+            range->size == size) {
+            GL_STATE.stats.elided++;
+            return;
+        }
+        range->buffer = buffer;
+        range->offset = offset;
+        range->size = size;
+    }
+
+    GL_STATE.stats.issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+
+    int generic = get_gl_state_buffer_target(target);
+    if (generic >= 0) {
+        GL_STATE.buffers[generic] = buffer;
+    }
+}
+
+// `unit` is GL_TEXTURE0 + n, as for glActiveTexture().
+static void
+active_texture(GLenum unit) {
+    if (update_gl_state(&GL_STATE.active_texture, unit)) {
+        glActiveTexture(unit);
+    }
+}
+
+// Binds to the active texture unit.
+static void
+bind_texture(GLenum target, GLuint texture) {
+    int index = get_gl_state_texture_target(target);
+    GLuint unit = GL_STATE.active_texture - GL_TEXTURE0;
+    if (index < 0 || unit >= MAX_GL_STATE_TEXTURE_UNITS) {
+        GL_STATE.stats.issued++;
+        glBindTexture(target, texture);
+    } else if (update_gl_state(&GL_STATE.textures[unit][index], texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+static void
+forget_gl_state_name(GLuint *cached, int count, GLuint name) {
+    for (int i = 0; i < count; ++i) {
+        if (cached[i] == name) {
+            cached[i] = 0;
+        }
+    }
+}
+
+static void
+delete_textures(GLsizei n, const GLuint *textures) {
+    for (GLsizei i = 0; i < n; ++i) {
+        forget_gl_state_name(&GL_STATE.textures[0][0],
+                             MAX_GL_STATE_TEXTURE_UNITS *
+                             GL_STATE_TEXTURE_TARGET_COUNT,
+                             textures[i]);
+    }
+    glDeleteTextures(n, textures);
+}
+
+static void
+delete_buffers(GLsizei n, const GLuint *buffers) {
+    for (GLsizei i = 0; i < n; ++i) {
+        forget_gl_state_name(GL_STATE.buffers, GL_STATE_BUFFER_TARGET_COUNT,
+                             buffers[i]);
+        for (int j = 0; j < MAX_GL_STATE_UNIFORM_BINDINGS; ++j) {
+            if (GL_STATE.uniform_ranges[j].buffer == buffers[i]) {
+                GL_STATE.uniform_ranges[j].buffer = 0;
+            }
+        }
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+static void
+delete_vertex_arrays(GLsizei n, const GLuint *vertex_arrays) {
+    for (GLsizei i = 0; i < n; ++i) {
+        if (GL_STATE.vertex_array == vertex_arrays[i]) {
+            GL_STATE.vertex_array = 0;
+            GL_STATE.buffers[GL_STATE_ELEMENT_ARRAY_BUFFER] = 0;
+        }
+    }
+    glDeleteVertexArrays(n, vertex_arrays);
+}
+
+#endif
@@ -0,0 +1,426 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Headless benchmark mode shared by every sample.
+//
+// Running a sample with `--headless` skips the SDL window entirely: an EGL
+// context is created without any native display (Mesa's surfaceless platform,
+// so llvmpipe works on build hosts), the sample renders N frames into an
+// offscreen FBO with colour and depth/stencil attachments and the frame times
+// are printed as a single JSON object on stdout.
+//
+//   ./textures --headless --frames 1000 --warmup 100
+
+#include <stdlib.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+
+#ifdef __linux__
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// GPU times come from GL_TIME_ELAPSED queries kept in a small ring. Reading
+// the query issued HEADLESS_QUERY_COUNT frames ago also throttles the CPU to
+// that many frames in flight, the same way a swap chain would.
+#define HEADLESS_QUERY_COUNT 4
+
+#define HEADLESS_DEFAULT_FRAMES 500
+#define HEADLESS_DEFAULT_WARMUP 50
+
+typedef struct FrameTimeStats {
+    double min;
+    double median;
+    double p99;
+} FrameTimeStats;
+
+typedef struct HeadlessReport {
+    int frames;
+    double cpu_ms_total;
+    FrameTimeStats cpu_ms;
+    FrameTimeStats gpu_ms;
+} HeadlessReport;
+
+typedef struct HeadlessOptions {
+    bool enabled;
+    int width;
+    int height;
+    int frames;
+    int warmup;
+
+    // Optional. Called while the result object is printed so a benchmark can
+    // append its own fields, each starting with a comma.
+    void (*report)(HeadlessReport *report);
+
+    // Optional. Called after the report while the context is still current.
+    void (*shutdown)(void);
+} HeadlessOptions;
+
+static bool
+parse_headless_options(int argc, char **argv, int width, int height,
+                       HeadlessOptions *options) {
+    options->enabled = false;
+    options->width = width;
+    options->height = height;
+    options->frames = HEADLESS_DEFAULT_FRAMES;
+    options->warmup = HEADLESS_DEFAULT_WARMUP;
+    options->report = 0;
+    options->shutdown = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            options->enabled = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options->frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options->warmup = atoi(argv[++i]);
+        }
+    }
+
+    if (options->frames < 1) {
+        options->frames = 1;
+    }
+    if (options->warmup < 0) {
+        options->warmup = 0;
+    }
+
+    return options->enabled;
+}
+
+static int
+compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts samples in place.
+static FrameTimeStats
+compute_frame_time_stats(double *samples, int count) {
+    FrameTimeStats result = {0};
+
+    if (count > 0) {
+        qsort(samples, count, sizeof(*samples), compare_double);
+
+        int p99_index = (int)ceil(0.99 * count) - 1;
+        if (p99_index < 0) {
+            p99_index = 0;
+        }
+
+        result.min = samples[0];
+        result.median = samples[count / 2];
+        result.p99 = samples[p99_index];
+    }
+
+    return result;
+}
+
+static void
+print_json_string(const char *str) {
+    putchar('"');
+    for (; str && *str; ++str) {
+        if (*str == '"' || *str == '\\') {
+            putchar('\\');
+        }
+        if ((unsigned char)*str >= 0x20) {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+static void
+print_frame_time_stats(const char *name, FrameTimeStats stats) {
+    printf("\"%s\":{\"min\":%.4f,\"median\":%.4f,\"p99\":%.4f}",
+           name, stats.min, stats.median, stats.p99);
+}
+
+#ifdef __linux__
+
+typedef struct HeadlessContext {
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+} HeadlessContext;
+
+static EGLDisplay
+get_headless_display(void) {
+    EGLDisplay result = EGL_NO_DISPLAY;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        result = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                      EGL_DEFAULT_DISPLAY, 0);
+    }
+
+    if (result == EGL_NO_DISPLAY) {
+        result = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    return result;
+}
+
+static bool
+create_headless_context(HeadlessContext *ctx) {
+    ctx->display = get_headless_display();
+    ctx->context = EGL_NO_CONTEXT;
+    ctx->surface = EGL_NO_SURFACE;
+
+    if (ctx->display == EGL_NO_DISPLAY ||
+        !eglInitialize(ctx->display, 0, 0)) {
+        printf("Failed to initialize EGL display: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        printf("Failed to bind OpenGL API: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(ctx->display, config_attribs, &config, 1,
+                         &config_count) || config_count == 0) {
+        printf("Failed to choose EGL config: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    ctx->context = eglCreateContext(ctx->display, config, EGL_NO_CONTEXT,
+                                    context_attribs);
+    if (ctx->context == EGL_NO_CONTEXT) {
+        printf("Failed to create EGL context: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    // Everything is drawn into our own FBO, so a surface is only needed when
+    // the driver lacks EGL_KHR_surfaceless_context.
+    if (!eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        ctx->context)) {
+        EGLint pbuffer_attribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE,
+        };
+        ctx->surface = eglCreatePbufferSurface(ctx->display, config,
+                                               pbuffer_attribs);
+        if (ctx->surface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(ctx->display, ctx->surface, ctx->surface,
+                            ctx->context)) {
+            printf("Failed to make EGL context current: 0x%x\n",
+                   eglGetError());
+            return false;
+        }
+    }
+
+    // MUST make a context AND make it current BEFORE glewInit()!
+    // GLEW built against GLX reports a missing X display even though every
+    // entry point was loaded, so that particular error is not fatal here.
+    glewExperimental = GL_TRUE;
+    GLenum status = glewInit();
+    if (status != GLEW_OK
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+        && status != GLEW_ERROR_NO_GLX_DISPLAY
+#endif
+       ) {
+        printf("Failed to initialize GLEW: %s\n", glewGetErrorString(status));
+        return false;
+    }
+    // Swallow the GL_INVALID_ENUM glewInit() leaves behind on core contexts.
+    glGetError();
+
+    return true;
+}
+
+static void
+destroy_headless_context(HeadlessContext *ctx) {
+    eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (ctx->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(ctx->display, ctx->surface);
+    }
+    if (ctx->context != EGL_NO_CONTEXT) {
+        eglDestroyContext(ctx->display, ctx->context);
+    }
+    eglTerminate(ctx->display);
+}
+
+#else
+
+typedef struct HeadlessContext {
+    int unused;
+} HeadlessContext;
+
+static bool
+create_headless_context(HeadlessContext *ctx) {
+    (void)ctx;
+    printf("Headless mode requires EGL and is only supported on Linux\n");
+    return false;
+}
+
+static void
+destroy_headless_context(HeadlessContext *ctx) {
+    (void)ctx;
+}
+
+#endif
+
+static double
+performance_counter_to_ms(Uint64 counter) {
+    return counter * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Renders options->warmup + options->frames frames with init()/render() and
+// prints the results for the measured frames. Returns the process exit code.
+static int
+run_headless(const char *name, HeadlessOptions *options,
+             void (*init)(void), void (*render)(void)) {
+    SDL_Init(SDL_INIT_TIMER);
+
+    HeadlessContext ctx;
+    if (!create_headless_context(&ctx)) {
+        destroy_headless_context(&ctx);
+        return -1;
+    }
+
+    GLuint fbo, color_rbo, depth_rbo;
+    glGenRenderbuffers(1, &color_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options->width,
+                          options->height);
+    // Samples that never enable GL_DEPTH_TEST are unaffected by this.
+    glGenRenderbuffers(1, &depth_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, options->width,
+                          options->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, color_rbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_rbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Offscreen framebuffer is incomplete\n");
+        destroy_headless_context(&ctx);
+        return -1;
+    }
+
+    glViewport(0, 0, options->width, options->height);
+
+    if (init) {
+        init();
+    }
+
+    GLuint queries[HEADLESS_QUERY_COUNT];
+    glGenQueries(HEADLESS_QUERY_COUNT, queries);
+
+    int total_frames = options->warmup + options->frames;
+    double *cpu_ms = heap_alloc(options->frames * sizeof(double));
+    double *gpu_ms = heap_alloc(options->frames * sizeof(double));
+
+    Uint64 frame_begin = SDL_GetPerformanceCounter();
+    for (int frame = 0; frame < total_frames + HEADLESS_QUERY_COUNT; ++frame) {
+        int slot = frame % HEADLESS_QUERY_COUNT;
+
+        int retired_frame = frame - HEADLESS_QUERY_COUNT;
+        if (retired_frame >= options->warmup) {
+            GLuint64 elapsed;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+            gpu_ms[retired_frame - options->warmup] = elapsed / 1.0e6;
+        }
+
+        if (frame < total_frames) {
+            reset_gl_state_stats();
+            reset_memory_stats();
+            begin_frame_arena(&FRAME_ARENA);
+            glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+            render();
+            glEndQuery(GL_TIME_ELAPSED);
+            glFlush();
+
+            Uint64 frame_end = SDL_GetPerformanceCounter();
+            if (frame >= options->warmup) {
+                cpu_ms[frame - options->warmup] =
+                    performance_counter_to_ms(frame_end - frame_begin);
+            }
+            frame_begin = frame_end;
+        }
+    }
+
+    GLenum error = glGetError();
+
+    HeadlessReport report;
+    report.frames = options->frames;
+    report.cpu_ms_total = 0;
+    for (int i = 0; i < options->frames; ++i) {
+        report.cpu_ms_total += cpu_ms[i];
+    }
+    report.cpu_ms = compute_frame_time_stats(cpu_ms, options->frames);
+    report.gpu_ms = compute_frame_time_stats(gpu_ms, options->frames);
+
+    printf("{\"sample\":");
+    print_json_string(name);
+    printf(",\"renderer\":");
+    print_json_string((const char *)glGetString(GL_RENDERER));
+    printf(",\"version\":");
+    print_json_string((const char *)glGetString(GL_VERSION));
+    printf(",\"width\":%d,\"height\":%d,\"frames\":%d,\"warmup\":%d,",
+           options->width, options->height, options->frames, options->warmup);
+    print_frame_time_stats("cpu_ms", report.cpu_ms);
+    putchar(',');
+    print_frame_time_stats("gpu_ms", report.gpu_ms);
+    // From the last frame, which is past any one-off setup binds.
+    printf(",\"gl_calls_issued\":%d,\"gl_calls_elided\":%d",
+           GL_STATE.stats.issued, GL_STATE.stats.elided);
+    printf(",\"heap_allocs\":%d,\"heap_frees\":%d,\"arena_bytes\":%lu,"
+           "\"arena_peak\":%lu,\"arena_overflows\":%d",
+           SDL_AtomicGet(&MEMORY_STATS.heap_allocs),
+           SDL_AtomicGet(&MEMORY_STATS.heap_frees),
+           (unsigned long)MEMORY_STATS.arena_bytes,
+           (unsigned long)MEMORY_STATS.arena_peak,
+           MEMORY_STATS.arena_overflows);
+    if (options->report) {
+        options->report(&report);
+    }
+    printf(",\"gl_error\":%u}\n", error);
+    fflush(stdout);
+
+    if (options->shutdown) {
+        options->shutdown();
+    }
+
+    heap_free(cpu_ms);
+    heap_free(gpu_ms);
+
+    glDeleteQueries(HEADLESS_QUERY_COUNT, queries);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &color_rbo);
+    glDeleteRenderbuffers(1, &depth_rbo);
+
+    destroy_headless_context(&ctx);
+    SDL_Quit();
+
+    return error == GL_NO_ERROR ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,445 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+// GPU-driven drawing with glMultiDrawElementsIndirect.
+//
+// MeshBuffer keeps many meshes in one shared VBO/EBO, each a MeshRange
+// (first index, index count, base vertex), so every mesh draws from the same
+// VAO and a whole scene can go out in one multi-draw.
+//
+// IndirectRenderer owns the DrawElementsIndirectCommand buffer. The commands
+// come either from the CPU (submit_draw_commands()) or from
+// cull_instances_on_gpu(), which runs a compute shader with one invocation
+// per instance: it tests the instance's bounding sphere against the frustum
+// and writes the instance's command. draw_indirect() then submits them all
+// with a single call.
+//
+// With ARB_indirect_parameters the shader appends only the visible commands
+// and counts them in a parameter buffer that
+// glMultiDrawElementsIndirectCountARB() reads, so the CPU never learns the
+// count. Without it every instance gets a command and culled ones have an
+// instance_count of 0.
+//
+// Each command draws one instance with base_instance set to the instance's
+// index, so vertex attributes with a divisor of 1 read that instance's data
+// straight from the instance buffer. Instances start with a GpuCullInstance,
+// which is all the culling shader reads.
+//
+// Compute culling needs ARB_compute_shader, ARB_shader_storage_buffer_object
+// and ARB_multi_draw_indirect (GL 4.3); see is_gpu_culling_supported().
+
+#include <math.h>
+#include <stdint.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+#include "common/shader.h"
+#include "common/vector_math.h"
+
+#define MAX_MESH_RANGES 64
+#define GPU_CULL_GROUP_SIZE 64
+
+static char *GPU_CULL_SHADER = "                                              \
+#version 430 core                                                           \n\
+                                                                            \n\
+layout (local_size_x = 64) in;                                              \n\
+                                                                            \n\
+// Match GpuCullInstance, MeshRange and DrawElementsIndirectCommand.        \n\
+struct Instance {                                                           \n\
+    vec4 center_scale;                                                      \n\
+    uint mesh;                                                              \n\
+    uint data[3];                                                           \n\
+};                                                                          \n\
+                                                                            \n\
+struct MeshRange {                                                          \n\
+    uint index_count;                                                       \n\
+    uint first_index;                                                       \n\
+    int base_vertex;                                                        \n\
+    float radius;                                                           \n\
+};                                                                          \n\
+                                                                            \n\
+struct Command {                                                            \n\
+    uint count;                                                             \n\
+    uint instance_count;                                                    \n\
+    uint first_index;                                                       \n\
+    int base_vertex;                                                        \n\
+    uint base_instance;                                                     \n\
+};                                                                          \n\
+                                                                            \n\
+layout (std430, binding = 0) readonly buffer Instances {                    \n\
+    Instance instances[];                                                   \n\
+};                                                                          \n\
+                                                                            \n\
+layout (std430, binding = 1) readonly buffer Meshes {                       \n\
+    MeshRange meshes[];                                                     \n\
+};                                                                          \n\
+                                                                            \n\
+layout (std430, binding = 2) writeonly buffer Commands {                    \n\
+    Command commands[];                                                     \n\
+};                                                                          \n\
+                                                                            \n\
+layout (std430, binding = 3) buffer Parameters {                            \n\
+    uint draw_count;                                                        \n\
+};                                                                          \n\
+                                                                            \n\
+uniform vec4 planes[6];                                                     \n\
+uniform uint instance_count;                                                \n\
+// Append visible commands and count them, instead of one command per       \n\
+// instance with instance_count 0 for the culled ones.                      \n\
+uniform bool compact;                                                       \n\
+                                                                            \n\
+void main() {                                                               \n\
+    uint id = gl_GlobalInvocationID.x;                                      \n\
+    if (id >= instance_count) {                                             \n\
+        return;                                                             \n\
+    }                                                                       \n\
+                                                                            \n\
+    Instance instance = instances[id];                                      \n\
+    MeshRange mesh = meshes[instance.mesh];                                 \n\
+    vec3 center = instance.center_scale.xyz;                                \n\
+    float radius = mesh.radius * instance.center_scale.w;                   \n\
+                                                                            \n\
+    bool visible = true;                                                    \n\
+    for (int i = 0; i < 6; ++i) {                                           \n\
+        float distance = dot(planes[i].xyz, center) + planes[i].w;          \n\
+        visible = visible && !(distance < -radius);                         \n\
+    }                                                                       \n\
+                                                                            \n\
+    Command command = Command(mesh.index_count, visible ? 1u : 0u,          \n\
+                              mesh.first_index, mesh.base_vertex, id);      \n\
+    if (!compact) {                                                         \n\
+        commands[id] = command;                                             \n\
+    } else if (visible) {                                                   \n\
+        commands[atomicAdd(draw_count, 1u)] = command;                      \n\
+    }                                                                       \n\
+}                                                                             \
+";
+
+enum {
+    GPU_CULL_UNIFORM_PLANES,
+    GPU_CULL_UNIFORM_INSTANCE_COUNT,
+    GPU_CULL_UNIFORM_COMPACT,
+    GPU_CULL_UNIFORM_COUNT,
+};
+
+static const char *GPU_CULL_UNIFORM_NAMES[GPU_CULL_UNIFORM_COUNT] = {
+    "planes",
+    "instance_count",
+    "compact",
+};
+
+// The layout glMultiDrawElementsIndirect() reads.
+typedef struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+} DrawElementsIndirectCommand;
+
+// Also read by the culling shader, hence the std430-friendly layout.
+typedef struct MeshRange {
+    GLuint index_count;
+    GLuint first_index;
+    GLint base_vertex;
+    // Of the mesh's positions around its origin.
+    GLfloat radius;
+} MeshRange;
+
+// 32 bytes, like the std430 struct the culling shader reads. `data` is free
+// for the caller's own per-instance attributes.
+typedef struct GpuCullInstance {
+    GLfloat center[3];
+    GLfloat scale;
+    GLuint mesh;
+    GLuint data[3];
+} GpuCullInstance;
+
+typedef struct MeshBuffer {
+    GLuint vao, vbo, ebo;
+    GLsizei vertex_size;
+    int vertex_capacity;
+    int vertex_count;
+    int index_capacity;
+    int index_count;
+
+    MeshRange ranges[MAX_MESH_RANGES];
+    int range_count;
+} MeshBuffer;
+
+typedef struct IndirectRenderer {
+    int capacity;
+    GLuint command_buffer;
+    GLuint parameter_buffer;
+    int draw_count;
+    // Whether the last commands came from cull_instances_on_gpu() with a
+    // count in parameter_buffer.
+    bool gpu_count;
+
+    bool gpu_culling;
+    bool indirect_parameters;
+    Program cull_program;
+    GLuint mesh_ssbo;
+} IndirectRenderer;
+
+// Indices are GL_UNSIGNED_INT. The VAO has only the element buffer attached;
+// bind it and the VBO and set up the vertex attributes afterwards.
+static void
+init_mesh_buffer(MeshBuffer *buffer, GLsizei vertex_size, int vertex_capacity,
+                 int index_capacity) {
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->vertex_size = vertex_size;
+    buffer->vertex_capacity = vertex_capacity;
+    buffer->index_capacity = index_capacity;
+
+    glGenVertexArrays(1, &buffer->vao);
+    bind_vertex_array(buffer->vao);
+
+    glGenBuffers(1, &buffer->vbo);
+    bind_buffer(GL_ARRAY_BUFFER, buffer->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertex_capacity * vertex_size,
+                 0, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &buffer->ebo);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffer->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 (GLsizeiptr)index_capacity * sizeof(GLuint), 0,
+                 GL_STATIC_DRAW);
+
+    bind_vertex_array(0);
+}
+
+static void
+free_mesh_buffer(MeshBuffer *buffer) {
+    delete_vertex_arrays(1, &buffer->vao);
+    delete_buffers(1, &buffer->vbo);
+    delete_buffers(1, &buffer->ebo);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// Appends a mesh whose vertices each start with a GLfloat position. Indices
+// are relative to the mesh's own first vertex. Returns the mesh's index in
+// ranges[], or -1 if the buffer is full.
+static int
+add_mesh_to_buffer(MeshBuffer *buffer, const void *vertices, int vertex_count,
+                   const GLuint *indices, int index_count) {
+    if (buffer->range_count == MAX_MESH_RANGES ||
+        buffer->vertex_count + vertex_count > buffer->vertex_capacity ||
+        buffer->index_count + index_count > buffer->index_capacity) {
+        printf("Mesh buffer is full\n");
+        return -1;
+    }
+
+    float radius = 0.0f;
+    for (int i = 0; i < vertex_count; ++i) {
+        const GLfloat *p = (const GLfloat *)((const char *)vertices +
+                                             i * buffer->vertex_size);
+        radius = fmaxf(radius, sqrtf(p[0] * p[0] + p[1] * p[1] +
+                                     p[2] * p[2]));
+    }
+
+    bind_buffer(GL_ARRAY_BUFFER, buffer->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    (GLintptr)buffer->vertex_count * buffer->vertex_size,
+                    (GLsizeiptr)vertex_count * buffer->vertex_size, vertices);
+
+    // Outside of any VAO, so the copy cannot disturb the one bound.
+    bind_vertex_array(0);
+    bind_buffer(GL_COPY_WRITE_BUFFER, buffer->ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    (GLintptr)buffer->index_count * sizeof(GLuint),
+                    (GLsizeiptr)index_count * sizeof(GLuint), indices);
+
+    int result = buffer->range_count++;
+    MeshRange *range = &buffer->ranges[result];
+    range->index_count = index_count;
+    range->first_index = buffer->index_count;
+    range->base_vertex = buffer->vertex_count;
+    range->radius = radius;
+
+    buffer->vertex_count += vertex_count;
+    buffer->index_count += index_count;
+
+    return result;
+}
+
+// A command drawing `instance_count` instances of `mesh` starting at
+// `base_instance`.
+static DrawElementsIndirectCommand
+make_draw_command(const MeshBuffer *buffer, int mesh, GLuint instance_count,
+                  GLuint base_instance) {
+    const MeshRange *range = &buffer->ranges[mesh];
+    DrawElementsIndirectCommand result = {
+        range->index_count, instance_count, range->first_index,
+        range->base_vertex, base_instance,
+    };
+    return result;
+}
+
+static bool
+is_gpu_culling_supported(void) {
+    return GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object &&
+           GLEW_ARB_multi_draw_indirect;
+}
+
+// `capacity` is the most commands (instances) drawn at once. The meshes must
+// all be in `meshes` before this is called.
+static bool
+init_indirect_renderer(IndirectRenderer *renderer, const MeshBuffer *meshes,
+                       int capacity) {
+    memset(renderer, 0, sizeof(*renderer));
+    renderer->capacity = capacity;
+
+    if (!GLEW_ARB_multi_draw_indirect) {
+        printf("Failed to create indirect renderer: "
+               "ARB_multi_draw_indirect is not supported\n");
+        return false;
+    }
+
+    glGenBuffers(1, &renderer->command_buffer);
+    bind_buffer(GL_DRAW_INDIRECT_BUFFER, renderer->command_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 (GLsizeiptr)capacity * sizeof(DrawElementsIndirectCommand), 0,
+                 GL_DYNAMIC_DRAW);
+
+    renderer->gpu_culling = is_gpu_culling_supported();
+    if (renderer->gpu_culling) {
+        renderer->cull_program = create_compute_program(
+            GPU_CULL_SHADER, GPU_CULL_UNIFORM_NAMES, GPU_CULL_UNIFORM_COUNT);
+        renderer->gpu_culling = renderer->cull_program.id != 0;
+    }
+
+    if (renderer->gpu_culling) {
+        glGenBuffers(1, &renderer->mesh_ssbo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->mesh_ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER,
+                     meshes->range_count * sizeof(MeshRange), meshes->ranges,
+                     GL_STATIC_DRAW);
+
+        glGenBuffers(1, &renderer->parameter_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->parameter_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), 0,
+                     GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        renderer->indirect_parameters = GLEW_ARB_indirect_parameters;
+    }
+
+    return true;
+}
+
+static void
+free_indirect_renderer(IndirectRenderer *renderer) {
+    delete_buffers(1, &renderer->command_buffer);
+    if (renderer->gpu_culling) {
+        delete_buffers(1, &renderer->mesh_ssbo);
+        delete_buffers(1, &renderer->parameter_buffer);
+        glDeleteProgram(renderer->cull_program.id);
+    }
+    memset(renderer, 0, sizeof(*renderer));
+}
+
+static void
+submit_draw_commands(IndirectRenderer *renderer,
+                     const DrawElementsIndirectCommand *commands, int count) {
+    if (count > renderer->capacity) {
+        count = renderer->capacity;
+    }
+    bind_buffer(GL_DRAW_INDIRECT_BUFFER, renderer->command_buffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                    count * sizeof(DrawElementsIndirectCommand), commands);
+    renderer->draw_count = count;
+    renderer->gpu_count = false;
+}
+
+// Culls `count` instances, each starting with a GpuCullInstance, from
+// `instance_buffer` and leaves one command per visible instance for
+// draw_indirect().
+static void
+cull_instances_on_gpu(IndirectRenderer *renderer, const Frustum *frustum,
+                      GLuint instance_buffer, int count) {
+    if (!renderer->gpu_culling) {
+        return;
+    }
+    if (count > renderer->capacity) {
+        count = renderer->capacity;
+    }
+
+    bool compact = renderer->indirect_parameters;
+    if (compact) {
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->parameter_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+    }
+
+    use_program(renderer->cull_program.id);
+    glUniform4fv(renderer->cull_program.uniforms[GPU_CULL_UNIFORM_PLANES], 6,
+                 &frustum->planes[0].x);
+    glUniform1ui(
+        renderer->cull_program.uniforms[GPU_CULL_UNIFORM_INSTANCE_COUNT],
+        count);
+    glUniform1i(renderer->cull_program.uniforms[GPU_CULL_UNIFORM_COMPACT],
+                compact);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instance_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, renderer->mesh_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, renderer->command_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, renderer->parameter_buffer);
+
+    glDispatchCompute((count + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE,
+                      1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+    renderer->draw_count = count;
+    renderer->gpu_count = compact;
+}
+
+// Draws the last commands with the program and instance attributes the
+// caller has set up on meshes->vao.
+static void
+draw_indirect(IndirectRenderer *renderer, const MeshBuffer *meshes) {
+    bind_vertex_array(meshes->vao);
+    bind_buffer(GL_DRAW_INDIRECT_BUFFER, renderer->command_buffer);
+
+    if (renderer->gpu_count) {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, renderer->parameter_buffer);
+        glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, 0,
+                                            0, renderer->draw_count, 0);
+    } else {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0,
+                                    renderer->draw_count, 0);
+    }
+}
+
+// Reads back how many instances the last GPU cull left visible. Stalls until
+// the GPU is done, so it is for checking results, not for every frame.
+static int
+read_gpu_visible_count(IndirectRenderer *renderer) {
+    int result = 0;
+
+    // The cull dispatch only orders its writes before the indirect draws;
+    // reading them back through glGetBufferSubData needs its own barrier.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (renderer->gpu_count) {
+        GLuint count = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->parameter_buffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+        result = count;
+    } else {
+        DrawElementsIndirectCommand *commands = heap_alloc(
+            renderer->draw_count * sizeof(DrawElementsIndirectCommand));
+        bind_buffer(GL_DRAW_INDIRECT_BUFFER, renderer->command_buffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                           renderer->draw_count *
+                           sizeof(DrawElementsIndirectCommand), commands);
+        for (int i = 0; i < renderer->draw_count; ++i) {
+            result += commands[i].instance_count;
+        }
+        heap_free(commands);
+    }
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+// Work-stealing job system for CPU work that does not touch GL.
+//
+// init_job_system() starts thread_count - 1 worker threads; the thread that
+// calls run_parallel_for() is thread 0 and works too, so thread_count is the
+// number of cores used. run_parallel_for() splits [0, count) into batches,
+// deals them out round-robin to every thread's queue and returns once all of
+// them have run. Each thread takes jobs from the back of its own queue and,
+// when that is empty, steals from the front of someone else's, so uneven
+// batches even out without a central queue everyone contends on.
+//
+// Jobs receive the index of the thread running them, which is how they find
+// per-thread data (see common/render_commands.h) without any locking.
+//
+// Queues are protected by spinlocks that are only held for a push or pop.
+
+#define MAX_JOB_THREADS 16
+// Power of two.
+#define JOB_QUEUE_SIZE 1024
+
+typedef void (*JobFunction)(void *data, int begin, int end, int thread);
+
+typedef struct Job {
+    JobFunction function;
+    void *data;
+    int begin;
+    int end;
+} Job;
+
+typedef struct JobQueue {
+    SDL_SpinLock lock;
+    // The owner pushes and pops at bottom, thieves take from top.
+    int top;
+    int bottom;
+    Job jobs[JOB_QUEUE_SIZE];
+} JobQueue;
+
+typedef struct JobSystem JobSystem;
+
+typedef struct JobWorker {
+    JobSystem *system;
+    int index;
+    SDL_Thread *thread;
+} JobWorker;
+
+struct JobSystem {
+    int thread_count;
+    JobQueue queues[MAX_JOB_THREADS];
+    JobWorker workers[MAX_JOB_THREADS];
+
+    SDL_sem *wake;
+    SDL_atomic_t pending;
+    SDL_atomic_t quit;
+
+    // Per thread, reset by reset_job_stats().
+    int jobs_run[MAX_JOB_THREADS];
+    int jobs_stolen[MAX_JOB_THREADS];
+};
+
+static bool
+push_job(JobQueue *queue, const Job *job) {
+    bool result = false;
+
+    SDL_AtomicLock(&queue->lock);
+    if (queue->bottom - queue->top < JOB_QUEUE_SIZE) {
+        queue->jobs[queue->bottom & (JOB_QUEUE_SIZE - 1)] = *job;
+        queue->bottom++;
+        result = true;
+    }
+    SDL_AtomicUnlock(&queue->lock);
+
+    return result;
+}
+
+static bool
+pop_job(JobQueue *queue, Job *job, bool steal) {
+    bool result = false;
+
+    SDL_AtomicLock(&queue->lock);
+    if (queue->bottom > queue->top) {
+        if (steal) {
+            *job = queue->jobs[queue->top & (JOB_QUEUE_SIZE - 1)];
+            queue->top++;
+        } else {
+            queue->bottom--;
+            *job = queue->jobs[queue->bottom & (JOB_QUEUE_SIZE - 1)];
+        }
+        result = true;
+    }
+    SDL_AtomicUnlock(&queue->lock);
+
+    return result;
+}
+
+// Runs one job from the thread's own queue or, failing that, one stolen from
+// another thread. Returns false if there was nothing to do.
+static bool
+run_one_job(JobSystem *system, int thread) {
+    Job job;
+    bool found = pop_job(&system->queues[thread], &job, false);
+
+    for (int i = 1; !found && i < system->thread_count; ++i) {
+        int victim = (thread + i) % system->thread_count;
+        found = pop_job(&system->queues[victim], &job, true);
+        if (found) {
+            system->jobs_stolen[thread]++;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    job.function(job.data, job.begin, job.end, thread);
+    system->jobs_run[thread]++;
+    SDL_AtomicAdd(&system->pending, -1);
+
+    return true;
+}
+
+static int
+job_worker(void *data) {
+    JobWorker *worker = data;
+    JobSystem *system = worker->system;
+
+    while (!SDL_AtomicGet(&system->quit)) {
+        if (!run_one_job(system, worker->index)) {
+            SDL_SemWait(system->wake);
+        }
+    }
+
+    return 0;
+}
+
+// A thread_count of 0 or less uses every core.
+static void
+init_job_system(JobSystem *system, int thread_count) {
+    memset(system, 0, sizeof(*system));
+
+    if (thread_count <= 0) {
+        thread_count = SDL_GetCPUCount();
+    }
+    if (thread_count > MAX_JOB_THREADS) {
+        thread_count = MAX_JOB_THREADS;
+    }
+    system->thread_count = thread_count;
+    system->wake = SDL_CreateSemaphore(0);
+
+    for (int i = 1; i < thread_count; ++i) {
+        JobWorker *worker = &system->workers[i];
+        worker->system = system;
+        worker->index = i;
+        worker->thread = SDL_CreateThread(job_worker, "JobWorker", worker);
+    }
+}
+
+static void
+shutdown_job_system(JobSystem *system) {
+    SDL_AtomicSet(&system->quit, 1);
+    for (int i = 1; i < system->thread_count; ++i) {
+        SDL_SemPost(system->wake);
+    }
+    for (int i = 1; i < system->thread_count; ++i) {
+        SDL_WaitThread(system->workers[i].thread, 0);
+    }
+    SDL_DestroySemaphore(system->wake);
+}
+
+// Calls function(data, begin, end, thread) over [0, count) in batches of
+// batch_size and returns when every batch is done.
+static void
+run_parallel_for(JobSystem *system, int count, int batch_size,
+                 JobFunction function, void *data) {
+    if (batch_size < 1) {
+        batch_size = 1;
+    }
+
+    int job_count = (count + batch_size - 1) / batch_size;
+    SDL_AtomicAdd(&system->pending, job_count);
+
+    for (int i = 0; i < job_count; ++i) {
+        Job job = {
+            .function = function,
+            .data = data,
+            .begin = i * batch_size,
+            .end = (i + 1) * batch_size < count ? (i + 1) * batch_size :
+                                                  count,
+        };
+        if (!push_job(&system->queues[i % system->thread_count], &job)) {
+            // Queue full: do it now rather than drop it.
+            function(data, job.begin, job.end, 0);
+            system->jobs_run[0]++;
+            SDL_AtomicAdd(&system->pending, -1);
+        }
+    }
+
+    int wake_count = job_count < system->thread_count - 1 ?
+                     job_count : system->thread_count - 1;
+    for (int i = 0; i < wake_count; ++i) {
+        SDL_SemPost(system->wake);
+    }
+
+    // Help out until everything has finished, including jobs other threads
+    // are still in the middle of.
+    while (SDL_AtomicGet(&system->pending) > 0) {
+        run_one_job(system, 0);
+    }
+}
+
+static void
+reset_job_stats(JobSystem *system) {
+    memset(system->jobs_run, 0, sizeof(system->jobs_run));
+    memset(system->jobs_stolen, 0, sizeof(system->jobs_stolen));
+}
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+// Counted heap allocation, arenas for per-frame data and fixed-size pools.
+//
+// Everything in common/ allocates through heap_alloc(), heap_calloc(),
+// heap_realloc() and heap_free(), which count calls in MEMORY_STATS.
+// run_headless() resets the counters every frame and reports the last one,
+// so a steady-state frame that shows heap_allocs 0 really did not touch the
+// heap (from our code; the driver's allocations are not counted).
+//
+// Transient data goes in arenas instead:
+//
+//   Arena       one block, bump allocated, reset all at once. If a frame
+//               needs more than the block holds the overflow comes from the
+//               heap, and the next reset grows the block to the peak, so the
+//               heap is only touched until the arena has warmed up.
+//   FrameArena  FRAME_ARENA_COUNT arenas used in rotation by
+//               begin_frame_arena(), so data written in one frame (say, what
+//               the GPU reads from a mapped buffer) stays valid through the
+//               next.
+//
+// FRAME_ARENA is the sample framework's: run_headless() and begin_frame()
+// advance it every frame.
+//
+// Pools hand out fixed-size slots from one block through a free list, for
+// long-lived objects that come and go (watched programs, GL handles) without
+// fragmenting the heap.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+#define FRAME_ARENA_COUNT 2
+#define DEFAULT_FRAME_ARENA_SIZE (1024 * 1024)
+
+typedef struct MemoryStats {
+    // Counted since the last reset_memory_stats(). Atomic since job threads
+    // allocate too.
+    SDL_atomic_t heap_allocs;
+    SDL_atomic_t heap_frees;
+    // Bytes taken from arenas and the largest any arena has needed.
+    size_t arena_bytes;
+    size_t arena_peak;
+    int arena_overflows;
+} MemoryStats;
+
+static MemoryStats MEMORY_STATS;
+
+static void
+reset_memory_stats(void) {
+    SDL_AtomicSet(&MEMORY_STATS.heap_allocs, 0);
+    SDL_AtomicSet(&MEMORY_STATS.heap_frees, 0);
+    MEMORY_STATS.arena_bytes = 0;
+    MEMORY_STATS.arena_overflows = 0;
+}
+
+static void *
+heap_alloc(size_t size) {
+    SDL_AtomicAdd(&MEMORY_STATS.heap_allocs, 1);
+    return malloc(size);
+}
+
+static void *
+heap_calloc(size_t count, size_t size) {
+    SDL_AtomicAdd(&MEMORY_STATS.heap_allocs, 1);
+    return calloc(count, size);
+}
+
+static void *
+heap_realloc(void *memory, size_t size) {
+    SDL_AtomicAdd(&MEMORY_STATS.heap_allocs, 1);
+    return realloc(memory, size);
+}
+
+static void
+heap_free(void *memory) {
+    if (memory) {
+        SDL_AtomicAdd(&MEMORY_STATS.heap_frees, 1);
+        free(memory);
+    }
+}
+
+//
+// Arenas
+//
+
+typedef struct ArenaOverflow {
+    struct ArenaOverflow *next;
+} ArenaOverflow;
+
+typedef struct Arena {
+    unsigned char *memory;
+    size_t size;
+    size_t used;
+
+    // Heap blocks for allocations that did not fit, freed on reset.
+    ArenaOverflow *overflow;
+    // Bytes asked for since the last reset, including overflow.
+    size_t requested;
+    size_t peak;
+} Arena;
+
+static void
+init_arena(Arena *arena, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->size = size;
+    arena->memory = heap_alloc(size);
+}
+
+static void
+free_arena(Arena *arena) {
+    while (arena->overflow) {
+        ArenaOverflow *next = arena->overflow->next;
+        heap_free(arena->overflow);
+        arena->overflow = next;
+    }
+    heap_free(arena->memory);
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Returns ARENA_ALIGNMENT aligned memory that stays valid until the arena is
+// reset. Never returns 0 unless the heap is exhausted.
+static void *
+allocate_from_arena(Arena *arena, size_t size) {
+    size_t aligned = (size + ARENA_ALIGNMENT - 1) &
+                     ~(size_t)(ARENA_ALIGNMENT - 1);
+    arena->requested += aligned;
+    if (arena->requested > arena->peak) {
+        arena->peak = arena->requested;
+    }
+    if (arena->peak > MEMORY_STATS.arena_peak) {
+        MEMORY_STATS.arena_peak = arena->peak;
+    }
+    MEMORY_STATS.arena_bytes += aligned;
+
+    if (arena->used + aligned <= arena->size) {
+        void *result = arena->memory + arena->used;
+        arena->used += aligned;
+        return result;
+    }
+
+    // Keep the header a multiple of the alignment so the data after it is
+    // aligned too.
+    MEMORY_STATS.arena_overflows++;
+    ArenaOverflow *overflow = heap_alloc(ARENA_ALIGNMENT + aligned);
+    if (!overflow) {
+        return 0;
+    }
+    overflow->next = arena->overflow;
+    arena->overflow = overflow;
+    return (unsigned char *)overflow + ARENA_ALIGNMENT;
+}
+
+// Invalidates everything allocated so far. If the arena overflowed since the
+// last reset it grows to fit its peak.
+static void
+reset_arena(Arena *arena) {
+    if (arena->overflow) {
+        while (arena->overflow) {
+            ArenaOverflow *next = arena->overflow->next;
+            heap_free(arena->overflow);
+            arena->overflow = next;
+        }
+        heap_free(arena->memory);
+        arena->size = arena->peak;
+        arena->memory = heap_alloc(arena->size);
+    }
+
+    arena->used = 0;
+    arena->requested = 0;
+}
+
+typedef struct FrameArena {
+    Arena arenas[FRAME_ARENA_COUNT];
+    int frame;
+} FrameArena;
+
+static FrameArena FRAME_ARENA;
+
+static void
+init_frame_arena(FrameArena *frame_arena, size_t size) {
+    for (int i = 0; i < FRAME_ARENA_COUNT; ++i) {
+        init_arena(&frame_arena->arenas[i], size);
+    }
+    frame_arena->frame = 0;
+}
+
+// The arena for the current frame.
+static Arena *
+get_frame_arena(FrameArena *frame_arena) {
+    return &frame_arena->arenas[frame_arena->frame % FRAME_ARENA_COUNT];
+}
+
+// Moves on to the next arena and resets it. What the previous
+// FRAME_ARENA_COUNT - 1 frames allocated is still valid. Initializes the
+// arenas with the default size on first use.
+static void
+begin_frame_arena(FrameArena *frame_arena) {
+    if (!frame_arena->arenas[0].memory) {
+        init_frame_arena(frame_arena, DEFAULT_FRAME_ARENA_SIZE);
+    }
+
+    frame_arena->frame++;
+    reset_arena(get_frame_arena(frame_arena));
+}
+
+// Shorthand for allocating from the sample framework's FRAME_ARENA.
+static void *
+allocate_frame_memory(size_t size) {
+    return allocate_from_arena(get_frame_arena(&FRAME_ARENA), size);
+}
+
+//
+// Pools
+//
+
+typedef struct Pool {
+    unsigned char *memory;
+    // One byte per slot, set while the slot is allocated.
+    unsigned char *live;
+    size_t slot_size;
+    int capacity;
+    // Index of the first free slot, or -1. Free slots hold the next index.
+    int free_head;
+    int used;
+    int peak;
+} Pool;
+
+static void
+init_pool(Pool *pool, size_t item_size, int capacity) {
+    memset(pool, 0, sizeof(*pool));
+
+    pool->slot_size = item_size < sizeof(int) ? sizeof(int) : item_size;
+    pool->slot_size = (pool->slot_size + ARENA_ALIGNMENT - 1) &
+                      ~(size_t)(ARENA_ALIGNMENT - 1);
+    pool->capacity = capacity;
+    pool->memory = heap_alloc(pool->slot_size * capacity + capacity);
+    pool->live = pool->memory + pool->slot_size * capacity;
+    memset(pool->live, 0, capacity);
+
+    for (int i = 0; i < capacity; ++i) {
+        *(int *)(pool->memory + i * pool->slot_size) =
+            i + 1 < capacity ? i + 1 : -1;
+    }
+    pool->free_head = capacity > 0 ? 0 : -1;
+}
+
+static void
+free_pool(Pool *pool) {
+    heap_free(pool->memory);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Returns a zeroed slot, or 0 if the pool is full.
+static void *
+allocate_from_pool(Pool *pool) {
+    if (pool->free_head < 0) {
+        return 0;
+    }
+
+    int index = pool->free_head;
+    unsigned char *result = pool->memory + index * pool->slot_size;
+    pool->free_head = *(int *)result;
+    pool->live[index] = 1;
+    memset(result, 0, pool->slot_size);
+
+    pool->used++;
+    if (pool->used > pool->peak) {
+        pool->peak = pool->used;
+    }
+
+    return result;
+}
+
+static void
+release_to_pool(Pool *pool, void *item) {
+    int index = (int)(((unsigned char *)item - pool->memory) /
+                      pool->slot_size);
+    *(int *)item = pool->free_head;
+    pool->free_head = index;
+    pool->live[index] = 0;
+    pool->used--;
+}
+
+// Slot `index` if it is allocated, otherwise 0. For walking every live item:
+//
+//   for (int i = 0; i < pool.capacity; ++i) {
+//       Item *item = get_pool_item(&pool, i);
+//       if (item) { ... }
+//   }
+static void *
+get_pool_item(Pool *pool, int index) {
+    return pool->live[index] ? pool->memory + index * pool->slot_size : 0;
+}
+
+#endif
@@ -0,0 +1,871 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+// Mesh import, optimization and cooked meshes (.cmesh).
+//
+// load_obj_mesh() parses a Wavefront OBJ file into one interleaved vertex per
+// unique position/texcoord/normal triple, in the order the faces use them.
+// optimize_mesh() then reorders it for the GPU in three passes:
+//
+//   optimize_vertex_cache()  Forsyth's greedy triangle order, so consecutive
+//                            triangles share vertices that are still in the
+//                            post-transform cache.
+//   optimize_overdraw()      Splits that order into clusters where the cache
+//                            starts cold anyway and sorts the clusters so
+//                            outward-facing ones draw first, which lets early
+//                            depth reject more of what is behind them without
+//                            giving back the cache gains.
+//   optimize_vertex_fetch()  Renumbers vertices in first-use order, so the
+//                            vertex buffer is read front to back.
+//
+// compute_vertex_cache_stats() measures the result against a FIFO cache:
+// ACMR is transformed vertices per triangle (3.0 worst, about 0.5 ideal for a
+// large grid) and ATVR transformed vertices per unique vertex (1.0 ideal).
+//
+// tools/mesh_cooker.c runs all of this offline and writes the result as a
+// CookedMeshHeader followed by the vertices and indices. load_cooked_mesh()
+// maps that file and points the mesh straight into it.
+//
+// Vertices are MESH_VERTEX_FLOATS GLfloats: position, normal, texcoord. Pass
+// MESH_VERTEX_ATTRIBUTES to pack_mesh() to upload them.
+
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/mesh_packing.h"
+
+#define MESH_VERTEX_FLOATS 8
+
+#define COOKED_MESH_MAGIC 0x48534D43 // "CMSH"
+#define COOKED_MESH_VERSION 1
+
+// Cache size the optimizer targets and the statistics simulate.
+#define VERTEX_CACHE_SIZE 32
+
+static const MeshAttribute MESH_VERTEX_ATTRIBUTES[] = {
+    {0, 3, MESH_POSITION},
+    {1, 3, MESH_GENERIC},
+    {2, 2, MESH_TEXCOORD},
+};
+
+typedef struct Mesh {
+    GLfloat *vertices;
+    int vertex_count;
+    GLuint *indices;
+    int index_count;
+
+    // Set when the mesh points into a mapped .cmesh file.
+    void *mapping;
+    size_t mapping_size;
+} Mesh;
+
+typedef struct CookedMeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t vertex_offset;
+    uint32_t index_offset;
+} CookedMeshHeader;
+
+typedef struct VertexCacheStats {
+    double acmr;
+    double atvr;
+} VertexCacheStats;
+
+static void
+free_mesh(Mesh *mesh) {
+    if (mesh->mapping) {
+        munmap(mesh->mapping, mesh->mapping_size);
+    } else {
+        heap_free(mesh->vertices);
+        heap_free(mesh->indices);
+    }
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+//
+// OBJ import
+//
+
+typedef struct ObjArray {
+    GLfloat *data;
+    int count;
+    int capacity;
+} ObjArray;
+
+typedef struct ObjCorner {
+    int position;
+    int texcoord;
+    int normal;
+} ObjCorner;
+
+// Open addressing, keyed on a face corner, mapping to a vertex index.
+typedef struct ObjVertexTable {
+    ObjCorner *keys;
+    int *values;
+    int capacity;
+} ObjVertexTable;
+
+static void
+push_obj_floats(ObjArray *array, const GLfloat *values, int count) {
+    if (array->count + count > array->capacity) {
+        array->capacity = array->capacity ? array->capacity * 2 : 1024;
+        array->data = heap_realloc(array->data,
+                                   array->capacity * sizeof(GLfloat));
+    }
+    memcpy(array->data + array->count, values, count * sizeof(GLfloat));
+    array->count += count;
+}
+
+static uint32_t
+hash_obj_corner(ObjCorner corner) {
+    uint32_t hash = (uint32_t)corner.position * 73856093u;
+    hash ^= (uint32_t)corner.texcoord * 19349663u;
+    hash ^= (uint32_t)corner.normal * 83492791u;
+    return hash;
+}
+
+static void
+grow_obj_vertex_table(ObjVertexTable *table) {
+    ObjVertexTable old = *table;
+
+    table->capacity = old.capacity ? old.capacity * 2 : 4096;
+    table->keys = heap_alloc(table->capacity * sizeof(ObjCorner));
+    table->values = heap_alloc(table->capacity * sizeof(int));
+    for (int i = 0; i < table->capacity; ++i) {
+        table->values[i] = -1;
+    }
+
+    for (int i = 0; i < old.capacity; ++i) {
+        if (old.values[i] >= 0) {
+            uint32_t slot = hash_obj_corner(old.keys[i]) &
+                            (table->capacity - 1);
+            while (table->values[slot] >= 0) {
+                slot = (slot + 1) & (table->capacity - 1);
+            }
+            table->keys[slot] = old.keys[i];
+            table->values[slot] = old.values[i];
+        }
+    }
+
+    heap_free(old.keys);
+    heap_free(old.values);
+}
+
+// Converts a 1-based or negative (relative) OBJ index to 0-based, or -1.
+static int
+resolve_obj_index(long index, int count) {
+    if (index > 0 && index <= count) {
+        return (int)index - 1;
+    }
+    if (index < 0 && -index <= count) {
+        return count + (int)index;
+    }
+    return -1;
+}
+
+// Parses "p", "p/t", "p//n" or "p/t/n".
+static const char *
+parse_obj_corner(const char *p, ObjCorner *corner, int position_count,
+                 int texcoord_count, int normal_count) {
+    char *end;
+    corner->position = resolve_obj_index(strtol(p, &end, 10), position_count);
+    corner->texcoord = -1;
+    corner->normal = -1;
+    p = end;
+
+    if (*p == '/') {
+        p++;
+        if (*p != '/') {
+            corner->texcoord = resolve_obj_index(strtol(p, &end, 10),
+                                                 texcoord_count);
+            p = end;
+        }
+        if (*p == '/') {
+            p++;
+            corner->normal = resolve_obj_index(strtol(p, &end, 10),
+                                               normal_count);
+            p = end;
+        }
+    }
+
+    return p;
+}
+
+// Area-weighted vertex normals, for files without any.
+static void
+generate_mesh_normals(Mesh *mesh) {
+    for (int i = 0; i < mesh->vertex_count; ++i) {
+        GLfloat *normal = mesh->vertices + i * MESH_VERTEX_FLOATS + 3;
+        normal[0] = normal[1] = normal[2] = 0;
+    }
+
+    for (int i = 0; i + 2 < mesh->index_count; i += 3) {
+        GLfloat *a = mesh->vertices + mesh->indices[i] * MESH_VERTEX_FLOATS;
+        GLfloat *b = mesh->vertices + mesh->indices[i + 1] * MESH_VERTEX_FLOATS;
+        GLfloat *c = mesh->vertices + mesh->indices[i + 2] * MESH_VERTEX_FLOATS;
+        GLfloat e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        GLfloat e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        GLfloat n[3] = {
+            e0[1] * e1[2] - e0[2] * e1[1],
+            e0[2] * e1[0] - e0[0] * e1[2],
+            e0[0] * e1[1] - e0[1] * e1[0],
+        };
+        for (int k = 0; k < 3; ++k) {
+            GLfloat *vertex = mesh->vertices +
+                              mesh->indices[i + k] * MESH_VERTEX_FLOATS;
+            vertex[3] += n[0];
+            vertex[4] += n[1];
+            vertex[5] += n[2];
+        }
+    }
+
+    for (int i = 0; i < mesh->vertex_count; ++i) {
+        GLfloat *normal = mesh->vertices + i * MESH_VERTEX_FLOATS + 3;
+        GLfloat length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                               normal[2] * normal[2]);
+        if (length > 0) {
+            normal[0] /= length;
+            normal[1] /= length;
+            normal[2] /= length;
+        }
+    }
+}
+
+// Polygons are triangulated as fans. Groups, objects and materials are
+// ignored. Returns false if the file cannot be read or has no faces.
+static bool
+load_obj_mesh(Mesh *mesh, const char *path) {
+    memset(mesh, 0, sizeof(*mesh));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Failed to open mesh %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = heap_alloc(size + 1);
+    size_t read = fread(text, 1, size, file);
+    fclose(file);
+    text[read] = 0;
+
+    ObjArray positions = {0}, texcoords = {0}, normals = {0};
+    ObjVertexTable table = {0};
+    grow_obj_vertex_table(&table);
+
+    ObjArray vertices = {0};
+    int index_capacity = 0;
+    bool has_normals = false;
+
+    const char *p = text;
+    while (*p) {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            GLfloat v[3];
+            char *end = (char *)p + 1;
+            for (int i = 0; i < 3; ++i) {
+                v[i] = strtof(end, &end);
+            }
+            push_obj_floats(&positions, v, 3);
+        } else if (p[0] == 'v' && p[1] == 't') {
+            GLfloat v[2];
+            char *end = (char *)p + 2;
+            for (int i = 0; i < 2; ++i) {
+                v[i] = strtof(end, &end);
+            }
+            push_obj_floats(&texcoords, v, 2);
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            GLfloat v[3];
+            char *end = (char *)p + 2;
+            for (int i = 0; i < 3; ++i) {
+                v[i] = strtof(end, &end);
+            }
+            push_obj_floats(&normals, v, 3);
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            int first = -1, previous = -1, corner_count = 0;
+            p++;
+
+            for (;;) {
+                while (*p == ' ' || *p == '\t') {
+                    p++;
+                }
+                if (!(*p == '-' || (*p >= '0' && *p <= '9'))) {
+                    break;
+                }
+
+                ObjCorner corner;
+                const char *start = p;
+                p = parse_obj_corner(p, &corner, positions.count / 3,
+                                     texcoords.count / 2, normals.count / 3);
+                if (p == start) {
+                    // Nothing parsed, say a lone "-": skip the token.
+                    while (*p && *p != ' ' && *p != '\t' && *p != '\r' &&
+                           *p != '\n') {
+                        p++;
+                    }
+                    continue;
+                }
+                if (corner.position < 0) {
+                    continue;
+                }
+
+                // Find or add the vertex.
+                if (mesh->vertex_count * 2 >= table.capacity) {
+                    grow_obj_vertex_table(&table);
+                }
+                uint32_t slot = hash_obj_corner(corner) & (table.capacity - 1);
+                while (table.values[slot] >= 0 &&
+                       memcmp(&table.keys[slot], &corner, sizeof(corner))) {
+                    slot = (slot + 1) & (table.capacity - 1);
+                }
+                if (table.values[slot] < 0) {
+                    GLfloat vertex[MESH_VERTEX_FLOATS] = {0};
+                    memcpy(vertex, positions.data + corner.position * 3,
+                           3 * sizeof(GLfloat));
+                    if (corner.normal >= 0) {
+                        memcpy(vertex + 3, normals.data + corner.normal * 3,
+                               3 * sizeof(GLfloat));
+                        has_normals = true;
+                    }
+                    if (corner.texcoord >= 0) {
+                        memcpy(vertex + 6,
+                               texcoords.data + corner.texcoord * 2,
+                               2 * sizeof(GLfloat));
+                    }
+                    push_obj_floats(&vertices, vertex, MESH_VERTEX_FLOATS);
+
+                    table.keys[slot] = corner;
+                    table.values[slot] = mesh->vertex_count++;
+                }
+                int index = table.values[slot];
+
+                if (corner_count >= 2) {
+                    if (mesh->index_count + 3 > index_capacity) {
+                        index_capacity = index_capacity ?
+                                         index_capacity * 2 : 3072;
+                        mesh->indices = heap_realloc(mesh->indices,
+                                                     index_capacity *
+                                                     sizeof(GLuint));
+                    }
+                    mesh->indices[mesh->index_count++] = first;
+                    mesh->indices[mesh->index_count++] = previous;
+                    mesh->indices[mesh->index_count++] = index;
+                }
+                if (corner_count == 0) {
+                    first = index;
+                }
+                previous = index;
+                corner_count++;
+            }
+        }
+
+        while (*p && *p != '\n') {
+            p++;
+        }
+        if (*p) {
+            p++;
+        }
+    }
+
+    mesh->vertices = vertices.data;
+
+    heap_free(text);
+    heap_free(positions.data);
+    heap_free(texcoords.data);
+    heap_free(normals.data);
+    heap_free(table.keys);
+    heap_free(table.values);
+
+    if (mesh->index_count == 0) {
+        printf("Mesh %s has no faces\n", path);
+        free_mesh(mesh);
+        return false;
+    }
+
+    if (!has_normals) {
+        generate_mesh_normals(mesh);
+    }
+
+    return true;
+}
+
+//
+// Optimization
+//
+
+// FIFO cache simulation, which is close to how GPUs reuse transformed
+// vertices.
+static VertexCacheStats
+compute_vertex_cache_stats(const GLuint *indices, int index_count,
+                           int vertex_count, int cache_size) {
+    VertexCacheStats result = {0};
+    if (index_count < 3 || vertex_count == 0) {
+        return result;
+    }
+
+    // Vertex -> the timestamp it entered the cache at.
+    int *entered = heap_alloc(vertex_count * sizeof(int));
+    for (int i = 0; i < vertex_count; ++i) {
+        entered[i] = -cache_size - 1;
+    }
+
+    int misses = 0;
+    for (int i = 0; i < index_count; ++i) {
+        GLuint vertex = indices[i];
+        if (misses - entered[vertex] > cache_size) {
+            entered[vertex] = misses++;
+        }
+    }
+    heap_free(entered);
+
+    result.acmr = (double)misses / (index_count / 3);
+    result.atvr = (double)misses / vertex_count;
+    return result;
+}
+
+// Scores from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+static float
+get_vertex_cache_score(int cache_position, int remaining_triangles) {
+    if (remaining_triangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // Just used by the last triangle; slightly discourage reusing it
+            // straight away so strips do not double back.
+            score = 0.75f;
+        } else {
+            float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, 1.5f);
+        }
+    }
+
+    // Favour vertices with few triangles left so they are finished off.
+    score += 2.0f * powf((float)remaining_triangles, -0.5f);
+    return score;
+}
+
+static void
+optimize_vertex_cache(GLuint *indices, int index_count, int vertex_count) {
+    int triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // Vertex -> triangles that use it, as one array with offsets.
+    int *remaining = heap_calloc(vertex_count, sizeof(int));
+    int *offsets = heap_alloc((vertex_count + 1) * sizeof(int));
+    int *adjacency = heap_alloc(triangle_count * 3 * sizeof(int));
+    for (int i = 0; i < triangle_count * 3; ++i) {
+        remaining[indices[i]]++;
+    }
+    offsets[0] = 0;
+    for (int i = 0; i < vertex_count; ++i) {
+        offsets[i + 1] = offsets[i] + remaining[i];
+        remaining[i] = 0;
+    }
+    for (int i = 0; i < triangle_count * 3; ++i) {
+        GLuint vertex = indices[i];
+        adjacency[offsets[vertex] + remaining[vertex]++] = i / 3;
+    }
+
+    int *cache_position = heap_alloc(vertex_count * sizeof(int));
+    float *vertex_score = heap_alloc(vertex_count * sizeof(float));
+    for (int i = 0; i < vertex_count; ++i) {
+        cache_position[i] = -1;
+        vertex_score[i] = get_vertex_cache_score(-1, remaining[i]);
+    }
+
+    bool *emitted = heap_calloc(triangle_count, sizeof(bool));
+    float *triangle_score = heap_alloc(triangle_count * sizeof(float));
+    for (int i = 0; i < triangle_count; ++i) {
+        triangle_score[i] = vertex_score[indices[i * 3]] +
+                            vertex_score[indices[i * 3 + 1]] +
+                            vertex_score[indices[i * 3 + 2]];
+    }
+
+    GLuint *output = heap_alloc(index_count * sizeof(GLuint));
+    int cache[VERTEX_CACHE_SIZE + 3];
+    int cache_count = 0;
+    int next_cache[VERTEX_CACHE_SIZE + 3];
+
+    int best = 0;
+    int scan = 0;
+    for (int emitted_count = 0; emitted_count < triangle_count;
+         ++emitted_count) {
+        if (best < 0) {
+            // Nothing in the cache has triangles left, so restart at the
+            // next triangle in input order. Resuming the scan where the last
+            // restart stopped keeps this linear overall.
+            while (emitted[scan]) {
+                scan++;
+            }
+            best = scan;
+        }
+
+        const GLuint *triangle = indices + best * 3;
+        memcpy(output + emitted_count * 3, triangle, 3 * sizeof(GLuint));
+        emitted[best] = true;
+
+        // Retire the triangle from its vertices.
+        for (int k = 0; k < 3; ++k) {
+            GLuint vertex = triangle[k];
+            int *list = adjacency + offsets[vertex];
+            int count = remaining[vertex];
+            for (int j = 0; j < count; ++j) {
+                if (list[j] == best) {
+                    list[j] = list[count - 1];
+                    break;
+                }
+            }
+            remaining[vertex]--;
+        }
+
+        // Move its vertices to the front of the cache (LRU).
+        int next_count = 0;
+        for (int k = 0; k < 3; ++k) {
+            next_cache[next_count++] = triangle[k];
+        }
+        for (int i = 0; i < cache_count; ++i) {
+            int vertex = cache[i];
+            if (vertex != (int)triangle[0] && vertex != (int)triangle[1] &&
+                vertex != (int)triangle[2]) {
+                next_cache[next_count++] = vertex;
+            }
+        }
+
+        // Vertices pushed past the end fall out of the cache.
+        for (int i = VERTEX_CACHE_SIZE; i < next_count; ++i) {
+            int vertex = next_cache[i];
+            cache_position[vertex] = -1;
+            vertex_score[vertex] = get_vertex_cache_score(-1,
+                                                          remaining[vertex]);
+        }
+        cache_count = next_count < VERTEX_CACHE_SIZE ? next_count :
+                                                        VERTEX_CACHE_SIZE;
+        for (int i = 0; i < cache_count; ++i) {
+            int vertex = next_cache[i];
+            cache[i] = vertex;
+            cache_position[vertex] = i;
+            vertex_score[vertex] = get_vertex_cache_score(i,
+                                                          remaining[vertex]);
+        }
+
+        // Rescore the triangles around anything that moved and pick the best
+        // one that touches the cache.
+        best = -1;
+        float best_score = -1.0f;
+        for (int i = 0; i < next_count; ++i) {
+            int vertex = next_cache[i];
+            int *list = adjacency + offsets[vertex];
+            for (int j = 0; j < remaining[vertex]; ++j) {
+                int t = list[j];
+                const GLuint *v = indices + t * 3;
+                triangle_score[t] = vertex_score[v[0]] + vertex_score[v[1]] +
+                                    vertex_score[v[2]];
+                if (i < cache_count && triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output, index_count * sizeof(GLuint));
+
+    heap_free(output);
+    heap_free(triangle_score);
+    heap_free(emitted);
+    heap_free(vertex_score);
+    heap_free(cache_position);
+    heap_free(adjacency);
+    heap_free(offsets);
+    heap_free(remaining);
+}
+
+typedef struct MeshCluster {
+    int first;
+    int count;
+    float sort_key;
+} MeshCluster;
+
+static int
+compare_mesh_clusters(const void *a, const void *b) {
+    float ka = ((const MeshCluster *)a)->sort_key;
+    float kb = ((const MeshCluster *)b)->sort_key;
+    return ka > kb ? -1 : ka < kb ? 1 : 0;
+}
+
+// Expects cache-optimized indices. Clusters break where a triangle misses on
+// all three vertices, since the cache is cold there whatever comes next.
+static void
+optimize_overdraw(GLuint *indices, int index_count, const GLfloat *vertices,
+                  int vertex_count) {
+    int triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    GLfloat mesh_center[3] = {0};
+    for (int i = 0; i < vertex_count; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            mesh_center[c] += vertices[i * MESH_VERTEX_FLOATS + c] /
+                              vertex_count;
+        }
+    }
+
+    int *entered = heap_alloc(vertex_count * sizeof(int));
+    for (int i = 0; i < vertex_count; ++i) {
+        entered[i] = -VERTEX_CACHE_SIZE - 1;
+    }
+    MeshCluster *clusters = heap_alloc(triangle_count * sizeof(MeshCluster));
+    int cluster_count = 0;
+    int misses = 0;
+    for (int t = 0; t < triangle_count; ++t) {
+        int triangle_misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            GLuint vertex = indices[t * 3 + k];
+            if (misses - entered[vertex] > VERTEX_CACHE_SIZE) {
+                entered[vertex] = misses++;
+                triangle_misses++;
+            }
+        }
+        if (t == 0 || triangle_misses == 3) {
+            clusters[cluster_count].first = t;
+            clusters[cluster_count].count = 0;
+            cluster_count++;
+        }
+        clusters[cluster_count - 1].count++;
+    }
+    heap_free(entered);
+
+    // Outward-facing clusters first: sort on how far the cluster's average
+    // normal points away from the mesh center.
+    for (int i = 0; i < cluster_count; ++i) {
+        MeshCluster *cluster = &clusters[i];
+        GLfloat center[3] = {0}, normal[3] = {0};
+        float area = 0;
+
+        for (int t = cluster->first; t < cluster->first + cluster->count;
+             ++t) {
+            const GLfloat *a = vertices + indices[t * 3] * MESH_VERTEX_FLOATS;
+            const GLfloat *b = vertices + indices[t * 3 + 1] *
+                               MESH_VERTEX_FLOATS;
+            const GLfloat *c = vertices + indices[t * 3 + 2] *
+                               MESH_VERTEX_FLOATS;
+            GLfloat e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            GLfloat e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            GLfloat n[3] = {
+                e0[1] * e1[2] - e0[2] * e1[1],
+                e0[2] * e1[0] - e0[0] * e1[2],
+                e0[0] * e1[1] - e0[1] * e1[0],
+            };
+            float weight = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                center[k] += (a[k] + b[k] + c[k]) / 3.0f * weight;
+                normal[k] += n[k];
+            }
+            area += weight;
+        }
+
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                             normal[2] * normal[2]);
+        cluster->sort_key = 0;
+        if (area > 0 && length > 0) {
+            for (int k = 0; k < 3; ++k) {
+                cluster->sort_key += (center[k] / area - mesh_center[k]) *
+                                     normal[k] / length;
+            }
+        }
+    }
+
+    qsort(clusters, cluster_count, sizeof(MeshCluster),
+          compare_mesh_clusters);
+
+    GLuint *output = heap_alloc(index_count * sizeof(GLuint));
+    int offset = 0;
+    for (int i = 0; i < cluster_count; ++i) {
+        memcpy(output + offset, indices + clusters[i].first * 3,
+               clusters[i].count * 3 * sizeof(GLuint));
+        offset += clusters[i].count * 3;
+    }
+    memcpy(indices, output, offset * sizeof(GLuint));
+
+    heap_free(output);
+    heap_free(clusters);
+}
+
+// Renumbers vertices in the order the indices first use them and drops any
+// that are never used.
+static void
+optimize_vertex_fetch(Mesh *mesh) {
+    int *remap = heap_alloc(mesh->vertex_count * sizeof(int));
+    for (int i = 0; i < mesh->vertex_count; ++i) {
+        remap[i] = -1;
+    }
+
+    GLfloat *vertices = heap_alloc(mesh->vertex_count * MESH_VERTEX_FLOATS *
+                                   sizeof(GLfloat));
+    int vertex_count = 0;
+    for (int i = 0; i < mesh->index_count; ++i) {
+        GLuint vertex = mesh->indices[i];
+        if (remap[vertex] < 0) {
+            memcpy(vertices + vertex_count * MESH_VERTEX_FLOATS,
+                   mesh->vertices + vertex * MESH_VERTEX_FLOATS,
+                   MESH_VERTEX_FLOATS * sizeof(GLfloat));
+            remap[vertex] = vertex_count++;
+        }
+        mesh->indices[i] = remap[vertex];
+    }
+
+    memcpy(mesh->vertices, vertices,
+           vertex_count * MESH_VERTEX_FLOATS * sizeof(GLfloat));
+    mesh->vertex_count = vertex_count;
+
+    heap_free(vertices);
+    heap_free(remap);
+}
+
+static void
+optimize_mesh(Mesh *mesh) {
+    optimize_vertex_cache(mesh->indices, mesh->index_count,
+                          mesh->vertex_count);
+    optimize_overdraw(mesh->indices, mesh->index_count, mesh->vertices,
+                      mesh->vertex_count);
+    optimize_vertex_fetch(mesh);
+}
+
+//
+// Cooked meshes
+//
+
+static bool
+write_cooked_mesh(const Mesh *mesh, const char *path) {
+    CookedMeshHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COOKED_MESH_MAGIC;
+    header.version = COOKED_MESH_VERSION;
+    header.vertex_count = mesh->vertex_count;
+    header.index_count = mesh->index_count;
+    header.vertex_offset = sizeof(header);
+    header.index_offset = header.vertex_offset + mesh->vertex_count *
+                          MESH_VERTEX_FLOATS * sizeof(GLfloat);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(mesh->vertices, sizeof(GLfloat),
+           mesh->vertex_count * MESH_VERTEX_FLOATS, file);
+    fwrite(mesh->indices, sizeof(GLuint), mesh->index_count, file);
+    bool result = ferror(file) == 0;
+    fclose(file);
+
+    return result;
+}
+
+static bool
+is_cooked_mesh_valid(const CookedMeshHeader *header, size_t file_size) {
+    if (file_size < sizeof(*header) ||
+        header->magic != COOKED_MESH_MAGIC ||
+        header->version != COOKED_MESH_VERSION) {
+        return false;
+    }
+
+    uint64_t vertex_end = (uint64_t)header->vertex_offset +
+                          (uint64_t)header->vertex_count *
+                          MESH_VERTEX_FLOATS * sizeof(GLfloat);
+    uint64_t index_end = (uint64_t)header->index_offset +
+                         (uint64_t)header->index_count * sizeof(GLuint);
+    return header->vertex_offset % 4 == 0 && header->index_offset % 4 == 0 &&
+           vertex_end <= file_size && index_end <= file_size;
+}
+
+// Every index must name a vertex, or the statistics and the GPU would read
+// past the vertex array.
+static bool
+are_mesh_indices_valid(const GLuint *indices, int index_count,
+                       int vertex_count) {
+    for (int i = 0; i < index_count; ++i) {
+        if (indices[i] >= (GLuint)vertex_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The mesh points into a private mapping of the file, so there is no parse
+// or copy, and the vertex pages are only read when the data is uploaded. The
+// indices are read once to check their range. The mesh can still be modified
+// in place. Returns false if the file is missing or malformed.
+static bool
+load_cooked_mesh(Mesh *mesh, const char *path) {
+    memset(mesh, 0, sizeof(*mesh));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                    0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const CookedMeshHeader *header = data;
+    if (!is_cooked_mesh_valid(header, st.st_size)) {
+        printf("Invalid cooked mesh: %s\n", path);
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    mesh->vertices = (GLfloat *)((uint8_t *)data + header->vertex_offset);
+    mesh->vertex_count = header->vertex_count;
+    mesh->indices = (GLuint *)((uint8_t *)data + header->index_offset);
+    mesh->index_count = header->index_count;
+    mesh->mapping = data;
+    mesh->mapping_size = st.st_size;
+
+    if (!are_mesh_indices_valid(mesh->indices, mesh->index_count,
+                                mesh->vertex_count)) {
+        printf("Invalid cooked mesh: %s has indices past its %d vertices\n",
+               path, mesh->vertex_count);
+        munmap(data, st.st_size);
+        memset(mesh, 0, sizeof(*mesh));
+        return false;
+    }
+
+    return true;
+}
+
+// Loads .cmesh files as cooked meshes and anything else as OBJ.
+static bool
+load_mesh(Mesh *mesh, const char *path) {
+    size_t length = strlen(path);
+    if (length > 6 && strcmp(path + length - 6, ".cmesh") == 0) {
+        return load_cooked_mesh(mesh, path);
+    }
+    return load_obj_mesh(mesh, path);
+}
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef MESH_PACKING_H
+#define MESH_PACKING_H
+
+// Packs interleaved float vertex data into compact attribute formats.
+//
+// Samples describe their vertices the way they are easiest to write (all
+// GLfloat) plus what each attribute means, and pack_mesh() picks a format per
+// attribute:
+//
+//   MESH_POSITION   GL_HALF_FLOAT x4 (w = 1)            8 bytes
+//   MESH_COLOR      GL_UNSIGNED_BYTE x4, normalized     4 bytes
+//   MESH_TEXCOORD   GL_UNSIGNED_SHORT x2, normalized    4 bytes, if every
+//                   value is in [0, 1]; GL_HALF_FLOAT otherwise
+//   MESH_GENERIC    GL_FLOAT, unchanged
+//
+// Every attribute stays 4-byte aligned. Indices become GL_UNSIGNED_SHORT
+// when the vertex count allows. Shaders are unaffected: normalized and half
+// float attributes still arrive as floats, and extra components are dropped.
+//
+// With `compact` false the input layout is kept as is, which the bandwidth
+// benchmark uses as the baseline.
+
+#include <stdint.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+
+#define MAX_MESH_ATTRIBUTES 8
+
+typedef enum MeshAttributeKind {
+    MESH_POSITION,
+    MESH_COLOR,
+    MESH_TEXCOORD,
+    MESH_GENERIC,
+} MeshAttributeKind;
+
+typedef struct MeshAttribute {
+    GLuint location;
+    int components;
+    MeshAttributeKind kind;
+} MeshAttribute;
+
+typedef struct MeshAttributeFormat {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLsizei offset;
+} MeshAttributeFormat;
+
+typedef struct PackedMesh {
+    unsigned char *vertices;
+    GLsizei vertex_size;
+    int vertex_count;
+
+    void *indices;
+    GLenum index_type;
+    GLsizei index_size;
+    int index_count;
+
+    MeshAttributeFormat formats[MAX_MESH_ATTRIBUTES];
+    int attribute_count;
+} PackedMesh;
+
+// Round to nearest even. Values too large for a half become infinity and
+// values too small flush to zero, neither of which matters for the vertex
+// data this is used for.
+static uint16_t
+float_to_half(float value) {
+    union {
+        float f;
+        uint32_t u;
+    } bits = {value};
+
+    uint32_t sign = (bits.u >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits.u >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits.u & 0x7FFFFF;
+
+    if (((bits.u >> 23) & 0xFF) == 0xFF) {
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7C00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        // Subnormal half.
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        // May carry into the exponent, which is still the right answer.
+        half++;
+    }
+    return (uint16_t)half;
+}
+
+static GLubyte
+pack_unorm8(GLfloat value) {
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (GLubyte)(value * 255.0f + 0.5f);
+}
+
+static GLushort
+pack_unorm16(GLfloat value) {
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (GLushort)(value * 65535.0f + 0.5f);
+}
+
+static bool
+is_attribute_normalized(const GLfloat *vertices, int vertex_count,
+                        int stride, int offset, int components) {
+    for (int v = 0; v < vertex_count; ++v) {
+        for (int c = 0; c < components; ++c) {
+            GLfloat value = vertices[v * stride + offset + c];
+            if (value < 0.0f || value > 1.0f) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// `vertices` is vertex_count interleaved vertices, each holding the
+// attributes in order as floats. Returns false if there are too many
+// attributes.
+static bool
+pack_mesh(PackedMesh *mesh, const GLfloat *vertices, int vertex_count,
+          const MeshAttribute *attributes, int attribute_count,
+          const GLuint *indices, int index_count, bool compact) {
+    memset(mesh, 0, sizeof(*mesh));
+
+    if (attribute_count > MAX_MESH_ATTRIBUTES) {
+        printf("Too many mesh attributes: %d (max %d)\n", attribute_count,
+               MAX_MESH_ATTRIBUTES);
+        return false;
+    }
+
+    int stride = 0;
+    for (int i = 0; i < attribute_count; ++i) {
+        stride += attributes[i].components;
+    }
+
+    // Choose formats and lay them out.
+    GLsizei offset = 0;
+    int input_offset = 0;
+    for (int i = 0; i < attribute_count; ++i) {
+        const MeshAttribute *attribute = &attributes[i];
+        MeshAttributeFormat *format = &mesh->formats[i];
+        format->location = attribute->location;
+        format->components = attribute->components;
+        format->type = GL_FLOAT;
+        format->normalized = GL_FALSE;
+
+        if (compact) {
+            switch (attribute->kind) {
+                case MESH_POSITION: {
+                    format->components = 4;
+                    format->type = GL_HALF_FLOAT;
+                } break;
+
+                case MESH_COLOR: {
+                    format->components = 4;
+                    format->type = GL_UNSIGNED_BYTE;
+                    format->normalized = GL_TRUE;
+                } break;
+
+                case MESH_TEXCOORD: {
+                    if (is_attribute_normalized(vertices, vertex_count,
+                                                stride, input_offset,
+                                                attribute->components)) {
+                        format->type = GL_UNSIGNED_SHORT;
+                        format->normalized = GL_TRUE;
+                    } else {
+                        format->type = GL_HALF_FLOAT;
+                    }
+                    // Keep 4-byte alignment.
+                    format->components = (attribute->components + 1) & ~1;
+                } break;
+
+                case MESH_GENERIC: break;
+            }
+        }
+
+        GLsizei component_size = format->type == GL_FLOAT ? 4 :
+                                 format->type == GL_UNSIGNED_BYTE ? 1 : 2;
+        format->offset = offset;
+        offset += format->components * component_size;
+        input_offset += attribute->components;
+    }
+    mesh->vertex_size = offset;
+    mesh->vertex_count = vertex_count;
+    mesh->attribute_count = attribute_count;
+
+    // Convert.
+    mesh->vertices = heap_calloc(vertex_count, mesh->vertex_size);
+    for (int v = 0; v < vertex_count; ++v) {
+        const GLfloat *in = vertices + v * stride;
+        unsigned char *out = mesh->vertices + v * mesh->vertex_size;
+
+        for (int i = 0; i < attribute_count; ++i) {
+            MeshAttributeFormat *format = &mesh->formats[i];
+            int count = attributes[i].components;
+            unsigned char *dest = out + format->offset;
+
+            for (int c = 0; c < format->components; ++c) {
+                // Padding components: 1 for w and alpha, 0 otherwise.
+                GLfloat value = c < count ? in[c] :
+                                c == 3 ? 1.0f : 0.0f;
+
+                switch (format->type) {
+                    case GL_HALF_FLOAT: {
+                        ((uint16_t *)dest)[c] = float_to_half(value);
+                    } break;
+
+                    case GL_UNSIGNED_BYTE: {
+                        dest[c] = pack_unorm8(value);
+                    } break;
+
+                    case GL_UNSIGNED_SHORT: {
+                        ((GLushort *)dest)[c] = pack_unorm16(value);
+                    } break;
+
+                    default: {
+                        ((GLfloat *)dest)[c] = value;
+                    } break;
+                }
+            }
+            in += count;
+        }
+    }
+
+    mesh->index_count = index_count;
+    if (compact && vertex_count <= 65536) {
+        GLushort *short_indices = heap_alloc(index_count * sizeof(GLushort));
+        for (int i = 0; i < index_count; ++i) {
+            short_indices[i] = (GLushort)indices[i];
+        }
+        mesh->indices = short_indices;
+        mesh->index_type = GL_UNSIGNED_SHORT;
+        mesh->index_size = sizeof(GLushort);
+    } else {
+        mesh->indices = heap_alloc(index_count * sizeof(GLuint));
+        memcpy(mesh->indices, indices, index_count * sizeof(GLuint));
+        mesh->index_type = GL_UNSIGNED_INT;
+        mesh->index_size = sizeof(GLuint);
+    }
+
+    return true;
+}
+
+// Creates the VAO, VBO and EBO and points the attributes at the packed data.
+// Leaves the VAO bound.
+static void
+upload_packed_mesh(PackedMesh *mesh, GLuint *vao, GLuint *vbo, GLuint *ebo) {
+    glGenVertexArrays(1, vao);
+    bind_vertex_array(*vao);
+
+    glGenBuffers(1, vbo);
+    bind_buffer(GL_ARRAY_BUFFER, *vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 (GLsizeiptr)mesh->vertex_count * mesh->vertex_size,
+                 mesh->vertices, GL_STATIC_DRAW);
+
+    glGenBuffers(1, ebo);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, *ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 (GLsizeiptr)mesh->index_count * mesh->index_size,
+                 mesh->indices, GL_STATIC_DRAW);
+
+    for (int i = 0; i < mesh->attribute_count; ++i) {
+        MeshAttributeFormat *format = &mesh->formats[i];
+        glVertexAttribPointer(format->location, format->components,
+                              format->type, format->normalized,
+                              mesh->vertex_size,
+                              (GLvoid *)(intptr_t)format->offset);
+        glEnableVertexAttribArray(format->location);
+    }
+}
+
+static void
+free_packed_mesh(PackedMesh *mesh) {
+    heap_free(mesh->vertices);
+    heap_free(mesh->indices);
+    mesh->vertices = 0;
+    mesh->indices = 0;
+}
+
+#endif
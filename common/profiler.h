@@ -0,0 +1,262 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// CPU and GPU zone profiler that writes Chrome trace-event JSON (open it in
+// chrome://tracing or https://ui.perfetto.dev).
+//
+//   begin_zone(&PROFILER, "draw");
+//   glDrawElements(...);
+//   end_zone(&PROFILER);
+//
+// Zones nest, and names must outlive the frame (string literals). Each one
+// records two performance counter reads on the CPU and two GL_TIMESTAMP
+// queries on the GPU; nothing is formatted or read back on the hot path.
+// Queries come from a pool per frame, PROFILER_FRAMES deep, and
+// update_profiler() only reads back the frame that was recorded that many
+// frames ago, so the results are normally ready and reading them does not
+// stall. CPU zones go to thread 1 of the trace and GPU zones to thread 2,
+// with GPU timestamps shifted onto the CPU clock once at startup.
+//
+// A profiler initialized without a trace path is disabled and every call is a
+// single branch. Only the GL context matters, so it works the same in
+// --headless runs.
+
+#define PROFILER_FRAMES 3
+#define MAX_PROFILER_ZONES 64
+#define MAX_PROFILER_DEPTH 16
+
+typedef struct ProfilerZone {
+    const char *name;
+    Uint64 cpu_begin;
+    Uint64 cpu_end;
+} ProfilerZone;
+
+typedef struct ProfilerFrame {
+    ProfilerZone zones[MAX_PROFILER_ZONES];
+    // Begin and end timestamp per zone.
+    GLuint queries[MAX_PROFILER_ZONES * 2];
+    int zone_count;
+} ProfilerFrame;
+
+typedef struct Profiler {
+    FILE *trace;
+    bool first_event;
+
+    ProfilerFrame frames[PROFILER_FRAMES];
+    int frame;
+
+    int stack[MAX_PROFILER_DEPTH];
+    int depth;
+
+    Uint64 cpu_base;
+    GLint64 gpu_base;
+    double ticks_per_us;
+
+    int dropped_zones;
+    int stalls;
+    double zone_overhead_us;
+} Profiler;
+
+// Returns the value of --trace, or 0.
+static const char *
+parse_trace_path(int argc, char **argv) {
+    const char *result = 0;
+
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            result = argv[i + 1];
+        }
+    }
+
+    return result;
+}
+
+// Call with a current GL context. A null path leaves the profiler disabled.
+static bool
+init_profiler(Profiler *profiler, const char *trace_path) {
+    memset(profiler, 0, sizeof(*profiler));
+
+    if (!trace_path) {
+        return true;
+    }
+
+    profiler->trace = fopen(trace_path, "w");
+    if (!profiler->trace) {
+        printf("Failed to open trace %s\n", trace_path);
+        return false;
+    }
+    fprintf(profiler->trace, "[\n");
+    profiler->first_event = true;
+
+    for (int i = 0; i < PROFILER_FRAMES; ++i) {
+        glGenQueries(MAX_PROFILER_ZONES * 2, profiler->frames[i].queries);
+    }
+
+    profiler->ticks_per_us = SDL_GetPerformanceFrequency() / 1.0e6;
+    glGetInteger64v(GL_TIMESTAMP, &profiler->gpu_base);
+    profiler->cpu_base = SDL_GetPerformanceCounter();
+
+    return true;
+}
+
+static void
+begin_zone(Profiler *profiler, const char *name) {
+    if (!profiler->trace) {
+        return;
+    }
+
+    ProfilerFrame *frame = &profiler->frames[profiler->frame %
+                                             PROFILER_FRAMES];
+    if (frame->zone_count == MAX_PROFILER_ZONES ||
+        profiler->depth == MAX_PROFILER_DEPTH) {
+        // Still push so the matching end_zone() stays balanced.
+        if (profiler->depth < MAX_PROFILER_DEPTH) {
+            profiler->stack[profiler->depth] = -1;
+        }
+        profiler->depth++;
+        profiler->dropped_zones++;
+        return;
+    }
+
+    int index = frame->zone_count++;
+    ProfilerZone *zone = &frame->zones[index];
+    zone->name = name;
+    profiler->stack[profiler->depth++] = index;
+
+    glQueryCounter(frame->queries[index * 2], GL_TIMESTAMP);
+    zone->cpu_begin = SDL_GetPerformanceCounter();
+}
+
+static void
+end_zone(Profiler *profiler) {
+    if (!profiler->trace || profiler->depth == 0) {
+        return;
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    int depth = --profiler->depth;
+    int index = depth < MAX_PROFILER_DEPTH ? profiler->stack[depth] : -1;
+    if (index < 0) {
+        return;
+    }
+
+    ProfilerFrame *frame = &profiler->frames[profiler->frame %
+                                             PROFILER_FRAMES];
+    frame->zones[index].cpu_end = now;
+    glQueryCounter(frame->queries[index * 2 + 1], GL_TIMESTAMP);
+}
+
+static void
+write_trace_event(Profiler *profiler, const char *name, int tid,
+                  double begin_us, double duration_us) {
+    fprintf(profiler->trace,
+            "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f}",
+            profiler->first_event ? "" : ",\n", name, tid, begin_us,
+            duration_us);
+    profiler->first_event = false;
+}
+
+static void
+flush_profiler_frame(Profiler *profiler, ProfilerFrame *frame) {
+    if (frame->zone_count == 0) {
+        return;
+    }
+
+    GLint available = GL_TRUE;
+    GLuint last = frame->queries[frame->zone_count * 2 - 1];
+    glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        profiler->stalls++;
+    }
+
+    for (int i = 0; i < frame->zone_count; ++i) {
+        ProfilerZone *zone = &frame->zones[i];
+
+        double cpu_begin = (Sint64)(zone->cpu_begin - profiler->cpu_base) /
+                           profiler->ticks_per_us;
+        double cpu_end = (Sint64)(zone->cpu_end - profiler->cpu_base) /
+                         profiler->ticks_per_us;
+        write_trace_event(profiler, zone->name, 1, cpu_begin,
+                          cpu_end - cpu_begin);
+
+        GLuint64 gpu_begin, gpu_end;
+        glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT,
+                              &gpu_begin);
+        glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT,
+                              &gpu_end);
+        write_trace_event(profiler, zone->name, 2,
+                          (GLint64)(gpu_begin - profiler->gpu_base) / 1.0e3,
+                          (GLint64)(gpu_end - gpu_begin) / 1.0e3);
+    }
+
+    frame->zone_count = 0;
+}
+
+// Call once per frame, before the first zone. Writes out the oldest recorded
+// frame and reuses its queries for the new one.
+static void
+update_profiler(Profiler *profiler) {
+    if (!profiler->trace) {
+        return;
+    }
+
+    profiler->frame++;
+    profiler->depth = 0;
+    flush_profiler_frame(profiler,
+                         &profiler->frames[profiler->frame % PROFILER_FRAMES]);
+}
+
+// Average cost of an empty zone in microseconds, GPU query included.
+static double
+measure_profiler_overhead(Profiler *profiler) {
+    if (!profiler->trace) {
+        return 0;
+    }
+
+    ProfilerFrame *frame = &profiler->frames[profiler->frame %
+                                             PROFILER_FRAMES];
+    int saved_count = frame->zone_count;
+    int count = MAX_PROFILER_ZONES - saved_count;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++i) {
+        begin_zone(profiler, "overhead");
+        end_zone(profiler);
+    }
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+    frame->zone_count = saved_count;
+
+    return count > 0 ? elapsed / profiler->ticks_per_us / count : 0;
+}
+
+// Call before the GL context goes away. Blocks on outstanding queries.
+static void
+close_profiler(Profiler *profiler) {
+    if (!profiler->trace) {
+        return;
+    }
+
+    profiler->zone_overhead_us = measure_profiler_overhead(profiler);
+
+    for (int i = 1; i <= PROFILER_FRAMES; ++i) {
+        flush_profiler_frame(profiler,
+                             &profiler->frames[(profiler->frame + i) %
+                                               PROFILER_FRAMES]);
+    }
+    fprintf(profiler->trace, "\n]\n");
+    fclose(profiler->trace);
+    profiler->trace = 0;
+
+    for (int i = 0; i < PROFILER_FRAMES; ++i) {
+        glDeleteQueries(MAX_PROFILER_ZONES * 2, profiler->frames[i].queries);
+    }
+
+    fprintf(stderr, "Profiler: %.3f us per zone, %d zones dropped, "
+            "%d readback stalls\n", profiler->zone_overhead_us,
+            profiler->dropped_zones, profiler->stalls);
+}
+
+#endif
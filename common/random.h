@@ -0,0 +1,18 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// A small LCG for benchmark fixtures. Every program starts from the same
+// seed, so runs are comparable between commits and between machines.
+
+#include <stdint.h>
+
+static uint32_t RANDOM_STATE = 0x12345678;
+
+// Uniform in [0, 1).
+static float
+random_float(void) {
+    RANDOM_STATE = RANDOM_STATE * 1664525 + 1013904223;
+    return (RANDOM_STATE >> 8) / 16777216.0f;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef RENDER_COMMANDS_H
+#define RENDER_COMMANDS_H
+
+// Draw packets recorded on any thread and replayed on the GL thread.
+//
+//   begin_render_queue(&queue);
+//   run_parallel_for(&jobs, object_count, 256, record_objects, &scene);
+//       // in the job: record_draw(&queue.buffers[thread], &packet);
+//   merge_render_queue(&queue);
+//   submit_render_queue(&queue);
+//
+// A DrawPacket is everything one glDrawElements needs, plus a 64-bit sort
+// key from make_draw_key(). Each job thread appends to its own
+// CommandBuffer, a growable array that keeps its memory from frame to frame,
+// so recording takes no locks and, once warm, allocates nothing.
+// merge_render_queue() gathers every thread's packets and radix sorts them by
+// key, which groups draws by program, then vertex array, then texture, then
+// depth. submit_render_queue() replays them in that order through the
+// gl_state.h wrappers, so sorting turns into elided binds.
+//
+// Nothing in a packet refers to GL state that is only valid on the GL thread,
+// only to object names, so recording never calls GL.
+
+#include <stdint.h>
+
+#include "common/gl_state.h"
+#include "common/job_system.h"
+#include "common/memory.h"
+
+// Indices into DrawPacket.uniforms[] of the per-draw vec4 uniforms.
+#define DRAW_PACKET_TRANSFORM 0
+#define DRAW_PACKET_COLOR 1
+
+typedef struct DrawPacket {
+    uint64_t key;
+    GLuint program;
+    GLuint vertex_array;
+    GLuint texture;
+    GLsizei index_count;
+    // Locations of the transform and color uniforms in `program`.
+    const GLint *uniforms;
+    GLfloat transform[4];
+    GLfloat color[4];
+} DrawPacket;
+
+typedef struct CommandBuffer {
+    DrawPacket *packets;
+    int count;
+    int capacity;
+} CommandBuffer;
+
+typedef struct DrawSortEntry {
+    uint64_t key;
+    uint32_t index;
+} DrawSortEntry;
+
+typedef struct RenderQueue {
+    CommandBuffer buffers[MAX_JOB_THREADS];
+
+    // Merged and sorted by merge_render_queue().
+    DrawPacket *packets;
+    DrawSortEntry *order;
+    DrawSortEntry *scratch;
+    int count;
+    int capacity;
+} RenderQueue;
+
+// `program`, `vertex_array` and `texture` are small indices chosen by the
+// caller (not GL names) in the order their changes should be minimized.
+// Depth is in [0, 1] and sorts front to back.
+static uint64_t
+make_draw_key(unsigned program, unsigned vertex_array, unsigned texture,
+              float depth) {
+    depth = depth < 0.0f ? 0.0f : depth > 1.0f ? 1.0f : depth;
+    uint64_t quantized = (uint64_t)(depth * 0xFFFFFF);
+
+    return ((uint64_t)(program & 0xFF) << 56) |
+           ((uint64_t)(vertex_array & 0xFFF) << 44) |
+           ((uint64_t)(texture & 0xFFFFF) << 24) |
+           quantized;
+}
+
+static void
+record_draw(CommandBuffer *buffer, const DrawPacket *packet) {
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 1024;
+        buffer->packets = heap_realloc(buffer->packets,
+                                       buffer->capacity * sizeof(DrawPacket));
+    }
+    buffer->packets[buffer->count++] = *packet;
+}
+
+static void
+begin_render_queue(RenderQueue *queue) {
+    for (int i = 0; i < MAX_JOB_THREADS; ++i) {
+        queue->buffers[i].count = 0;
+    }
+    queue->count = 0;
+}
+
+// LSD radix sort, 8 bits at a time. Passes where every key has the same
+// digit are skipped, which is most of them when only a few bits vary.
+static void
+sort_draw_entries(DrawSortEntry *entries, DrawSortEntry *scratch,
+                  int count) {
+    DrawSortEntry *from = entries;
+    DrawSortEntry *to = scratch;
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        int histogram[256] = {0};
+        for (int i = 0; i < count; ++i) {
+            histogram[(from[i].key >> shift) & 0xFF]++;
+        }
+        if (histogram[(from[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int i = 0; i < 256; ++i) {
+            int n = histogram[i];
+            histogram[i] = offset;
+            offset += n;
+        }
+        for (int i = 0; i < count; ++i) {
+            to[histogram[(from[i].key >> shift) & 0xFF]++] = from[i];
+        }
+
+        DrawSortEntry *swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != entries) {
+        memcpy(entries, from, count * sizeof(DrawSortEntry));
+    }
+}
+
+// Call on the GL thread once every job has finished recording.
+static void
+merge_render_queue(RenderQueue *queue) {
+    int total = 0;
+    for (int i = 0; i < MAX_JOB_THREADS; ++i) {
+        total += queue->buffers[i].count;
+    }
+
+    if (total > queue->capacity) {
+        queue->capacity = total;
+        queue->packets = heap_realloc(queue->packets,
+                                      total * sizeof(DrawPacket));
+        queue->order = heap_realloc(queue->order,
+                                    total * sizeof(DrawSortEntry));
+        queue->scratch = heap_realloc(queue->scratch,
+                                      total * sizeof(DrawSortEntry));
+    }
+
+    queue->count = 0;
+    for (int i = 0; i < MAX_JOB_THREADS; ++i) {
+        CommandBuffer *buffer = &queue->buffers[i];
+        if (buffer->count > 0) {
+            memcpy(queue->packets + queue->count, buffer->packets,
+                   buffer->count * sizeof(DrawPacket));
+            queue->count += buffer->count;
+        }
+    }
+
+    for (int i = 0; i < queue->count; ++i) {
+        queue->order[i].key = queue->packets[i].key;
+        queue->order[i].index = i;
+    }
+    if (queue->count > 0) {
+        sort_draw_entries(queue->order, queue->scratch, queue->count);
+    }
+}
+
+static void
+submit_render_queue(RenderQueue *queue) {
+    for (int i = 0; i < queue->count; ++i) {
+        DrawPacket *packet = &queue->packets[queue->order[i].index];
+
+        use_program(packet->program);
+        bind_vertex_array(packet->vertex_array);
+        active_texture(GL_TEXTURE0);
+        bind_texture(GL_TEXTURE_2D, packet->texture);
+
+        glUniform4fv(packet->uniforms[DRAW_PACKET_TRANSFORM], 1,
+                     packet->transform);
+        glUniform4fv(packet->uniforms[DRAW_PACKET_COLOR], 1, packet->color);
+        glDrawElements(GL_TRIANGLES, packet->index_count, GL_UNSIGNED_SHORT,
+                       0);
+    }
+}
+
+#endif
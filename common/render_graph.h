@@ -0,0 +1,814 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+// A frame described as passes over named resources.
+//
+// Every frame the sample declares its resources and passes, then runs them:
+//
+//   begin_render_graph(&graph, width, height);
+//   int backbuffer = import_render_target(&graph, "backbuffer", fbo);
+//   int scene = create_render_texture(&graph, "scene", w, h, GL_RGBA16F);
+//   int pass = add_render_pass(&graph, "scene", draw_scene, 0);
+//   write_render_resource(&graph, pass, scene);
+//   ...
+//   execute_render_graph(&graph);
+//
+// execute_render_graph() first compiles the frame:
+//
+//   Culling   walking the passes backwards from the imported targets, a pass
+//             runs only if something that runs later (or the imported target
+//             itself) reads what it writes. The rest are skipped.
+//   Lifetime  each transient texture lives from the first to the last pass
+//             that runs and uses it.
+//   Aliasing  transient textures are backed by a pool of GL textures kept
+//             across frames. A texture whose lifetime has ended is handed to
+//             the next resource of the same size and format, so resources
+//             that are never alive at the same time share memory.
+//   FBOs      each pass gets a framebuffer with its writes attached, cached
+//             by attachments so steady-state frames create none.
+//
+// then binds each pass's framebuffer, clears it if asked, and calls its
+// function, which reads its inputs with get_render_texture(). A pass writing
+// an imported target writes only that target.
+//
+// Every pass that runs is bracketed by GL_TIMESTAMP queries, read back
+// RENDER_GRAPH_FRAMES frames later like the profiler's, so timing never
+// stalls and can nest inside run_headless()'s GL_TIME_ELAPSED query.
+// print_render_graph_report() appends the average GPU time per pass and the
+// transient memory with and without aliasing.
+
+#include <stddef.h>
+#include <string.h>
+
+#include "common/gl_state.h"
+
+#define MAX_RENDER_PASSES 32
+#define MAX_RENDER_RESOURCES 32
+#define MAX_RENDER_PASS_READS 8
+#define MAX_RENDER_PASS_WRITES 4
+#define MAX_RENDER_TEXTURES 32
+#define MAX_RENDER_FRAMEBUFFERS 32
+#define RENDER_GRAPH_FRAMES 3
+
+struct RenderGraph;
+
+typedef void (*RenderPassFunction)(struct RenderGraph *graph, void *data);
+
+typedef struct RenderResource {
+    const char *name;
+    int width;
+    int height;
+    GLenum format;
+
+    // Imported resources are framebuffers owned elsewhere, such as the
+    // default one.
+    bool imported;
+    GLuint fbo;
+
+    // Set by the compile: the passes that run and use the resource, and the
+    // pooled texture backing it.
+    bool needed;
+    int first_use;
+    int last_use;
+    int texture;
+} RenderResource;
+
+typedef struct RenderPass {
+    const char *name;
+    RenderPassFunction execute;
+    void *data;
+
+    int reads[MAX_RENDER_PASS_READS];
+    int read_count;
+    int writes[MAX_RENDER_PASS_WRITES];
+    int write_count;
+
+    bool clear;
+    GLfloat clear_color[4];
+
+    bool culled;
+    GLuint fbo;
+    int width;
+    int height;
+} RenderPass;
+
+typedef struct RenderTexture {
+    GLuint id;
+    int width;
+    int height;
+    GLenum format;
+    size_t bytes;
+
+    // Index of the last pass this frame that uses the texture, or -1 while
+    // it is free.
+    int busy_until;
+    bool used;
+    int unused_frames;
+} RenderTexture;
+
+typedef struct RenderFramebuffer {
+    GLuint id;
+    GLuint attachments[MAX_RENDER_PASS_WRITES];
+    int attachment_count;
+} RenderFramebuffer;
+
+typedef struct RenderGraphFrame {
+    const char *pass_names[MAX_RENDER_PASSES];
+    // Begin and end timestamp per pass that ran.
+    GLuint queries[MAX_RENDER_PASSES * 2];
+    int pass_count;
+} RenderGraphFrame;
+
+// Accumulated per pass name over every frame executed.
+typedef struct RenderPassStats {
+    const char *name;
+    int frames_run;
+    int frames_culled;
+    int gpu_samples;
+    double gpu_ms_total;
+} RenderPassStats;
+
+typedef struct RenderGraphStats {
+    // From the last frame.
+    int passes;
+    int passes_culled;
+    int transient_resources;
+    size_t transient_bytes;
+    size_t unaliased_bytes;
+
+    // Since init_render_graph().
+    int textures_created;
+    int framebuffers_created;
+} RenderGraphStats;
+
+typedef struct RenderGraph {
+    int width;
+    int height;
+    // Off to give every transient resource its own texture, as a baseline.
+    bool aliasing;
+
+    RenderResource resources[MAX_RENDER_RESOURCES];
+    int resource_count;
+    RenderPass passes[MAX_RENDER_PASSES];
+    int pass_count;
+
+    RenderTexture textures[MAX_RENDER_TEXTURES];
+    int texture_count;
+    RenderFramebuffer framebuffers[MAX_RENDER_FRAMEBUFFERS];
+    int framebuffer_count;
+
+    RenderGraphFrame frames[RENDER_GRAPH_FRAMES];
+    int frame;
+
+    RenderPassStats pass_stats[MAX_RENDER_PASSES];
+    int pass_stats_count;
+    RenderGraphStats stats;
+} RenderGraph;
+
+static void
+init_render_graph(RenderGraph *graph) {
+    memset(graph, 0, sizeof(*graph));
+    graph->aliasing = true;
+    for (int i = 0; i < RENDER_GRAPH_FRAMES; ++i) {
+        glGenQueries(MAX_RENDER_PASSES * 2, graph->frames[i].queries);
+    }
+}
+
+static bool
+is_depth_format(GLenum format) {
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 ||
+           format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 ||
+           format == GL_DEPTH32F_STENCIL8;
+}
+
+static GLenum
+get_render_attachment(GLenum format, int color_index) {
+    if (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8) {
+        return GL_DEPTH_STENCIL_ATTACHMENT;
+    }
+    if (is_depth_format(format)) {
+        return GL_DEPTH_ATTACHMENT;
+    }
+    return GL_COLOR_ATTACHMENT0 + color_index;
+}
+
+// The pixel format and type glTexImage2D() wants with `format`, and its size
+// in bytes per pixel. Returns false for formats the graph does not know.
+static bool
+get_render_texture_format(GLenum format, GLenum *pixel_format, GLenum *type,
+                          int *bytes_per_pixel) {
+    switch (format) {
+        case GL_R8: {
+            *pixel_format = GL_RED;
+            *type = GL_UNSIGNED_BYTE;
+            *bytes_per_pixel = 1;
+        } break;
+
+        case GL_RGBA8: {
+            *pixel_format = GL_RGBA;
+            *type = GL_UNSIGNED_BYTE;
+            *bytes_per_pixel = 4;
+        } break;
+
+        case GL_R11F_G11F_B10F: {
+            *pixel_format = GL_RGB;
+            *type = GL_FLOAT;
+            *bytes_per_pixel = 4;
+        } break;
+
+        case GL_RGBA16F: {
+            *pixel_format = GL_RGBA;
+            *type = GL_HALF_FLOAT;
+            *bytes_per_pixel = 8;
+        } break;
+
+        case GL_RGBA32F: {
+            *pixel_format = GL_RGBA;
+            *type = GL_FLOAT;
+            *bytes_per_pixel = 16;
+        } break;
+
+        case GL_DEPTH_COMPONENT24: {
+            *pixel_format = GL_DEPTH_COMPONENT;
+            *type = GL_UNSIGNED_INT;
+            *bytes_per_pixel = 4;
+        } break;
+
+        case GL_DEPTH_COMPONENT32F: {
+            *pixel_format = GL_DEPTH_COMPONENT;
+            *type = GL_FLOAT;
+            *bytes_per_pixel = 4;
+        } break;
+
+        case GL_DEPTH24_STENCIL8: {
+            *pixel_format = GL_DEPTH_STENCIL;
+            *type = GL_UNSIGNED_INT_24_8;
+            *bytes_per_pixel = 4;
+        } break;
+
+        default: {
+            return false;
+        } break;
+    }
+    return true;
+}
+
+// Starts declaring a frame rendered at width x height.
+static void
+begin_render_graph(RenderGraph *graph, int width, int height) {
+    graph->width = width;
+    graph->height = height;
+    graph->resource_count = 0;
+    graph->pass_count = 0;
+}
+
+static int
+add_render_resource(RenderGraph *graph, const char *name) {
+    if (graph->resource_count == MAX_RENDER_RESOURCES) {
+        printf("Too many render resources (max %d)\n", MAX_RENDER_RESOURCES);
+        return -1;
+    }
+
+    int result = graph->resource_count++;
+    RenderResource *resource = &graph->resources[result];
+    memset(resource, 0, sizeof(*resource));
+    resource->name = name;
+    resource->texture = -1;
+    return result;
+}
+
+// A framebuffer owned outside the graph, 0 for the default one. Passes that
+// write it always run.
+static int
+import_render_target(RenderGraph *graph, const char *name, GLuint fbo) {
+    int result = add_render_resource(graph, name);
+    if (result >= 0) {
+        RenderResource *resource = &graph->resources[result];
+        resource->imported = true;
+        resource->fbo = fbo;
+        resource->width = graph->width;
+        resource->height = graph->height;
+    }
+    return result;
+}
+
+// A texture that only lives during this frame. A size of 0 means the
+// graph's.
+static int
+create_render_texture(RenderGraph *graph, const char *name, int width,
+                      int height, GLenum format) {
+    int result = add_render_resource(graph, name);
+    if (result >= 0) {
+        RenderResource *resource = &graph->resources[result];
+        resource->width = width > 0 ? width : graph->width;
+        resource->height = height > 0 ? height : graph->height;
+        resource->format = format;
+    }
+    return result;
+}
+
+// Passes run in the order they are added.
+static int
+add_render_pass(RenderGraph *graph, const char *name,
+                RenderPassFunction execute, void *data) {
+    if (graph->pass_count == MAX_RENDER_PASSES) {
+        printf("Too many render passes (max %d)\n", MAX_RENDER_PASSES);
+        return -1;
+    }
+
+    int result = graph->pass_count++;
+    RenderPass *pass = &graph->passes[result];
+    memset(pass, 0, sizeof(*pass));
+    pass->name = name;
+    pass->execute = execute;
+    pass->data = data;
+    return result;
+}
+
+static void
+read_render_resource(RenderGraph *graph, int pass, int resource) {
+    if (pass < 0 || resource < 0) {
+        return;
+    }
+
+    RenderPass *p = &graph->passes[pass];
+    if (p->read_count == MAX_RENDER_PASS_READS) {
+        printf("Too many reads in pass %s (max %d)\n", p->name,
+               MAX_RENDER_PASS_READS);
+        return;
+    }
+    p->reads[p->read_count++] = resource;
+}
+
+// Colour writes become attachments 0, 1, ... in the order they are added.
+static void
+write_render_resource(RenderGraph *graph, int pass, int resource) {
+    if (pass < 0 || resource < 0) {
+        return;
+    }
+
+    RenderPass *p = &graph->passes[pass];
+    if (p->write_count == MAX_RENDER_PASS_WRITES) {
+        printf("Too many writes in pass %s (max %d)\n", p->name,
+               MAX_RENDER_PASS_WRITES);
+        return;
+    }
+    p->writes[p->write_count++] = resource;
+}
+
+// Clears everything the pass writes before it runs.
+static void
+clear_render_pass(RenderGraph *graph, int pass, GLfloat r, GLfloat g,
+                  GLfloat b, GLfloat a) {
+    if (pass < 0) {
+        return;
+    }
+
+    RenderPass *p = &graph->passes[pass];
+    p->clear = true;
+    p->clear_color[0] = r;
+    p->clear_color[1] = g;
+    p->clear_color[2] = b;
+    p->clear_color[3] = a;
+}
+
+// The GL texture behind a transient resource. Only valid while the graph
+// executes.
+static GLuint
+get_render_texture(RenderGraph *graph, int resource) {
+    if (resource < 0 || graph->resources[resource].texture < 0) {
+        return 0;
+    }
+    return graph->textures[graph->resources[resource].texture].id;
+}
+
+static void
+cull_render_passes(RenderGraph *graph) {
+    for (int i = 0; i < graph->resource_count; ++i) {
+        RenderResource *resource = &graph->resources[i];
+        resource->needed = resource->imported;
+    }
+
+    for (int i = graph->pass_count - 1; i >= 0; --i) {
+        RenderPass *pass = &graph->passes[i];
+
+        pass->culled = true;
+        for (int w = 0; w < pass->write_count; ++w) {
+            if (graph->resources[pass->writes[w]].needed) {
+                pass->culled = false;
+            }
+        }
+
+        if (!pass->culled) {
+            for (int r = 0; r < pass->read_count; ++r) {
+                graph->resources[pass->reads[r]].needed = true;
+            }
+        }
+    }
+}
+
+static void
+use_render_resource(RenderGraph *graph, int resource, int pass) {
+    RenderResource *r = &graph->resources[resource];
+    if (r->first_use < 0) {
+        r->first_use = pass;
+    }
+    r->last_use = pass;
+}
+
+static void
+compute_render_lifetimes(RenderGraph *graph) {
+    for (int i = 0; i < graph->resource_count; ++i) {
+        graph->resources[i].first_use = -1;
+        graph->resources[i].last_use = -1;
+    }
+
+    for (int i = 0; i < graph->pass_count; ++i) {
+        RenderPass *pass = &graph->passes[i];
+        if (pass->culled) {
+            continue;
+        }
+        for (int r = 0; r < pass->read_count; ++r) {
+            use_render_resource(graph, pass->reads[r], i);
+        }
+        for (int w = 0; w < pass->write_count; ++w) {
+            use_render_resource(graph, pass->writes[w], i);
+        }
+    }
+}
+
+static void
+delete_render_texture(RenderGraph *graph, int index) {
+    GLuint id = graph->textures[index].id;
+
+    // Framebuffers with the texture attached go with it.
+    for (int i = 0; i < graph->framebuffer_count; ) {
+        RenderFramebuffer *framebuffer = &graph->framebuffers[i];
+        bool attached = false;
+        for (int a = 0; a < framebuffer->attachment_count; ++a) {
+            attached = attached || framebuffer->attachments[a] == id;
+        }
+        if (attached) {
+            glDeleteFramebuffers(1, &framebuffer->id);
+            *framebuffer = graph->framebuffers[--graph->framebuffer_count];
+        } else {
+            ++i;
+        }
+    }
+
+    delete_textures(1, &id);
+    graph->textures[index] = graph->textures[--graph->texture_count];
+}
+
+static int
+create_pooled_render_texture(RenderGraph *graph, RenderResource *resource) {
+    GLenum pixel_format, type;
+    int bytes_per_pixel;
+    if (!get_render_texture_format(resource->format, &pixel_format, &type,
+                                   &bytes_per_pixel)) {
+        printf("Unsupported render texture format 0x%x for %s\n",
+               resource->format, resource->name);
+        return -1;
+    }
+    if (graph->texture_count == MAX_RENDER_TEXTURES) {
+        printf("Too many render textures (max %d)\n", MAX_RENDER_TEXTURES);
+        return -1;
+    }
+
+    int result = graph->texture_count++;
+    RenderTexture *texture = &graph->textures[result];
+    memset(texture, 0, sizeof(*texture));
+    texture->width = resource->width;
+    texture->height = resource->height;
+    texture->format = resource->format;
+    texture->bytes = (size_t)resource->width * resource->height *
+                     bytes_per_pixel;
+    texture->busy_until = -1;
+
+    glGenTextures(1, &texture->id);
+    bind_texture(GL_TEXTURE_2D, texture->id);
+    glTexImage2D(GL_TEXTURE_2D, 0, resource->format, resource->width,
+                 resource->height, 0, pixel_format, type, 0);
+    GLint filter = is_depth_format(resource->format) ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    graph->stats.textures_created++;
+
+    return result;
+}
+
+// Picks a pooled texture free from pass `pass` on, or makes one.
+static int
+acquire_render_texture(RenderGraph *graph, RenderResource *resource,
+                       int pass) {
+    for (int i = 0; i < graph->texture_count; ++i) {
+        RenderTexture *texture = &graph->textures[i];
+        bool available = graph->aliasing ? texture->busy_until < pass :
+                                           !texture->used;
+        if (available && texture->width == resource->width &&
+            texture->height == resource->height &&
+            texture->format == resource->format) {
+            return i;
+        }
+    }
+    return create_pooled_render_texture(graph, resource);
+}
+
+static void
+allocate_render_textures(RenderGraph *graph) {
+    for (int i = 0; i < graph->texture_count; ++i) {
+        graph->textures[i].busy_until = -1;
+        graph->textures[i].used = false;
+    }
+
+    graph->stats.transient_resources = 0;
+    graph->stats.transient_bytes = 0;
+    graph->stats.unaliased_bytes = 0;
+
+    for (int i = 0; i < graph->pass_count; ++i) {
+        for (int r = 0; r < graph->resource_count; ++r) {
+            RenderResource *resource = &graph->resources[r];
+            if (resource->imported || resource->first_use != i) {
+                continue;
+            }
+
+            int index = acquire_render_texture(graph, resource, i);
+            if (index < 0) {
+                continue;
+            }
+
+            RenderTexture *texture = &graph->textures[index];
+            resource->texture = index;
+            texture->busy_until = resource->last_use;
+            if (!texture->used) {
+                graph->stats.transient_bytes += texture->bytes;
+            }
+            texture->used = true;
+
+            graph->stats.transient_resources++;
+            graph->stats.unaliased_bytes += texture->bytes;
+        }
+    }
+
+    // Textures idle for a few frames are dropped. Going backwards keeps
+    // the indices the resources hold valid, since deleting moves the last
+    // texture into the hole and every used one was already visited.
+    for (int i = graph->texture_count - 1; i >= 0; --i) {
+        RenderTexture *texture = &graph->textures[i];
+        texture->unused_frames = texture->used ? 0 :
+                                 texture->unused_frames + 1;
+        if (texture->unused_frames > RENDER_GRAPH_FRAMES) {
+            int moved = graph->texture_count - 1;
+            delete_render_texture(graph, i);
+            for (int r = 0; r < graph->resource_count; ++r) {
+                if (graph->resources[r].texture == moved) {
+                    graph->resources[r].texture = i;
+                }
+            }
+        }
+    }
+}
+
+static GLuint
+get_render_framebuffer(RenderGraph *graph, const GLuint *attachments,
+                       const GLenum *formats, int count) {
+    for (int i = 0; i < graph->framebuffer_count; ++i) {
+        RenderFramebuffer *framebuffer = &graph->framebuffers[i];
+        if (framebuffer->attachment_count == count &&
+            memcmp(framebuffer->attachments, attachments,
+                   count * sizeof(GLuint)) == 0) {
+            return framebuffer->id;
+        }
+    }
+
+    if (graph->framebuffer_count == MAX_RENDER_FRAMEBUFFERS) {
+        printf("Too many render framebuffers (max %d)\n",
+               MAX_RENDER_FRAMEBUFFERS);
+        return 0;
+    }
+
+    RenderFramebuffer *framebuffer =
+        &graph->framebuffers[graph->framebuffer_count++];
+    memcpy(framebuffer->attachments, attachments, count * sizeof(GLuint));
+    framebuffer->attachment_count = count;
+
+    glGenFramebuffers(1, &framebuffer->id);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
+
+    GLenum draw_buffers[MAX_RENDER_PASS_WRITES];
+    int color_count = 0;
+    for (int i = 0; i < count; ++i) {
+        GLenum attachment = get_render_attachment(formats[i], color_count);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                               attachments[i], 0);
+        if (!is_depth_format(formats[i])) {
+            draw_buffers[color_count++] = attachment;
+        }
+    }
+    if (color_count > 0) {
+        glDrawBuffers(color_count, draw_buffers);
+    } else {
+        glDrawBuffer(GL_NONE);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Render graph framebuffer is incomplete\n");
+    }
+
+    graph->stats.framebuffers_created++;
+
+    return framebuffer->id;
+}
+
+static void
+assign_render_framebuffers(RenderGraph *graph) {
+    for (int i = 0; i < graph->pass_count; ++i) {
+        RenderPass *pass = &graph->passes[i];
+        if (pass->culled) {
+            continue;
+        }
+
+        pass->fbo = 0;
+        pass->width = graph->width;
+        pass->height = graph->height;
+
+        GLuint attachments[MAX_RENDER_PASS_WRITES];
+        GLenum formats[MAX_RENDER_PASS_WRITES];
+        int count = 0;
+        for (int w = 0; w < pass->write_count; ++w) {
+            RenderResource *resource = &graph->resources[pass->writes[w]];
+            if (resource->imported) {
+                pass->fbo = resource->fbo;
+                count = 0;
+                break;
+            }
+            attachments[count] = get_render_texture(graph, pass->writes[w]);
+            formats[count] = resource->format;
+            count++;
+            pass->width = resource->width;
+            pass->height = resource->height;
+        }
+
+        if (count > 0) {
+            pass->fbo = get_render_framebuffer(graph, attachments, formats,
+                                               count);
+        }
+    }
+}
+
+static RenderPassStats *
+get_render_pass_stats(RenderGraph *graph, const char *name) {
+    for (int i = 0; i < graph->pass_stats_count; ++i) {
+        if (strcmp(graph->pass_stats[i].name, name) == 0) {
+            return &graph->pass_stats[i];
+        }
+    }
+
+    if (graph->pass_stats_count == MAX_RENDER_PASSES) {
+        return 0;
+    }
+
+    RenderPassStats *result = &graph->pass_stats[graph->pass_stats_count++];
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    return result;
+}
+
+// Reads back the timestamps recorded in `frame`. They are
+// RENDER_GRAPH_FRAMES frames old by now, so normally ready.
+static void
+collect_render_graph_frame(RenderGraph *graph, RenderGraphFrame *frame) {
+    for (int i = 0; i < frame->pass_count; ++i) {
+        GLuint64 begin, end;
+        glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT,
+                              &end);
+
+        RenderPassStats *stats = get_render_pass_stats(graph,
+                                                       frame->pass_names[i]);
+        if (stats) {
+            stats->gpu_samples++;
+            stats->gpu_ms_total += (GLint64)(end - begin) / 1.0e6;
+        }
+    }
+    frame->pass_count = 0;
+}
+
+// Compiles and runs the passes declared since begin_render_graph(). The
+// framebuffer bound on entry is bound again on return.
+static void
+execute_render_graph(RenderGraph *graph) {
+    GLint previous_fbo;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_fbo);
+
+    cull_render_passes(graph);
+    compute_render_lifetimes(graph);
+    allocate_render_textures(graph);
+    assign_render_framebuffers(graph);
+
+    RenderGraphFrame *frame = &graph->frames[graph->frame %
+                                             RENDER_GRAPH_FRAMES];
+    collect_render_graph_frame(graph, frame);
+
+    graph->stats.passes = graph->pass_count;
+    graph->stats.passes_culled = 0;
+
+    for (int i = 0; i < graph->pass_count; ++i) {
+        RenderPass *pass = &graph->passes[i];
+        RenderPassStats *stats = get_render_pass_stats(graph, pass->name);
+
+        if (pass->culled) {
+            graph->stats.passes_culled++;
+            if (stats) {
+                stats->frames_culled++;
+            }
+            continue;
+        }
+        if (stats) {
+            stats->frames_run++;
+        }
+
+        int timing = frame->pass_count++;
+        frame->pass_names[timing] = pass->name;
+        glQueryCounter(frame->queries[timing * 2], GL_TIMESTAMP);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+        glViewport(0, 0, pass->width, pass->height);
+        if (pass->clear) {
+            glClearColor(pass->clear_color[0], pass->clear_color[1],
+                         pass->clear_color[2], pass->clear_color[3]);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                    GL_STENCIL_BUFFER_BIT);
+        }
+
+        if (pass->execute) {
+            pass->execute(graph, pass->data);
+        }
+
+        glQueryCounter(frame->queries[timing * 2 + 1], GL_TIMESTAMP);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_fbo);
+    glViewport(0, 0, graph->width, graph->height);
+
+    graph->frame++;
+}
+
+// Appends the graph's fields to a headless report.
+static void
+print_render_graph_report(RenderGraph *graph) {
+    printf(",\"passes\":%d,\"passes_culled\":%d,\"transient_resources\":%d,"
+           "\"transient_bytes\":%lu,\"unaliased_bytes\":%lu,"
+           "\"textures_created\":%d,\"framebuffers_created\":%d,"
+           "\"pass_gpu_ms\":{",
+           graph->stats.passes, graph->stats.passes_culled,
+           graph->stats.transient_resources,
+           (unsigned long)graph->stats.transient_bytes,
+           (unsigned long)graph->stats.unaliased_bytes,
+           graph->stats.textures_created, graph->stats.framebuffers_created);
+
+    bool first = true;
+    for (int i = 0; i < graph->pass_stats_count; ++i) {
+        RenderPassStats *stats = &graph->pass_stats[i];
+        if (stats->frames_run == 0) {
+            continue;
+        }
+        printf("%s\"%s\":%.4f", first ? "" : ",", stats->name,
+               stats->gpu_samples > 0 ?
+               stats->gpu_ms_total / stats->gpu_samples : 0.0);
+        first = false;
+    }
+    printf("},\"culled_passes\":[");
+
+    first = true;
+    for (int i = 0; i < graph->pass_stats_count; ++i) {
+        RenderPassStats *stats = &graph->pass_stats[i];
+        if (stats->frames_run == 0 && stats->frames_culled > 0) {
+            printf("%s\"%s\"", first ? "" : ",", stats->name);
+            first = false;
+        }
+    }
+    printf("]");
+}
+
+// Blocks on outstanding timestamps so they land in the stats.
+static void
+free_render_graph(RenderGraph *graph) {
+    for (int i = 1; i <= RENDER_GRAPH_FRAMES; ++i) {
+        collect_render_graph_frame(graph,
+                                   &graph->frames[(graph->frame + i) %
+                                                  RENDER_GRAPH_FRAMES]);
+    }
+    for (int i = 0; i < RENDER_GRAPH_FRAMES; ++i) {
+        glDeleteQueries(MAX_RENDER_PASSES * 2, graph->frames[i].queries);
+    }
+
+    while (graph->texture_count > 0) {
+        delete_render_texture(graph, graph->texture_count - 1);
+    }
+}
+
+#endif
@@ -1,6 +1,13 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+
 static GLuint
 compile_shader_raw(GLenum type, const char *source) {
     GLuint result = glCreateShader(type);
@@ -12,11 +19,12 @@ compile_shader_raw(GLenum type, const char *source) {
     GLint success;
     glGetShaderiv(result, GL_COMPILE_STATUS, &success);
     if (success != GL_TRUE) {
-        result = 0;
-
         char buf[512];
         glGetShaderInfoLog(result, sizeof(buf), 0, buf);
         printf("Failed to compile shader: %s\n", buf);
+
+        glDeleteShader(result);
+        result = 0;
     }
 
     return result;
@@ -33,6 +41,10 @@ compile_program_raw(char *vertex_shader_source, char *fragment_shader_source) {
                                                     fragment_shader_source);
         if (fragment_shader) {
             result = glCreateProgram();
+            if (GLEW_ARB_get_program_binary) {
+                glProgramParameteri(result, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                    GL_TRUE);
+            }
             glAttachShader(result, vertex_shader);
             glAttachShader(result, fragment_shader);
             glLinkProgram(result);
@@ -40,13 +52,682 @@ compile_program_raw(char *vertex_shader_source, char *fragment_shader_source) {
             GLint success;
             glGetProgramiv(result, GL_LINK_STATUS, &success);
             if (success != GL_TRUE) {
-                result = 0;
-
                 char buf[512];
                 glGetProgramInfoLog(result, sizeof(buf), 0, buf);
                 printf("Failed to link program: %s\n", buf);
+
+                glDeleteProgram(result);
+                result = 0;
+            } else {
+                glDetachShader(result, vertex_shader);
+                glDetachShader(result, fragment_shader);
+            }
+
+            glDeleteShader(fragment_shader);
+        }
+
+        glDeleteShader(vertex_shader);
+    }
+
+    return result;
+}
+
+// On-disk cache of linked program binaries (ARB_get_program_binary).
+//
+// Entries are keyed by a hash of both shader sources plus GL_RENDERER and
+// GL_VERSION, so a driver update or a shader edit simply misses and falls
+// back to a full compile. A binary the driver refuses to load is treated as a
+// miss too and overwritten.
+#define PROGRAM_CACHE_DIR ".program_cache"
+#define PROGRAM_CACHE_MAGIC 0x48434750 // "PGCH"
+
+typedef struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+    // How long the full compile took when the entry was written, so a hit
+    // can report the time it saved.
+    uint32_t compile_us;
+    uint64_t key;
+} ProgramBinaryHeader;
+
+typedef struct ProgramCacheStats {
+    int hits;
+    int misses;
+    double load_ms;
+    double compile_ms;
+    double saved_ms;
+} ProgramCacheStats;
+
+static ProgramCacheStats PROGRAM_CACHE_STATS;
+
+// FNV-1a, including the terminator so ("ab", "c") and ("a", "bc") differ.
+static uint64_t
+hash_string(uint64_t hash, const char *str) {
+    if (!str) {
+        str = "";
+    }
+
+    do {
+        hash ^= (unsigned char)*str;
+        hash *= 1099511628211ULL;
+    } while (*str++);
+
+    return hash;
+}
+
+static uint64_t
+compute_program_cache_key(const char *vertex_shader_source,
+                          const char *fragment_shader_source) {
+    uint64_t result = 14695981039346656037ULL;
+
+    result = hash_string(result, vertex_shader_source);
+    result = hash_string(result, fragment_shader_source);
+    result = hash_string(result, (const char *)glGetString(GL_RENDERER));
+    result = hash_string(result, (const char *)glGetString(GL_VERSION));
+
+    return result;
+}
+
+static void
+get_program_cache_path(uint64_t key, char *buf, size_t size) {
+    snprintf(buf, size, "%s/%016llx.bin", PROGRAM_CACHE_DIR,
+             (unsigned long long)key);
+}
+
+static GLuint
+load_program_binary(uint64_t key, double *compile_ms) {
+    GLuint result = 0;
+
+    char path[256];
+    get_program_cache_path(key, path, sizeof(path));
+
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        ProgramBinaryHeader header;
+        if (fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == PROGRAM_CACHE_MAGIC && header.key == key) {
+            void *binary = heap_alloc(header.length);
+            if (binary && fread(binary, header.length, 1, file) == 1) {
+                result = glCreateProgram();
+                glProgramBinary(result, header.format, binary, header.length);
+
+                GLint success;
+                glGetProgramiv(result, GL_LINK_STATUS, &success);
+                if (success != GL_TRUE) {
+                    glDeleteProgram(result);
+                    result = 0;
+                } else {
+                    *compile_ms = header.compile_us / 1000.0;
+                }
+            }
+            heap_free(binary);
+        }
+        fclose(file);
+    }
+
+    return result;
+}
+
+static void
+save_program_binary(GLuint program, uint64_t key, double compile_ms) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    void *binary = heap_alloc(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary);
+
+    ProgramBinaryHeader header;
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.format = format;
+    header.length = length;
+    header.compile_us = (uint32_t)(compile_ms * 1000.0);
+    header.key = key;
+
+    char path[256];
+    get_program_cache_path(key, path, sizeof(path));
+
+    mkdir(PROGRAM_CACHE_DIR, 0755);
+    FILE *file = fopen(path, "wb");
+    if (file) {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(binary, length, 1, file);
+        fclose(file);
+    } else {
+        printf("Failed to write program cache entry: %s\n", path);
+    }
+
+    heap_free(binary);
+}
+
+static double
+milliseconds_since(Uint64 start) {
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 /
+           SDL_GetPerformanceFrequency();
+}
+
+// Goes to stderr so it never mixes with the JSON printed by --headless.
+static void
+print_program_cache_report(void) {
+    int total = PROGRAM_CACHE_STATS.hits + PROGRAM_CACHE_STATS.misses;
+    if (total == 0) {
+        return;
+    }
+
+    fprintf(stderr,
+            "Program cache: %d/%d hits (%.0f%%), %.2f ms loading, "
+            "%.2f ms compiling, %.2f ms saved\n",
+            PROGRAM_CACHE_STATS.hits, total,
+            100.0 * PROGRAM_CACHE_STATS.hits / total,
+            PROGRAM_CACHE_STATS.load_ms,
+            PROGRAM_CACHE_STATS.compile_ms,
+            PROGRAM_CACHE_STATS.saved_ms);
+}
+
+#define MAX_PROGRAM_UNIFORMS 16
+
+typedef enum ProgramStatus {
+    PROGRAM_EMPTY,
+    PROGRAM_COMPILING,
+    PROGRAM_READY,
+    PROGRAM_FAILED,
+} ProgramStatus;
+
+// A linked program plus the locations of the uniforms a sample cares about.
+// Samples list their uniforms once in an enum and a matching name table, then
+// index uniforms[] with the enum, so the render loop never looks up names.
+typedef struct Program {
+    GLuint id;
+    GLint uniforms[MAX_PROGRAM_UNIFORMS];
+
+    ProgramStatus status;
+
+    // Only meaningful while status is PROGRAM_COMPILING.
+    GLuint vertex_shader;
+    GLuint fragment_shader;
+    const char **uniform_names;
+    int uniform_count;
+    uint64_t cache_key;
+    Uint64 submit_time;
+} Program;
+
+static bool
+is_sampler_type(GLenum type) {
+    switch (type) {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_RECT:
+        case GL_SAMPLER_BUFFER:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: {
+            return true;
+        }
+
+        default: return false;
+    }
+}
+
+// std140 uniform blocks.
+//
+// Every block name seen in any linked program is given one binding point,
+// shared by all programs, so a block like "Frame" can be uploaded once and
+// bound once per frame no matter how many programs read it. The first
+// program to use a block records its layout; later programs using a
+// different size are reported, as is a mismatch with the C struct size
+// passed to register_uniform_block().
+
+#define MAX_UNIFORM_BLOCKS 8
+#define MAX_UNIFORM_BLOCK_MEMBERS 16
+
+typedef struct UniformBlockMember {
+    char name[64];
+    GLint offset;
+    GLint array_stride;
+    GLint matrix_stride;
+} UniformBlockMember;
+
+typedef struct UniformBlockLayout {
+    char name[64];
+    GLuint binding;
+    // 0 until a program using the block has been linked.
+    GLint size;
+    // sizeof() of the matching C struct, or 0 if not registered.
+    GLint expected_size;
+    UniformBlockMember members[MAX_UNIFORM_BLOCK_MEMBERS];
+    int member_count;
+} UniformBlockLayout;
+
+static UniformBlockLayout UNIFORM_BLOCKS[MAX_UNIFORM_BLOCKS];
+static int UNIFORM_BLOCK_COUNT;
+
+static UniformBlockLayout *
+find_uniform_block(const char *name) {
+    for (int i = 0; i < UNIFORM_BLOCK_COUNT; ++i) {
+        if (strcmp(UNIFORM_BLOCKS[i].name, name) == 0) {
+            return &UNIFORM_BLOCKS[i];
+        }
+    }
+
+    return 0;
+}
+
+// Returns the block's layout, adding it if it is new. `expected_size` is the
+// size of the C struct that mirrors it, or 0 to skip the check. Returns 0 if
+// there are too many blocks.
+static UniformBlockLayout *
+register_uniform_block(const char *name, GLint expected_size) {
+    UniformBlockLayout *result = find_uniform_block(name);
+
+    if (!result) {
+        if (UNIFORM_BLOCK_COUNT == MAX_UNIFORM_BLOCKS) {
+            printf("Too many uniform blocks (max %d)\n", MAX_UNIFORM_BLOCKS);
+            return 0;
+        }
+
+        result = &UNIFORM_BLOCKS[UNIFORM_BLOCK_COUNT];
+        result->binding = UNIFORM_BLOCK_COUNT++;
+        snprintf(result->name, sizeof(result->name), "%s", name);
+    }
+
+    if (expected_size) {
+        result->expected_size = expected_size;
+        if (result->size && result->size != expected_size) {
+            printf("Uniform block %s is %d bytes in GLSL but %d in C\n",
+                   name, result->size, expected_size);
+        }
+    }
+
+    return result;
+}
+
+// Returns the std140 offset of `member` within the block, or -1.
+static GLint
+get_uniform_block_offset(UniformBlockLayout *block, const char *member) {
+    for (int i = 0; i < block->member_count; ++i) {
+        if (strcmp(block->members[i].name, member) == 0) {
+            return block->members[i].offset;
+        }
+    }
+
+    return -1;
+}
+
+static void
+reflect_uniform_block_members(GLuint program, GLuint index,
+                              UniformBlockLayout *block) {
+    GLint active_count = 0;
+    glGetActiveUniformBlockiv(program, index,
+                              GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &active_count);
+    if (active_count <= 0) {
+        block->member_count = 0;
+        return;
+    }
+
+    // GL writes every active index, however many there are.
+    GLint *indices = heap_alloc(active_count * sizeof(GLint));
+    glGetActiveUniformBlockiv(program, index,
+                              GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES,
+                              indices);
+
+    GLint count = active_count;
+    if (count > MAX_UNIFORM_BLOCK_MEMBERS) {
+        printf("Uniform block %s has too many members: %d (max %d)\n",
+               block->name, count, MAX_UNIFORM_BLOCK_MEMBERS);
+        count = MAX_UNIFORM_BLOCK_MEMBERS;
+    }
+
+    GLint offsets[MAX_UNIFORM_BLOCK_MEMBERS];
+    GLint array_strides[MAX_UNIFORM_BLOCK_MEMBERS];
+    GLint matrix_strides[MAX_UNIFORM_BLOCK_MEMBERS];
+    glGetActiveUniformsiv(program, count, (GLuint *)indices,
+                          GL_UNIFORM_OFFSET, offsets);
+    glGetActiveUniformsiv(program, count, (GLuint *)indices,
+                          GL_UNIFORM_ARRAY_STRIDE, array_strides);
+    glGetActiveUniformsiv(program, count, (GLuint *)indices,
+                          GL_UNIFORM_MATRIX_STRIDE, matrix_strides);
+
+    for (int i = 0; i < count; ++i) {
+        UniformBlockMember *member = &block->members[i];
+        glGetActiveUniformName(program, indices[i], sizeof(member->name), 0,
+                               member->name);
+        member->offset = offsets[i];
+        member->array_stride = array_strides[i];
+        member->matrix_stride = matrix_strides[i];
+    }
+    block->member_count = count;
+
+    heap_free(indices);
+}
+
+// Points every uniform block of a linked program at its shared binding.
+static void
+reflect_program_uniform_blocks(GLuint program) {
+    GLint block_count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+
+    for (GLint index = 0; index < block_count; ++index) {
+        char name[64];
+        glGetActiveUniformBlockName(program, index, sizeof(name), 0, name);
+
+        UniformBlockLayout *block = register_uniform_block(name, 0);
+        if (!block) {
+            continue;
+        }
+
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE,
+                                  &size);
+        if (block->size == 0) {
+            block->size = size;
+            reflect_uniform_block_members(program, index, block);
+            if (block->expected_size && block->expected_size != size) {
+                printf("Uniform block %s is %d bytes in GLSL but %d in C\n",
+                       name, size, block->expected_size);
             }
+        } else if (block->size != size) {
+            printf("Uniform block %s is %d bytes here but %d elsewhere\n",
+                   name, size, block->size);
         }
+
+        glUniformBlockBinding(program, index, block->binding);
+    }
+}
+
+// Walks the active uniforms of a linked program once and fills
+// program->uniforms[i] with the location of uniform_names[i], or -1 if the
+// uniform is not active (glUniform* silently ignores -1). Samplers found in
+// the table are bound to consecutive texture units in table order here, so
+// the render loop only has to bind textures to those units. Uniform blocks
+// are bound to their shared binding points too.
+static void
+reflect_program_uniforms(Program *program, const char **uniform_names,
+                         int uniform_count) {
+    GLenum types[MAX_PROGRAM_UNIFORMS];
+
+    if (uniform_count > MAX_PROGRAM_UNIFORMS) {
+        printf("Too many uniforms: %d (max %d)\n", uniform_count,
+               MAX_PROGRAM_UNIFORMS);
+        uniform_count = MAX_PROGRAM_UNIFORMS;
+    }
+
+    for (int i = 0; i < MAX_PROGRAM_UNIFORMS; ++i) {
+        program->uniforms[i] = -1;
+        types[i] = GL_NONE;
+    }
+
+    GLint active_uniform_count = 0;
+    glGetProgramiv(program->id, GL_ACTIVE_UNIFORMS, &active_uniform_count);
+
+    for (GLint index = 0; index < active_uniform_count; ++index) {
+        char name[128];
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program->id, index, sizeof(name), 0, &size, &type,
+                           name);
+
+        // Arrays are reported as "name[0]".
+        char *bracket = strchr(name, '[');
+        if (bracket) {
+            *bracket = 0;
+        }
+
+        for (int i = 0; i < uniform_count; ++i) {
+            if (strcmp(name, uniform_names[i]) == 0) {
+                program->uniforms[i] = glGetUniformLocation(program->id,
+                                                            name);
+                types[i] = type;
+                break;
+            }
+        }
+    }
+
+    use_program(program->id);
+    GLint texture_unit = 0;
+    for (int i = 0; i < uniform_count; ++i) {
+        if (is_sampler_type(types[i])) {
+            glUniform1i(program->uniforms[i], texture_unit++);
+        }
+    }
+
+    reflect_program_uniform_blocks(program->id);
+}
+
+// Lets the driver compile on as many threads as it likes. Without
+// KHR_parallel_shader_compile (or the ARB flavour) compiles still overlap
+// somewhat on drivers that defer work until the first status query.
+static bool
+enable_parallel_shader_compile(void) {
+    static bool initialized = false;
+    static bool supported = false;
+
+    if (!initialized) {
+        initialized = true;
+        if (GLEW_KHR_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            supported = true;
+        } else if (GLEW_ARB_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            supported = true;
+        }
+    }
+
+    return supported;
+}
+
+static GLuint
+submit_shader(GLenum type, const char *source) {
+    GLuint result = glCreateShader(type);
+    glShaderSource(result, 1, &source, 0);
+    glCompileShader(result);
+    return result;
+}
+
+static void
+print_shader_log(GLuint shader) {
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success != GL_TRUE) {
+        char buf[512];
+        glGetShaderInfoLog(shader, sizeof(buf), 0, buf);
+        printf("Failed to compile shader: %s\n", buf);
+    }
+}
+
+// Starts compiling and linking without asking the driver for any status, so
+// a batch of submit_program() calls keeps the driver's compiler threads busy
+// instead of blocking after every shader. A cached binary makes the program
+// ready immediately. Use poll_program() or finish_program() before drawing.
+static void
+submit_program(Program *program, char *vertex_shader_source,
+               char *fragment_shader_source, const char **uniform_names,
+               int uniform_count) {
+    memset(program, 0, sizeof(*program));
+    program->uniform_names = uniform_names;
+    program->uniform_count = uniform_count;
+    program->submit_time = SDL_GetPerformanceCounter();
+
+    enable_parallel_shader_compile();
+
+    if (GLEW_ARB_get_program_binary) {
+        program->cache_key = compute_program_cache_key(vertex_shader_source,
+                                                       fragment_shader_source);
+
+        double recorded_compile_ms = 0;
+        program->id = load_program_binary(program->cache_key,
+                                          &recorded_compile_ms);
+        if (program->id) {
+            double load_ms = milliseconds_since(program->submit_time);
+            PROGRAM_CACHE_STATS.hits++;
+            PROGRAM_CACHE_STATS.load_ms += load_ms;
+            PROGRAM_CACHE_STATS.saved_ms += recorded_compile_ms - load_ms;
+
+            reflect_program_uniforms(program, uniform_names, uniform_count);
+            program->status = PROGRAM_READY;
+            return;
+        }
+    }
+
+    program->vertex_shader = submit_shader(GL_VERTEX_SHADER,
+                                           vertex_shader_source);
+    program->fragment_shader = submit_shader(GL_FRAGMENT_SHADER,
+                                             fragment_shader_source);
+
+    program->id = glCreateProgram();
+    if (GLEW_ARB_get_program_binary) {
+        glProgramParameteri(program->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
+    }
+    glAttachShader(program->id, program->vertex_shader);
+    glAttachShader(program->id, program->fragment_shader);
+    glLinkProgram(program->id);
+
+    program->status = PROGRAM_COMPILING;
+}
+
+// Blocks until a submitted program is linked, then reflects its uniforms and
+// stores its binary in the program cache.
+static void
+finish_program(Program *program) {
+    if (program->status != PROGRAM_COMPILING) {
+        return;
+    }
+
+    GLint success;
+    glGetProgramiv(program->id, GL_LINK_STATUS, &success);
+
+    // For programs finished by poll_program() this is submit-to-ready
+    // latency rather than pure compile time.
+    double compile_ms = milliseconds_since(program->submit_time);
+    PROGRAM_CACHE_STATS.misses++;
+    PROGRAM_CACHE_STATS.compile_ms += compile_ms;
+
+    if (success != GL_TRUE) {
+        print_shader_log(program->vertex_shader);
+        print_shader_log(program->fragment_shader);
+
+        char buf[512];
+        glGetProgramInfoLog(program->id, sizeof(buf), 0, buf);
+        printf("Failed to link program: %s\n", buf);
+
+        glDeleteProgram(program->id);
+        program->id = 0;
+        program->status = PROGRAM_FAILED;
+    } else {
+        glDetachShader(program->id, program->vertex_shader);
+        glDetachShader(program->id, program->fragment_shader);
+
+        reflect_program_uniforms(program, program->uniform_names,
+                                 program->uniform_count);
+        program->status = PROGRAM_READY;
+
+        if (GLEW_ARB_get_program_binary) {
+            save_program_binary(program->id, program->cache_key, compile_ms);
+        }
+    }
+
+    glDeleteShader(program->vertex_shader);
+    glDeleteShader(program->fragment_shader);
+    program->vertex_shader = 0;
+    program->fragment_shader = 0;
+}
+
+// Never blocks when GL_COMPLETION_STATUS_KHR is available: returns false
+// while the driver is still compiling, so the caller can draw something else
+// this frame. Without the extension it falls back to finish_program().
+static bool
+poll_program(Program *program) {
+    if (program->status == PROGRAM_COMPILING) {
+        GLint completed = GL_TRUE;
+        if (enable_parallel_shader_compile()) {
+            glGetProgramiv(program->id, GL_COMPLETION_STATUS_KHR, &completed);
+        }
+
+        if (completed == GL_TRUE) {
+            finish_program(program);
+        }
+    }
+
+    return program->status == PROGRAM_READY;
+}
+
+// Returns how many of the programs are ready to draw with.
+static int
+poll_programs(Program *programs, int count) {
+    int result = 0;
+
+    for (int i = 0; i < count; ++i) {
+        if (poll_program(&programs[i])) {
+            result++;
+        }
+    }
+
+    return result;
+}
+
+static void
+finish_programs(Program *programs, int count) {
+    for (int i = 0; i < count; ++i) {
+        finish_program(&programs[i]);
+    }
+}
+
+static Program
+create_program(char *vertex_shader_source, char *fragment_shader_source,
+               const char **uniform_names, int uniform_count) {
+    Program result;
+
+    submit_program(&result, vertex_shader_source, fragment_shader_source,
+                   uniform_names, uniform_count);
+    finish_program(&result);
+
+    return result;
+}
+
+// Compute programs are few and built once at startup, so they skip the
+// program cache and async compiles. Needs ARB_compute_shader.
+static Program
+create_compute_program(char *compute_shader_source,
+                       const char **uniform_names, int uniform_count) {
+    Program result;
+    memset(&result, 0, sizeof(result));
+    result.status = PROGRAM_FAILED;
+
+    GLuint shader = compile_shader_raw(GL_COMPUTE_SHADER,
+                                       compute_shader_source);
+    if (shader) {
+        result.id = glCreateProgram();
+        glAttachShader(result.id, shader);
+        glLinkProgram(result.id);
+
+        GLint success;
+        glGetProgramiv(result.id, GL_LINK_STATUS, &success);
+        if (success != GL_TRUE) {
+            char buf[512];
+            glGetProgramInfoLog(result.id, sizeof(buf), 0, buf);
+            printf("Failed to link program: %s\n", buf);
+
+            glDeleteProgram(result.id);
+            result.id = 0;
+        } else {
+            glDetachShader(result.id, shader);
+            reflect_program_uniforms(&result, uniform_names, uniform_count);
+            result.status = PROGRAM_READY;
+        }
+
+        glDeleteShader(shader);
     }
 
     return result;
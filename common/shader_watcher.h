@@ -0,0 +1,298 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+// Shader hot reload.
+//
+// submit_watched_program() reads the vertex and fragment shader from files
+// and submits them like submit_program(). The directories holding them are
+// watched with inotify; once a frame update_shader_watcher() recompiles every
+// program whose sources changed with compile_program_raw() and, only if that
+// succeeds, swaps the new program id into the Program in place. A broken edit
+// prints the compile log and leaves the previous program running.
+//
+// Watched programs live in a Pool, so unwatch_program() frees a slot for the
+// next program without disturbing the others.
+//
+// Watching needs inotify, so elsewhere programs load once and never reload.
+
+#include "common/shader.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define MAX_WATCHED_PROGRAMS 16
+
+typedef struct WatchedProgram {
+    Program *program;
+    char vertex_path[256];
+    char fragment_path[256];
+    int vertex_watch;
+    int fragment_watch;
+    bool dirty;
+} WatchedProgram;
+
+typedef struct ShaderWatcher {
+    int fd;
+    // Of WatchedProgram.
+    Pool programs;
+    int reload_count;
+} ShaderWatcher;
+
+// Returns a malloc'd, NUL terminated copy of the file, or 0.
+static char *
+read_shader_file(const char *path) {
+    char *result = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Failed to open shader %s\n", path);
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size >= 0) {
+        result = heap_alloc(size + 1);
+        if (fread(result, 1, size, file) == (size_t)size) {
+            result[size] = 0;
+        } else {
+            printf("Failed to read shader %s\n", path);
+            heap_free(result);
+            result = 0;
+        }
+    }
+
+    fclose(file);
+
+    return result;
+}
+
+static const char *
+get_file_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+#ifdef __linux__
+
+static void
+init_shader_watcher(ShaderWatcher *watcher) {
+    memset(watcher, 0, sizeof(*watcher));
+    init_pool(&watcher->programs, sizeof(WatchedProgram),
+              MAX_WATCHED_PROGRAMS);
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0) {
+        printf("Failed to initialize inotify, shaders will not reload\n");
+    }
+}
+
+// Editors often save by writing a new file and renaming it over the old one,
+// which would silently end a watch on the file itself, so the directory is
+// watched instead and events are matched by name.
+static int
+watch_shader_file(ShaderWatcher *watcher, const char *path) {
+    if (watcher->fd < 0) {
+        return -1;
+    }
+
+    char dir[256];
+    const char *name = get_file_name(path);
+    if (name == path) {
+        snprintf(dir, sizeof(dir), ".");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(name - path), path);
+    }
+
+    int result = inotify_add_watch(watcher->fd, dir,
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (result < 0) {
+        printf("Failed to watch %s\n", dir);
+    }
+
+    return result;
+}
+
+static void
+read_shader_watcher_events(ShaderWatcher *watcher) {
+    if (watcher->fd < 0) {
+        return;
+    }
+
+    // The union keeps the buffer aligned for struct inotify_event.
+    union {
+        struct inotify_event event;
+        char buf[4096];
+    } events;
+    char *buf = events.buf;
+
+    for (;;) {
+        ssize_t length = read(watcher->fd, buf, sizeof(events));
+        if (length <= 0) {
+            break;
+        }
+
+        for (char *p = buf; p < buf + length; ) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->len == 0) {
+                continue;
+            }
+
+            for (int i = 0; i < watcher->programs.capacity; ++i) {
+                WatchedProgram *watched = get_pool_item(&watcher->programs,
+                                                        i);
+                if (watched &&
+                    ((event->wd == watched->vertex_watch &&
+                      strcmp(event->name,
+                             get_file_name(watched->vertex_path)) == 0) ||
+                     (event->wd == watched->fragment_watch &&
+                      strcmp(event->name,
+                             get_file_name(watched->fragment_path)) == 0))) {
+                    watched->dirty = true;
+                }
+            }
+        }
+    }
+}
+
+#else
+
+static void
+init_shader_watcher(ShaderWatcher *watcher) {
+    memset(watcher, 0, sizeof(*watcher));
+    init_pool(&watcher->programs, sizeof(WatchedProgram),
+              MAX_WATCHED_PROGRAMS);
+    watcher->fd = -1;
+}
+
+static int
+watch_shader_file(ShaderWatcher *watcher, const char *path) {
+    (void)watcher;
+    (void)path;
+    return -1;
+}
+
+static void
+read_shader_watcher_events(ShaderWatcher *watcher) {
+    (void)watcher;
+}
+
+#endif
+
+// Like submit_program(), with the sources read from files. `program` must
+// stay at the same address while it is watched. Returns false if either file
+// cannot be read; the program is still watched so fixing the file loads it.
+static bool
+submit_watched_program(ShaderWatcher *watcher, Program *program,
+                       const char *vertex_path, const char *fragment_path,
+                       const char **uniform_names, int uniform_count) {
+    memset(program, 0, sizeof(*program));
+    program->uniform_names = uniform_names;
+    program->uniform_count = uniform_count;
+    program->status = PROGRAM_FAILED;
+
+    WatchedProgram *watched = allocate_from_pool(&watcher->programs);
+    if (!watched) {
+        printf("Too many watched programs (max %d)\n", MAX_WATCHED_PROGRAMS);
+    } else {
+        watched->program = program;
+        snprintf(watched->vertex_path, sizeof(watched->vertex_path), "%s",
+                 vertex_path);
+        snprintf(watched->fragment_path, sizeof(watched->fragment_path), "%s",
+                 fragment_path);
+        watched->vertex_watch = watch_shader_file(watcher, vertex_path);
+        watched->fragment_watch = watch_shader_file(watcher, fragment_path);
+    }
+
+    char *vertex_source = read_shader_file(vertex_path);
+    char *fragment_source = read_shader_file(fragment_path);
+    bool result = vertex_source && fragment_source;
+    if (result) {
+        submit_program(program, vertex_source, fragment_source, uniform_names,
+                       uniform_count);
+    }
+    heap_free(vertex_source);
+    heap_free(fragment_source);
+
+    return result;
+}
+
+static bool
+reload_watched_program(WatchedProgram *watched) {
+    Program *program = watched->program;
+
+    char *vertex_source = read_shader_file(watched->vertex_path);
+    char *fragment_source = read_shader_file(watched->fragment_path);
+
+    GLuint id = 0;
+    if (vertex_source && fragment_source) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        id = compile_program_raw(vertex_source, fragment_source);
+        if (id) {
+            // Let a pending async compile of the old sources land first so it
+            // cannot overwrite the new id later.
+            finish_program(program);
+            if (program->id) {
+                glDeleteProgram(program->id);
+            }
+
+            program->id = id;
+            program->status = PROGRAM_READY;
+            reflect_program_uniforms(program, program->uniform_names,
+                                     program->uniform_count);
+
+            printf("Reloaded %s + %s in %.2f ms\n", watched->vertex_path,
+                   watched->fragment_path, milliseconds_since(start));
+        } else {
+            printf("Keeping previous program for %s + %s\n",
+                   watched->vertex_path, watched->fragment_path);
+        }
+    }
+
+    heap_free(vertex_source);
+    heap_free(fragment_source);
+
+    return id != 0;
+}
+
+// Stops reloading `program`, which may then be deleted or moved. The
+// directory watches stay, since other programs may share them.
+static void
+unwatch_program(ShaderWatcher *watcher, Program *program) {
+    for (int i = 0; i < watcher->programs.capacity; ++i) {
+        WatchedProgram *watched = get_pool_item(&watcher->programs, i);
+        if (watched && watched->program == program) {
+            release_to_pool(&watcher->programs, watched);
+        }
+    }
+}
+
+// Call once per frame, before the watched programs are used. Returns the
+// number of programs swapped.
+static int
+update_shader_watcher(ShaderWatcher *watcher) {
+    int result = 0;
+
+    read_shader_watcher_events(watcher);
+
+    for (int i = 0; i < watcher->programs.capacity; ++i) {
+        WatchedProgram *watched = get_pool_item(&watcher->programs, i);
+        if (watched && watched->dirty) {
+            watched->dirty = false;
+            if (reload_watched_program(watched)) {
+                result++;
+            }
+        }
+    }
+
+    watcher->reload_count += result;
+
+    return result;
+}
+
+#endif
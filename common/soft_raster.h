@@ -0,0 +1,855 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+// CPU reference rasterizer for the subset of GL the samples use, so their
+// output and cost can be checked on hosts without a GPU.
+//
+//   init_soft_rasterizer(&raster, 960, 540);
+//   soft_clear(&raster, clear_color);
+//   soft_draw(&raster, &draw);           // as many as needed
+//   flush_soft_rasterizer(&raster, &jobs);
+//   save_soft_raster_ppm(&raster, "golden.ppm");
+//
+// What is supported is what the samples draw: triangles from an interleaved
+// float vertex array, optionally indexed with GLushort or GLuint indices,
+// whose vertex shader passes the position straight through with w = 1.
+// Attributes after the position become varyings, interpolated linearly
+// (there is no perspective to correct for) and handed four pixels at a time
+// to a fragment shader written in C. There is no depth test, blending or
+// clipping; vertices must stay within SOFT_GUARD_BAND pixels of the viewport
+// and triangles that do not are dropped and counted as culled.
+//
+// soft_draw() only sets triangles up and bins them into SOFT_TILE_SIZE
+// square tiles. flush_soft_rasterizer() rasterizes the tiles in parallel on
+// a JobSystem, each tile on one thread and its triangles in submission order,
+// so the result is the same for any thread count.
+//
+// Coverage follows GL's rules: vertices snap to 1/16 pixel, pixels are
+// sampled at their centers and shared edges use a top-left rule, so no pixel
+// is drawn twice or missed. Edge functions are evaluated in 32-bit integers
+// four pixels at a time, with SSE2 where available; the scalar fallback does
+// the same arithmetic in the same order and produces identical images.
+//
+// Textures are RGBA8 with a box-filtered mip chain, sampled with GL_REPEAT
+// and trilinear filtering (bilinear when magnified).
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common/job_system.h"
+#include "common/memory.h"
+
+#define SOFT_TILE_SIZE 64
+#define SOFT_MAX_VARYINGS 8
+#define SOFT_MAX_MIP_LEVELS 16
+#define SOFT_SUBPIXEL_BITS 4
+// Vertices must land within this many pixels of the viewport origin, and the
+// framebuffer can be no larger; together they keep edge function steps in
+// 32 bits.
+#define SOFT_GUARD_BAND 8192
+
+typedef struct SoftTexture {
+    int levels;
+    int width[SOFT_MAX_MIP_LEVELS];
+    int height[SOFT_MAX_MIP_LEVELS];
+    // RGBA8, first row first, like glTexImage2D.
+    unsigned char *pixels[SOFT_MAX_MIP_LEVELS];
+} SoftTexture;
+
+// Four horizontally adjacent pixels in structure-of-arrays form.
+typedef struct SoftFragments {
+    float varyings[SOFT_MAX_VARYINGS][4];
+    // Screen-space derivatives of the draw's texcoord varying: du/dx, dv/dx,
+    // du/dy, dv/dy. Constant over a triangle since w is always 1.
+    float gradient[4];
+    // Written by the shader, [channel][lane].
+    float color[4][4];
+} SoftFragments;
+
+typedef void (*SoftFragmentShader)(SoftFragments *fragments,
+                                   const void *uniforms);
+
+typedef struct SoftDraw {
+    // Interleaved floats, `stride` per vertex. x and y are read from
+    // position_offset; varying_count floats from varying_offset become the
+    // varyings.
+    const GLfloat *vertices;
+    int stride;
+    int position_offset;
+    int varying_offset;
+    int varying_count;
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, or 0 indices to draw vertices in
+    // order like glDrawArrays.
+    const void *indices;
+    GLenum index_type;
+    int count;
+
+    // Varying holding u, with v after it, or -1. Gives sample_soft_texture()
+    // its derivatives.
+    int texcoord_varying;
+
+    SoftFragmentShader shader;
+    const void *uniforms;
+} SoftDraw;
+
+typedef struct SoftTriangle {
+    // Edge functions a * x + b * y + c over subpixel coordinates, >= 0 inside.
+    // The top-left rule is folded into c.
+    int32_t a[3];
+    int32_t b[3];
+    int64_t c[3];
+
+    // Inclusive pixel bounds, clipped to the framebuffer.
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+
+    // Varying v at pixel center (x, y) is
+    // planes[v][0] + planes[v][1] * (x - origin[0]) +
+    // planes[v][2] * (y - origin[1]).
+    float origin[2];
+    float planes[SOFT_MAX_VARYINGS][3];
+    int varying_count;
+    float gradient[4];
+
+    SoftFragmentShader shader;
+    const void *uniforms;
+} SoftTriangle;
+
+typedef struct SoftTileBin {
+    int *triangles;
+    int count;
+    int capacity;
+} SoftTileBin;
+
+typedef struct SoftRasterStats {
+    int triangles;
+    // Degenerate, entirely off screen or past the guard band.
+    int triangles_culled;
+    // Triangle-tile pairs rasterized.
+    int64_t bin_entries;
+    // Pixels shaded.
+    int64_t fragments;
+} SoftRasterStats;
+
+typedef struct SoftRasterizer {
+    int width;
+    int height;
+    // RGBA8, bottom row first like glReadPixels.
+    uint32_t *color;
+
+    int tiles_x;
+    int tiles_y;
+    SoftTileBin *bins;
+
+    // Set up by soft_draw(), consumed by flush_soft_rasterizer().
+    SoftTriangle *triangles;
+    int triangle_count;
+    int triangle_capacity;
+
+    // Reset by reset_soft_raster_stats().
+    SoftRasterStats stats;
+    // Per job thread while flushing, then added to stats.
+    int64_t thread_fragments[MAX_JOB_THREADS];
+} SoftRasterizer;
+
+//
+// Textures
+//
+
+// Converts `channels` (3 or 4) bytes per pixel to RGBA8 and builds the mip
+// chain down to 1x1.
+static void
+init_soft_texture(SoftTexture *texture, const unsigned char *pixels,
+                  int width, int height, int channels) {
+    memset(texture, 0, sizeof(*texture));
+
+    unsigned char *level = heap_alloc((size_t)width * height * 4);
+    for (int i = 0; i < width * height; ++i) {
+        level[i * 4 + 0] = pixels[i * channels + 0];
+        level[i * 4 + 1] = pixels[i * channels + 1];
+        level[i * 4 + 2] = pixels[i * channels + 2];
+        level[i * 4 + 3] = channels == 4 ? pixels[i * channels + 3] : 255;
+    }
+    texture->pixels[0] = level;
+    texture->width[0] = width;
+    texture->height[0] = height;
+    texture->levels = 1;
+
+    while ((width > 1 || height > 1) &&
+           texture->levels < SOFT_MAX_MIP_LEVELS) {
+        const unsigned char *src = level;
+        int src_width = width;
+        int src_height = height;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+
+        level = heap_alloc((size_t)width * height * 4);
+        for (int y = 0; y < height; ++y) {
+            int y0 = y * 2 < src_height ? y * 2 : src_height - 1;
+            int y1 = y * 2 + 1 < src_height ? y * 2 + 1 : y0;
+            for (int x = 0; x < width; ++x) {
+                int x0 = x * 2 < src_width ? x * 2 : src_width - 1;
+                int x1 = x * 2 + 1 < src_width ? x * 2 + 1 : x0;
+                for (int c = 0; c < 4; ++c) {
+                    int sum = src[(y0 * src_width + x0) * 4 + c] +
+                              src[(y0 * src_width + x1) * 4 + c] +
+                              src[(y1 * src_width + x0) * 4 + c] +
+                              src[(y1 * src_width + x1) * 4 + c];
+                    level[(y * width + x) * 4 + c] =
+                        (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+
+        texture->pixels[texture->levels] = level;
+        texture->width[texture->levels] = width;
+        texture->height[texture->levels] = height;
+        texture->levels++;
+    }
+}
+
+static void
+free_soft_texture(SoftTexture *texture) {
+    for (int i = 0; i < texture->levels; ++i) {
+        heap_free(texture->pixels[i]);
+    }
+    memset(texture, 0, sizeof(*texture));
+}
+
+static int
+wrap_texel(int i, int size) {
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+static void
+sample_soft_level(const SoftTexture *texture, int level, float u, float v,
+                  float out[4]) {
+    int width = texture->width[level];
+    int height = texture->height[level];
+    const unsigned char *pixels = texture->pixels[level];
+
+    float x = u * width - 0.5f;
+    float y = v * height - 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float tx = x - fx;
+    float ty = y - fy;
+    int x0 = wrap_texel((int)fx, width);
+    int x1 = wrap_texel((int)fx + 1, width);
+    int y0 = wrap_texel((int)fy, height);
+    int y1 = wrap_texel((int)fy + 1, height);
+
+    const unsigned char *p00 = pixels + (y0 * width + x0) * 4;
+    const unsigned char *p10 = pixels + (y0 * width + x1) * 4;
+    const unsigned char *p01 = pixels + (y1 * width + x0) * 4;
+    const unsigned char *p11 = pixels + (y1 * width + x1) * 4;
+    for (int c = 0; c < 4; ++c) {
+        float top = p00[c] + (p10[c] - p00[c]) * tx;
+        float bottom = p01[c] + (p11[c] - p01[c]) * tx;
+        out[c] = (top + (bottom - top) * ty) / 255.0f;
+    }
+}
+
+// texture(sampler, uv) for all four lanes, uv taken from varyings
+// `texcoord` and `texcoord + 1`. out is [channel][lane].
+static void
+sample_soft_texture(const SoftTexture *texture,
+                    const SoftFragments *fragments, int texcoord,
+                    float out[4][4]) {
+    const float *g = fragments->gradient;
+    float w = (float)texture->width[0];
+    float h = (float)texture->height[0];
+    float rho_x = g[0] * g[0] * w * w + g[1] * g[1] * h * h;
+    float rho_y = g[2] * g[2] * w * w + g[3] * g[3] * h * h;
+    float rho = rho_x > rho_y ? rho_x : rho_y;
+    float lod = rho > 0.0f ? 0.5f * log2f(rho) : 0.0f;
+    if (lod > texture->levels - 1) {
+        lod = (float)(texture->levels - 1);
+    }
+
+    for (int lane = 0; lane < 4; ++lane) {
+        float u = fragments->varyings[texcoord][lane];
+        float v = fragments->varyings[texcoord + 1][lane];
+        float texel[4];
+
+        if (lod <= 0.0f) {
+            sample_soft_level(texture, 0, u, v, texel);
+        } else {
+            int level = (int)lod;
+            float t = lod - level;
+            sample_soft_level(texture, level, u, v, texel);
+            if (t > 0.0f && level + 1 < texture->levels) {
+                float next[4];
+                sample_soft_level(texture, level + 1, u, v, next);
+                for (int c = 0; c < 4; ++c) {
+                    texel[c] += (next[c] - texel[c]) * t;
+                }
+            }
+        }
+
+        for (int c = 0; c < 4; ++c) {
+            out[c][lane] = texel[c];
+        }
+    }
+}
+
+//
+// Setup and binning
+//
+
+static bool
+init_soft_rasterizer(SoftRasterizer *raster, int width, int height) {
+    memset(raster, 0, sizeof(*raster));
+
+    if (width < 1 || height < 1 ||
+        width > SOFT_GUARD_BAND || height > SOFT_GUARD_BAND) {
+        printf("Failed to create %dx%d software framebuffer (max %d)\n",
+               width, height, SOFT_GUARD_BAND);
+        return false;
+    }
+
+    raster->width = width;
+    raster->height = height;
+    raster->color = heap_calloc((size_t)width * height, sizeof(uint32_t));
+    raster->tiles_x = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    raster->tiles_y = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    raster->bins = heap_calloc(raster->tiles_x * raster->tiles_y,
+                               sizeof(SoftTileBin));
+
+    return true;
+}
+
+static void
+free_soft_rasterizer(SoftRasterizer *raster) {
+    for (int i = 0; i < raster->tiles_x * raster->tiles_y; ++i) {
+        heap_free(raster->bins[i].triangles);
+    }
+    heap_free(raster->bins);
+    heap_free(raster->triangles);
+    heap_free(raster->color);
+    memset(raster, 0, sizeof(*raster));
+}
+
+static void
+reset_soft_raster_stats(SoftRasterizer *raster) {
+    memset(&raster->stats, 0, sizeof(raster->stats));
+}
+
+static uint32_t
+pack_soft_color(const float color[4]) {
+    uint32_t result = 0;
+    for (int c = 0; c < 4; ++c) {
+        float value = color[c] > 0.0f ? color[c] : 0.0f;
+        value = value < 1.0f ? value : 1.0f;
+        result |= (uint32_t)(int)(value * 255.0f + 0.5f) << (c * 8);
+    }
+    return result;
+}
+
+// Like glClear(GL_COLOR_BUFFER_BIT). Call before drawing the frame.
+static void
+soft_clear(SoftRasterizer *raster, const float color[4]) {
+    uint32_t packed = pack_soft_color(color);
+    for (int i = 0; i < raster->width * raster->height; ++i) {
+        raster->color[i] = packed;
+    }
+}
+
+static int
+floor_div(int value, int divisor) {
+    int result = value / divisor;
+    return result * divisor > value ? result - 1 : result;
+}
+
+static void
+bin_soft_triangle(SoftRasterizer *raster, int index) {
+    SoftTriangle *triangle = &raster->triangles[index];
+    int tile_x0 = triangle->min_x / SOFT_TILE_SIZE;
+    int tile_y0 = triangle->min_y / SOFT_TILE_SIZE;
+    int tile_x1 = triangle->max_x / SOFT_TILE_SIZE;
+    int tile_y1 = triangle->max_y / SOFT_TILE_SIZE;
+
+    for (int ty = tile_y0; ty <= tile_y1; ++ty) {
+        for (int tx = tile_x0; tx <= tile_x1; ++tx) {
+            SoftTileBin *bin = &raster->bins[ty * raster->tiles_x + tx];
+            if (bin->count == bin->capacity) {
+                bin->capacity = bin->capacity ? bin->capacity * 2 : 64;
+                bin->triangles = heap_realloc(bin->triangles,
+                                              bin->capacity * sizeof(int));
+            }
+            bin->triangles[bin->count++] = index;
+        }
+    }
+}
+
+static const GLfloat *
+fetch_soft_vertex(const SoftDraw *draw, int i) {
+    int index = i;
+    if (draw->indices && draw->index_type == GL_UNSIGNED_SHORT) {
+        index = ((const GLushort *)draw->indices)[i];
+    } else if (draw->indices) {
+        index = (int)((const GLuint *)draw->indices)[i];
+    }
+    return draw->vertices + (size_t)index * draw->stride;
+}
+
+// Returns false if the triangle is culled.
+static bool
+setup_soft_triangle(SoftRasterizer *raster, const SoftDraw *draw,
+                    const GLfloat *vertices[3], SoftTriangle *triangle) {
+    int32_t x[3], y[3];
+    for (int i = 0; i < 3; ++i) {
+        const GLfloat *pos = vertices[i] + draw->position_offset;
+        float wx = (pos[0] * 0.5f + 0.5f) * raster->width;
+        float wy = (pos[1] * 0.5f + 0.5f) * raster->height;
+        if (!(wx > -SOFT_GUARD_BAND && wx < SOFT_GUARD_BAND &&
+              wy > -SOFT_GUARD_BAND && wy < SOFT_GUARD_BAND)) {
+            return false;
+        }
+        x[i] = (int32_t)floorf(wx * (1 << SOFT_SUBPIXEL_BITS) + 0.5f);
+        y[i] = (int32_t)floorf(wy * (1 << SOFT_SUBPIXEL_BITS) + 0.5f);
+    }
+
+    // Make every triangle counter-clockwise so the inside is positive.
+    int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) -
+                   (int64_t)(x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0) {
+        return false;
+    }
+    if (area < 0) {
+        int32_t swap = x[1];
+        x[1] = x[2];
+        x[2] = swap;
+        swap = y[1];
+        y[1] = y[2];
+        y[2] = swap;
+        const GLfloat *vertex = vertices[1];
+        vertices[1] = vertices[2];
+        vertices[2] = vertex;
+    }
+
+    // Pixel (px, py) is sampled at subpixel (16 px + 8, 16 py + 8).
+    int half = 1 << (SOFT_SUBPIXEL_BITS - 1);
+    int min_x = x[0], max_x = x[0], min_y = y[0], max_y = y[0];
+    for (int i = 1; i < 3; ++i) {
+        min_x = x[i] < min_x ? x[i] : min_x;
+        max_x = x[i] > max_x ? x[i] : max_x;
+        min_y = y[i] < min_y ? y[i] : min_y;
+        max_y = y[i] > max_y ? y[i] : max_y;
+    }
+    triangle->min_x = floor_div(min_x - half - 1, 1 << SOFT_SUBPIXEL_BITS) +
+                      1;
+    triangle->min_y = floor_div(min_y - half - 1, 1 << SOFT_SUBPIXEL_BITS) +
+                      1;
+    triangle->max_x = floor_div(max_x - half, 1 << SOFT_SUBPIXEL_BITS);
+    triangle->max_y = floor_div(max_y - half, 1 << SOFT_SUBPIXEL_BITS);
+    triangle->min_x = triangle->min_x < 0 ? 0 : triangle->min_x;
+    triangle->min_y = triangle->min_y < 0 ? 0 : triangle->min_y;
+    if (triangle->max_x >= raster->width) {
+        triangle->max_x = raster->width - 1;
+    }
+    if (triangle->max_y >= raster->height) {
+        triangle->max_y = raster->height - 1;
+    }
+    if (triangle->min_x > triangle->max_x ||
+        triangle->min_y > triangle->max_y) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        int from = (i + 1) % 3;
+        int to = (i + 2) % 3;
+        int32_t a = y[from] - y[to];
+        int32_t b = x[to] - x[from];
+        // Top-left rule in GL's bottom-up window coordinates: left edges run
+        // downwards and top edges run right to left.
+        bool inclusive = a > 0 || (a == 0 && b < 0);
+        triangle->a[i] = a;
+        triangle->b[i] = b;
+        triangle->c[i] = -((int64_t)a * x[from] + (int64_t)b * y[from]) -
+                         (inclusive ? 0 : 1);
+    }
+
+    float fx[3], fy[3];
+    for (int i = 0; i < 3; ++i) {
+        fx[i] = x[i] / (float)(1 << SOFT_SUBPIXEL_BITS);
+        fy[i] = y[i] / (float)(1 << SOFT_SUBPIXEL_BITS);
+    }
+    float e1x = fx[1] - fx[0], e1y = fy[1] - fy[0];
+    float e2x = fx[2] - fx[0], e2y = fy[2] - fy[0];
+    float det = e1x * e2y - e2x * e1y;
+
+    triangle->origin[0] = fx[0];
+    triangle->origin[1] = fy[0];
+    triangle->varying_count = draw->varying_count;
+    for (int v = 0; v < draw->varying_count; ++v) {
+        float v0 = vertices[0][draw->varying_offset + v];
+        float d1 = vertices[1][draw->varying_offset + v] - v0;
+        float d2 = vertices[2][draw->varying_offset + v] - v0;
+        triangle->planes[v][0] = v0;
+        triangle->planes[v][1] = (d1 * e2y - d2 * e1y) / det;
+        triangle->planes[v][2] = (d2 * e1x - d1 * e2x) / det;
+    }
+
+    memset(triangle->gradient, 0, sizeof(triangle->gradient));
+    int t = draw->texcoord_varying;
+    if (t >= 0) {
+        triangle->gradient[0] = triangle->planes[t][1];
+        triangle->gradient[1] = triangle->planes[t + 1][1];
+        triangle->gradient[2] = triangle->planes[t][2];
+        triangle->gradient[3] = triangle->planes[t + 1][2];
+    }
+
+    triangle->shader = draw->shader;
+    triangle->uniforms = draw->uniforms;
+
+    return true;
+}
+
+// Like glDrawElements(GL_TRIANGLES, ...) or, without indices,
+// glDrawArrays(GL_TRIANGLES, ...). Nothing is drawn until
+// flush_soft_rasterizer().
+static void
+soft_draw(SoftRasterizer *raster, const SoftDraw *draw) {
+    int triangle_count = draw->count / 3;
+    if (draw->varying_count > SOFT_MAX_VARYINGS) {
+        printf("Too many varyings (max %d)\n", SOFT_MAX_VARYINGS);
+        return;
+    }
+
+    if (raster->triangle_count + triangle_count > raster->triangle_capacity) {
+        int capacity = raster->triangle_capacity ?
+                       raster->triangle_capacity : 1024;
+        while (capacity < raster->triangle_count + triangle_count) {
+            capacity *= 2;
+        }
+        raster->triangles = heap_realloc(raster->triangles,
+                                         capacity * sizeof(SoftTriangle));
+        raster->triangle_capacity = capacity;
+    }
+
+    for (int i = 0; i < triangle_count; ++i) {
+        const GLfloat *vertices[3] = {
+            fetch_soft_vertex(draw, i * 3),
+            fetch_soft_vertex(draw, i * 3 + 1),
+            fetch_soft_vertex(draw, i * 3 + 2),
+        };
+
+        raster->stats.triangles++;
+        int index = raster->triangle_count;
+        if (setup_soft_triangle(raster, draw, vertices,
+                                &raster->triangles[index])) {
+            raster->triangle_count++;
+            bin_soft_triangle(raster, index);
+        } else {
+            raster->stats.triangles_culled++;
+        }
+    }
+}
+
+//
+// Rasterization
+//
+
+// Interpolates the varyings for pixels x..x+3 of a row, shades them and
+// writes the ones in `mask`.
+static void
+shade_soft_pixels(SoftRasterizer *raster, const SoftTriangle *triangle,
+                  const float *row_varyings, int x, int y, int mask) {
+    SoftFragments fragments;
+    memcpy(fragments.gradient, triangle->gradient,
+           sizeof(fragments.gradient));
+
+#ifdef __SSE2__
+    __m128 px = _mm_add_ps(_mm_cvtepi32_ps(_mm_setr_epi32(x, x + 1, x + 2,
+                                                          x + 3)),
+                           _mm_set1_ps(0.5f));
+    __m128 dx = _mm_sub_ps(px, _mm_set1_ps(triangle->origin[0]));
+    for (int v = 0; v < triangle->varying_count; ++v) {
+        __m128 value = _mm_add_ps(_mm_set1_ps(row_varyings[v]),
+                                  _mm_mul_ps(_mm_set1_ps(
+                                                 triangle->planes[v][1]),
+                                             dx));
+        _mm_storeu_ps(fragments.varyings[v], value);
+    }
+#else
+    for (int v = 0; v < triangle->varying_count; ++v) {
+        for (int lane = 0; lane < 4; ++lane) {
+            float dx = ((float)(x + lane) + 0.5f) - triangle->origin[0];
+            fragments.varyings[v][lane] = row_varyings[v] +
+                                          triangle->planes[v][1] * dx;
+        }
+    }
+#endif
+
+    triangle->shader(&fragments, triangle->uniforms);
+
+    uint32_t *row = raster->color + (size_t)y * raster->width;
+    for (int lane = 0; lane < 4; ++lane) {
+        if (mask & (1 << lane)) {
+            float color[4] = {
+                fragments.color[0][lane],
+                fragments.color[1][lane],
+                fragments.color[2][lane],
+                fragments.color[3][lane],
+            };
+            row[x + lane] = pack_soft_color(color);
+        }
+    }
+}
+
+// Returns the number of pixels shaded.
+static int64_t
+rasterize_soft_triangle(SoftRasterizer *raster, const SoftTriangle *triangle,
+                        int tile_x, int tile_y) {
+    int64_t result = 0;
+    int one = 1 << SOFT_SUBPIXEL_BITS;
+    int half = one / 2;
+
+    int x0 = tile_x * SOFT_TILE_SIZE;
+    int y0 = tile_y * SOFT_TILE_SIZE;
+    int x1 = x0 + SOFT_TILE_SIZE - 1;
+    int y1 = y0 + SOFT_TILE_SIZE - 1;
+    x0 = triangle->min_x > x0 ? triangle->min_x : x0;
+    y0 = triangle->min_y > y0 ? triangle->min_y : y0;
+    x1 = triangle->max_x < x1 ? triangle->max_x : x1;
+    y1 = triangle->max_y < y1 ? triangle->max_y : y1;
+
+    // Classify each edge against the box: entirely outside rejects the
+    // triangle, entirely inside means the edge need not be tested. Edges
+    // that cross the box vary by less than 2^30 over it, so their values fit
+    // in 32 bits.
+    int64_t sx0 = (int64_t)x0 * one + half, sx1 = (int64_t)x1 * one + half;
+    int64_t sy0 = (int64_t)y0 * one + half, sy1 = (int64_t)y1 * one + half;
+    int32_t start[3], step_x[3], step_y[3];
+    for (int i = 0; i < 3; ++i) {
+        int64_t ax0 = triangle->a[i] * sx0, ax1 = triangle->a[i] * sx1;
+        int64_t by0 = triangle->b[i] * sy0, by1 = triangle->b[i] * sy1;
+        int64_t low = (ax0 < ax1 ? ax0 : ax1) + (by0 < by1 ? by0 : by1) +
+                      triangle->c[i];
+        int64_t high = (ax0 > ax1 ? ax0 : ax1) + (by0 > by1 ? by0 : by1) +
+                       triangle->c[i];
+        if (high < 0) {
+            return 0;
+        }
+        if (low >= 0) {
+            start[i] = 0;
+            step_x[i] = 0;
+            step_y[i] = 0;
+        } else {
+            start[i] = (int32_t)(ax0 + by0 + triangle->c[i]);
+            step_x[i] = triangle->a[i] * one;
+            step_y[i] = triangle->b[i] * one;
+        }
+    }
+
+    float row_varyings[SOFT_MAX_VARYINGS];
+
+    for (int y = y0; y <= y1; ++y) {
+        float dy = ((float)y + 0.5f) - triangle->origin[1];
+        for (int v = 0; v < triangle->varying_count; ++v) {
+            row_varyings[v] = triangle->planes[v][0] +
+                              triangle->planes[v][2] * dy;
+        }
+
+        int32_t e[3];
+        for (int i = 0; i < 3; ++i) {
+            e[i] = start[i] + (y - y0) * step_y[i];
+        }
+
+#ifdef __SSE2__
+        __m128i edge[3], step[3];
+        for (int i = 0; i < 3; ++i) {
+            edge[i] = _mm_add_epi32(_mm_set1_epi32(e[i]),
+                                    _mm_setr_epi32(0, step_x[i],
+                                                   2 * step_x[i],
+                                                   3 * step_x[i]));
+            step[i] = _mm_set1_epi32(4 * step_x[i]);
+        }
+#endif
+
+        for (int x = x0; x <= x1; x += 4) {
+            int valid = x1 - x >= 3 ? 0xF : (1 << (x1 - x + 1)) - 1;
+
+#ifdef __SSE2__
+            __m128i any = _mm_or_si128(edge[0], _mm_or_si128(edge[1],
+                                                             edge[2]));
+            int outside = _mm_movemask_ps(_mm_castsi128_ps(any));
+            for (int i = 0; i < 3; ++i) {
+                edge[i] = _mm_add_epi32(edge[i], step[i]);
+            }
+#else
+            int outside = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                int32_t any = (e[0] + lane * step_x[0]) |
+                              (e[1] + lane * step_x[1]) |
+                              (e[2] + lane * step_x[2]);
+                outside |= any < 0 ? 1 << lane : 0;
+            }
+            for (int i = 0; i < 3; ++i) {
+                e[i] += 4 * step_x[i];
+            }
+#endif
+
+            int mask = ~outside & valid;
+            if (mask) {
+                shade_soft_pixels(raster, triangle, row_varyings, x, y, mask);
+                result += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) +
+                          ((mask >> 3) & 1);
+            }
+        }
+    }
+
+    return result;
+}
+
+static void
+rasterize_soft_tiles(void *data, int begin, int end, int thread) {
+    SoftRasterizer *raster = data;
+
+    for (int tile = begin; tile < end; ++tile) {
+        SoftTileBin *bin = &raster->bins[tile];
+        int tile_x = tile % raster->tiles_x;
+        int tile_y = tile / raster->tiles_x;
+
+        for (int i = 0; i < bin->count; ++i) {
+            raster->thread_fragments[thread] +=
+                rasterize_soft_triangle(raster,
+                                        &raster->triangles[bin->triangles[i]],
+                                        tile_x, tile_y);
+        }
+    }
+}
+
+// Rasterizes everything drawn since the last flush. `jobs` may be 0 to do it
+// all on the calling thread.
+static void
+flush_soft_rasterizer(SoftRasterizer *raster, JobSystem *jobs) {
+    int tile_count = raster->tiles_x * raster->tiles_y;
+    memset(raster->thread_fragments, 0, sizeof(raster->thread_fragments));
+
+    if (jobs) {
+        run_parallel_for(jobs, tile_count, 1, rasterize_soft_tiles, raster);
+    } else {
+        rasterize_soft_tiles(raster, 0, tile_count, 0);
+    }
+
+    for (int i = 0; i < MAX_JOB_THREADS; ++i) {
+        raster->stats.fragments += raster->thread_fragments[i];
+    }
+    for (int i = 0; i < tile_count; ++i) {
+        raster->stats.bin_entries += raster->bins[i].count;
+        raster->bins[i].count = 0;
+    }
+    raster->triangle_count = 0;
+}
+
+//
+// Golden images
+//
+
+// Writes the color buffer as a binary PPM, top row first. Alpha is dropped.
+static bool
+save_soft_raster_ppm(SoftRasterizer *raster, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", raster->width, raster->height);
+    for (int y = raster->height - 1; y >= 0; --y) {
+        for (int x = 0; x < raster->width; ++x) {
+            uint32_t pixel = raster->color[(size_t)y * raster->width + x];
+            unsigned char rgb[3] = {
+                pixel & 0xFF, (pixel >> 8) & 0xFF, (pixel >> 16) & 0xFF,
+            };
+            fwrite(rgb, 1, 3, file);
+        }
+    }
+
+    bool result = !ferror(file);
+    fclose(file);
+    if (!result) {
+        printf("Failed to write %s\n", path);
+    }
+
+    return result;
+}
+
+typedef struct SoftImageDiff {
+    int mismatched_pixels;
+    int max_difference;
+} SoftImageDiff;
+
+// Compares the color buffer against a PPM written by save_soft_raster_ppm().
+// A pixel mismatches if any channel differs by more than `tolerance`.
+// Returns false if the file cannot be read or has a different size.
+static bool
+compare_soft_raster_ppm(SoftRasterizer *raster, const char *path,
+                        int tolerance, SoftImageDiff *diff) {
+    memset(diff, 0, sizeof(*diff));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+
+    int width, height, max_value;
+    if (fscanf(file, "P6 %d %d %d", &width, &height, &max_value) != 3 ||
+        fgetc(file) == EOF || max_value != 255) {
+        printf("Failed to read %s: not a binary 8-bit PPM\n", path);
+        fclose(file);
+        return false;
+    }
+    if (width != raster->width || height != raster->height) {
+        printf("Failed to compare with %s: it is %dx%d, not %dx%d\n", path,
+               width, height, raster->width, raster->height);
+        fclose(file);
+        return false;
+    }
+
+    size_t row_size = (size_t)width * 3;
+    unsigned char *row = heap_alloc(row_size);
+    bool result = true;
+    for (int y = height - 1; y >= 0 && result; --y) {
+        if (fread(row, 1, row_size, file) != row_size) {
+            printf("Failed to read %s: truncated\n", path);
+            result = false;
+            break;
+        }
+
+        for (int x = 0; x < width; ++x) {
+            uint32_t pixel = raster->color[(size_t)y * width + x];
+            int worst = 0;
+            for (int c = 0; c < 3; ++c) {
+                int d = (int)((pixel >> (c * 8)) & 0xFF) - row[x * 3 + c];
+                d = d < 0 ? -d : d;
+                worst = d > worst ? d : worst;
+            }
+            if (worst > tolerance) {
+                diff->mismatched_pixels++;
+            }
+            if (worst > diff->max_difference) {
+                diff->max_difference = worst;
+            }
+        }
+    }
+
+    heap_free(row);
+    fclose(file);
+
+    return result;
+}
+
+#endif
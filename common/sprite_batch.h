@@ -0,0 +1,387 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+// Batched textured quads.
+//
+// Sprites use the same vertex layout as the textures sample (position,
+// colour, texcoord) and are collected on the CPU between
+// begin_sprite_batch() and end_sprite_batch(). At the end they are sorted by
+// (layer, texture), written straight into a mapped vertex buffer and drawn
+// with one glDrawElementsBaseVertex per run of equal state, so the number of
+// draw calls is the number of texture changes, not the number of sprites.
+// Sprites drawn from a GL_TEXTURE_2D_ARRAY (for instance a TextureAtlas) with
+// draw_array_sprite() all share one texture, so a whole layer of them costs a
+// single draw call.
+//
+// The vertex buffer holds SPRITE_BATCH_FRAMES regions used round-robin, each
+// guarded by a fence, and is persistently mapped when ARB_buffer_storage is
+// available. Indices never change and are generated once.
+//
+// A batch that fills up mid-frame is flushed and starts over, so sprites past
+// the capacity still draw, but layers only sort within each flush and every
+// flush takes another buffer region.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+#include "common/shader.h"
+
+#define SPRITE_BATCH_FRAMES 3
+
+static char *SPRITE_VERTEX_SHADER = "                                         \
+#version 330 core                                                           \n\
+                                                                            \n\
+layout (location = 0)                                                       \n\
+in vec3 pos;                                                                \n\
+                                                                            \n\
+layout (location = 1)                                                       \n\
+in vec3 color;                                                              \n\
+                                                                            \n\
+// z is the array layer for GL_TEXTURE_2D_ARRAY sprites                     \n\
+layout (location = 2)                                                       \n\
+in vec3 texcoord;                                                           \n\
+                                                                            \n\
+out vec3 vertex_color;                                                      \n\
+out vec3 vertex_texcoord;                                                   \n\
+                                                                            \n\
+void main() {                                                               \n\
+    gl_Position = vec4(pos.xyz, 1.0);                                       \n\
+    vertex_color = color;                                                   \n\
+    vertex_texcoord = texcoord;                                             \n\
+}                                                                             \
+";
+
+static char *SPRITE_FRAGMENT_SHADER = "                                       \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2D sprite_texture;                                           \n\
+                                                                            \n\
+in vec3 vertex_color;                                                       \n\
+in vec3 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = texture(sprite_texture, vertex_texcoord.xy) *                   \n\
+            vec4(vertex_color, 1.0);                                        \n\
+}                                                                             \
+";
+
+static char *SPRITE_ARRAY_FRAGMENT_SHADER = "                                 \
+#version 330 core                                                           \n\
+                                                                            \n\
+uniform sampler2DArray sprite_texture;                                      \n\
+                                                                            \n\
+in vec3 vertex_color;                                                       \n\
+in vec3 vertex_texcoord;                                                    \n\
+                                                                            \n\
+out vec4 color;                                                             \n\
+                                                                            \n\
+void main() {                                                               \n\
+    color = texture(sprite_texture, vertex_texcoord) *                      \n\
+            vec4(vertex_color, 1.0);                                        \n\
+}                                                                             \
+";
+
+static const char *SPRITE_UNIFORM_NAMES[] = {
+    "sprite_texture",
+};
+
+typedef struct SpriteVertex {
+    GLfloat pos[3];
+    GLfloat color[3];
+    GLfloat texcoord[3];
+} SpriteVertex;
+
+typedef struct Sprite {
+    // Layer in the high 32 bits, texture in the low 32 bits.
+    uint64_t key;
+    // Submission order, so equal keys keep painter's order after sorting.
+    uint32_t order;
+    GLfloat x, y, width, height;
+    GLfloat u0, v0, u1, v1;
+    GLfloat color[3];
+    // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY; a texture name only ever has one
+    // target, so it is the same for every sprite with the same key.
+    GLenum target;
+    GLfloat array_layer;
+} Sprite;
+
+typedef struct SpriteBatchStats {
+    int sprites;
+    int draw_calls;
+    int stalls;
+    // Batches drawn early because the sprites did not fit.
+    int flushes;
+} SpriteBatchStats;
+
+typedef struct SpriteBatch {
+    Program program;
+    Program array_program;
+    GLuint vao, vbo, ebo;
+
+    int capacity;
+    Sprite *sprites;
+    int sprite_count;
+
+    SpriteVertex *mapped;
+    GLsync fences[SPRITE_BATCH_FRAMES];
+    // Counts flushes, not frames, so early flushes take their own region.
+    int frame;
+
+    SpriteBatchStats stats;
+} SpriteBatch;
+
+// `capacity` is the most sprites drawn in one flush; more than that in a
+// frame costs an early flush per `capacity` sprites.
+static bool
+init_sprite_batch(SpriteBatch *batch, int capacity) {
+    memset(batch, 0, sizeof(*batch));
+    batch->capacity = capacity;
+    batch->sprites = heap_alloc(capacity * sizeof(Sprite));
+
+    batch->program = create_program(SPRITE_VERTEX_SHADER,
+                                    SPRITE_FRAGMENT_SHADER,
+                                    SPRITE_UNIFORM_NAMES, 1);
+    batch->array_program = create_program(SPRITE_VERTEX_SHADER,
+                                          SPRITE_ARRAY_FRAGMENT_SHADER,
+                                          SPRITE_UNIFORM_NAMES, 1);
+    if (!batch->program.id || !batch->array_program.id) {
+        return false;
+    }
+
+    glGenVertexArrays(1, &batch->vao);
+    bind_vertex_array(batch->vao);
+
+    GLsizeiptr vbo_size = (GLsizeiptr)capacity * 4 * sizeof(SpriteVertex) *
+                          SPRITE_BATCH_FRAMES;
+    glGenBuffers(1, &batch->vbo);
+    bind_buffer(GL_ARRAY_BUFFER, batch->vbo);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                           GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, vbo_size, 0, flags);
+        batch->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, vbo_size, flags);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vbo_size, 0, GL_STREAM_DRAW);
+    }
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex),
+                          (GLvoid *)offsetof(SpriteVertex, pos));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex),
+                          (GLvoid *)offsetof(SpriteVertex, color));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex),
+                          (GLvoid *)offsetof(SpriteVertex, texcoord));
+    glEnableVertexAttribArray(2);
+
+    // Same winding as TEXTURES_INDICES, repeated for every sprite.
+    GLuint *indices = heap_alloc(capacity * 6 * sizeof(GLuint));
+    for (int i = 0; i < capacity; ++i) {
+        GLuint base = i * 4;
+        indices[i * 6 + 0] = base + 0;
+        indices[i * 6 + 1] = base + 1;
+        indices[i * 6 + 2] = base + 3;
+        indices[i * 6 + 3] = base + 1;
+        indices[i * 6 + 4] = base + 2;
+        indices[i * 6 + 5] = base + 3;
+    }
+    glGenBuffers(1, &batch->ebo);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, capacity * 6 * sizeof(GLuint),
+                 indices, GL_STATIC_DRAW);
+    heap_free(indices);
+
+    bind_vertex_array(0);
+    bind_buffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+static int
+compare_sprites(const void *a, const void *b) {
+    const Sprite *x = a;
+    const Sprite *y = b;
+
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static void
+write_sprite_vertices(Sprite *sprite, SpriteVertex *out) {
+    GLfloat x0 = sprite->x, x1 = sprite->x + sprite->width;
+    GLfloat y0 = sprite->y, y1 = sprite->y + sprite->height;
+
+    // Top Right, Bottom Right, Bottom Left, Top Left, as TEXTURES_VERTICES.
+    GLfloat corners[4][4] = {
+        {x1, y1, sprite->u1, sprite->v1},
+        {x1, y0, sprite->u1, sprite->v0},
+        {x0, y0, sprite->u0, sprite->v0},
+        {x0, y1, sprite->u0, sprite->v1},
+    };
+
+    for (int i = 0; i < 4; ++i) {
+        out[i].pos[0] = corners[i][0];
+        out[i].pos[1] = corners[i][1];
+        out[i].pos[2] = 0.0f;
+        out[i].color[0] = sprite->color[0];
+        out[i].color[1] = sprite->color[1];
+        out[i].color[2] = sprite->color[2];
+        out[i].texcoord[0] = corners[i][2];
+        out[i].texcoord[1] = corners[i][3];
+        out[i].texcoord[2] = sprite->array_layer;
+    }
+}
+
+// Sorts, uploads and draws the sprites pushed since the last flush, then
+// empties the batch.
+static void
+flush_sprite_batch(SpriteBatch *batch) {
+    int count = batch->sprite_count;
+    batch->stats.sprites += count;
+    batch->sprite_count = 0;
+    if (count == 0) {
+        return;
+    }
+
+    qsort(batch->sprites, count, sizeof(Sprite), compare_sprites);
+
+    int region = batch->frame++ % SPRITE_BATCH_FRAMES;
+    GLint first_vertex = region * batch->capacity * 4;
+
+    GLsync fence = batch->fences[region];
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            batch->stats.stalls++;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        glDeleteSync(fence);
+        batch->fences[region] = 0;
+    }
+
+    bind_buffer(GL_ARRAY_BUFFER, batch->vbo);
+    SpriteVertex *vertices;
+    if (batch->mapped) {
+        vertices = batch->mapped + first_vertex;
+    } else {
+        vertices = glMapBufferRange(GL_ARRAY_BUFFER,
+                                    first_vertex * sizeof(SpriteVertex),
+                                    count * 4 * sizeof(SpriteVertex),
+                                    GL_MAP_WRITE_BIT |
+                                    GL_MAP_INVALIDATE_RANGE_BIT |
+                                    GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+    for (int i = 0; i < count; ++i) {
+        write_sprite_vertices(&batch->sprites[i], vertices + i * 4);
+    }
+    if (!batch->mapped) {
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    bind_vertex_array(batch->vao);
+    active_texture(GL_TEXTURE0);
+
+    GLenum current_target = GL_NONE;
+
+    int run_start = 0;
+    for (int i = 1; i <= count; ++i) {
+        if (i < count &&
+            batch->sprites[i].key == batch->sprites[run_start].key) {
+            continue;
+        }
+
+        Sprite *first = &batch->sprites[run_start];
+        if (first->target != current_target) {
+            current_target = first->target;
+            use_program(current_target == GL_TEXTURE_2D_ARRAY ?
+                        batch->array_program.id : batch->program.id);
+        }
+
+        GLuint texture = (GLuint)(first->key & 0xFFFFFFFF);
+        bind_texture(current_target, texture);
+        glDrawElementsBaseVertex(GL_TRIANGLES, (i - run_start) * 6,
+                                 GL_UNSIGNED_INT,
+                                 (GLvoid *)(run_start * 6 * sizeof(GLuint)),
+                                 first_vertex);
+        batch->stats.draw_calls++;
+
+        run_start = i;
+    }
+
+    batch->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+static void
+begin_sprite_batch(SpriteBatch *batch) {
+    batch->sprite_count = 0;
+    memset(&batch->stats, 0, sizeof(batch->stats));
+}
+
+static void
+push_sprite(SpriteBatch *batch, GLuint texture, GLenum target,
+            GLfloat array_layer, uint32_t layer,
+            GLfloat x, GLfloat y, GLfloat width, GLfloat height,
+            GLfloat u0, GLfloat v0, GLfloat u1, GLfloat v1,
+            GLfloat r, GLfloat g, GLfloat b) {
+    if (batch->sprite_count == batch->capacity) {
+        flush_sprite_batch(batch);
+        batch->stats.flushes++;
+    }
+
+    Sprite *sprite = &batch->sprites[batch->sprite_count];
+    sprite->key = ((uint64_t)layer << 32) | texture;
+    sprite->order = batch->sprite_count++;
+    sprite->x = x;
+    sprite->y = y;
+    sprite->width = width;
+    sprite->height = height;
+    sprite->u0 = u0;
+    sprite->v0 = v0;
+    sprite->u1 = u1;
+    sprite->v1 = v1;
+    sprite->color[0] = r;
+    sprite->color[1] = g;
+    sprite->color[2] = b;
+    sprite->target = target;
+    sprite->array_layer = array_layer;
+}
+
+// (x, y) is the bottom-left corner in normalized device coordinates. `layer`
+// orders sprites: lower layers are drawn first.
+static void
+draw_sprite(SpriteBatch *batch, GLuint texture, uint32_t layer,
+            GLfloat x, GLfloat y, GLfloat width, GLfloat height,
+            GLfloat u0, GLfloat v0, GLfloat u1, GLfloat v1,
+            GLfloat r, GLfloat g, GLfloat b) {
+    push_sprite(batch, texture, GL_TEXTURE_2D, 0.0f, layer, x, y, width,
+                height, u0, v0, u1, v1, r, g, b);
+}
+
+// Like draw_sprite() but samples `array_layer` of a GL_TEXTURE_2D_ARRAY.
+static void
+draw_array_sprite(SpriteBatch *batch, GLuint texture_array,
+                  int array_layer, uint32_t layer,
+                  GLfloat x, GLfloat y, GLfloat width, GLfloat height,
+                  GLfloat u0, GLfloat v0, GLfloat u1, GLfloat v1,
+                  GLfloat r, GLfloat g, GLfloat b) {
+    push_sprite(batch, texture_array, GL_TEXTURE_2D_ARRAY,
+                (GLfloat)array_layer, layer, x, y, width, height,
+                u0, v0, u1, v1, r, g, b);
+}
+
+// Draws everything submitted since begin_sprite_batch() that an early flush
+// has not drawn yet. Leaves texture unit 0 active and the batch's VAO,
+// program and last texture bound, through gl_state.h.
+static void
+end_sprite_batch(SpriteBatch *batch) {
+    flush_sprite_batch(batch);
+}
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+// Ring-buffer allocator for data that changes every frame: vertices, indices
+// and uniform blocks all sub-allocated from one buffer.
+//
+//   begin_stream_frame(&stream);
+//   GLintptr offset;
+//   Vertex *v = allocate_stream_vertices(&stream, count, sizeof(Vertex),
+//                                        &offset);
+//   ... write count vertices ...
+//   commit_stream(&stream);
+//   glDrawElementsBaseVertex(..., offset / sizeof(Vertex));
+//   ...
+//   end_stream_frame(&stream);
+//
+// Allocations move a head pointer around the buffer and wrap back to the
+// start when one does not fit before the end. end_stream_frame() fences what
+// the frame allocated; the space is only reused once that fence has signaled,
+// so the CPU never writes over data the GPU may still read and no call
+// respecifies or orphans the buffer. An allocation waits for the oldest frame
+// only if the ring is full, which is counted as a stall.
+//
+// The buffer is persistently and coherently mapped when ARB_buffer_storage is
+// available, and commit_stream() does nothing. Otherwise each allocation maps
+// its range unsynchronized (the fences already make that safe) and
+// commit_stream() unmaps it, so call it before drawing either way.
+//
+// The same buffer can be bound to any target: GL_ARRAY_BUFFER for attributes,
+// GL_ELEMENT_ARRAY_BUFFER in a VAO and GL_UNIFORM_BUFFER ranges.
+
+#include "common/gl_state.h"
+
+#define DEFAULT_STREAM_BUFFER_SIZE (4 * 1024 * 1024)
+#define MAX_STREAM_BUFFER_FRAMES 8
+
+typedef struct StreamBufferFrame {
+    GLsync fence;
+    // Everything the frame took from the ring, padding included.
+    GLsizeiptr bytes;
+} StreamBufferFrame;
+
+typedef struct StreamBufferStats {
+    int allocations;
+    GLsizeiptr bytes_allocated;
+    // Bytes skipped at the end of the buffer by wrapping, and for alignment.
+    GLsizeiptr bytes_wasted;
+    int wraps;
+    // Allocations that had to wait for the GPU, and how long they waited.
+    int stalls;
+    double stall_ms;
+    // Allocations larger than the whole buffer.
+    int failures;
+    GLsizeiptr peak_in_use;
+} StreamBufferStats;
+
+typedef struct StreamBuffer {
+    GLuint buffer;
+    GLsizeiptr size;
+    unsigned char *memory;
+    bool mapped;
+    GLint uniform_alignment;
+
+    GLintptr head;
+    GLsizeiptr in_use;
+    GLsizeiptr frame_bytes;
+
+    // Fenced frames, oldest first.
+    StreamBufferFrame frames[MAX_STREAM_BUFFER_FRAMES];
+    int first_frame;
+    int frame_count;
+
+    StreamBufferStats stats;
+} StreamBuffer;
+
+static void
+init_stream_buffer(StreamBuffer *stream, GLsizeiptr size) {
+    memset(stream, 0, sizeof(*stream));
+    stream->size = size;
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,
+                  &stream->uniform_alignment);
+    if (stream->uniform_alignment < 1) {
+        stream->uniform_alignment = 256;
+    }
+
+    // Created through GL_COPY_WRITE_BUFFER so no VAO or draw binding is
+    // disturbed.
+    glGenBuffers(1, &stream->buffer);
+    bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                           GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, 0, flags);
+        stream->memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size,
+                                          flags);
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, 0, GL_STREAM_DRAW);
+    }
+}
+
+static void
+retire_stream_frame(StreamBuffer *stream, bool wait) {
+    StreamBufferFrame *frame = &stream->frames[stream->first_frame];
+
+    if (wait) {
+        if (glClientWaitSync(frame->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            glClientWaitSync(frame->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                             1000000000);
+            stream->stats.stalls++;
+            stream->stats.stall_ms +=
+                (SDL_GetPerformanceCounter() - start) * 1000.0 /
+                SDL_GetPerformanceFrequency();
+        }
+    }
+
+    glDeleteSync(frame->fence);
+    frame->fence = 0;
+    stream->in_use -= frame->bytes;
+    stream->first_frame = (stream->first_frame + 1) %
+                          MAX_STREAM_BUFFER_FRAMES;
+    stream->frame_count--;
+}
+
+// Releases frames the GPU has finished with, without blocking.
+static void
+begin_stream_frame(StreamBuffer *stream) {
+    while (stream->frame_count > 0) {
+        StreamBufferFrame *frame = &stream->frames[stream->first_frame];
+        if (glClientWaitSync(frame->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        retire_stream_frame(stream, false);
+    }
+}
+
+// Makes the last allocation visible to the GPU. Call before drawing from it.
+static void
+commit_stream(StreamBuffer *stream) {
+    if (stream->mapped) {
+        bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        stream->mapped = false;
+    }
+}
+
+// Returns a pointer to `size` writable bytes at a buffer offset that is a
+// multiple of `alignment` (any positive value), or 0 if `size` can never fit.
+static void *
+allocate_stream(StreamBuffer *stream, GLsizeiptr size, GLsizeiptr alignment,
+                GLintptr *offset) {
+    GLintptr start = (stream->head + alignment - 1) / alignment * alignment;
+    bool wrap = start + size > stream->size;
+    if (wrap) {
+        start = 0;
+    }
+    GLsizeiptr needed = wrap ? stream->size - stream->head + size :
+                               start + size - stream->head;
+
+    // The bytes in use end at head, so the new range only overlaps them if
+    // the total would exceed the buffer.
+    while (stream->in_use + needed > stream->size && stream->frame_count > 0) {
+        retire_stream_frame(stream, true);
+    }
+    if (stream->in_use + needed > stream->size) {
+        stream->stats.failures++;
+        return 0;
+    }
+
+    stream->head = start + size;
+    stream->in_use += needed;
+    stream->frame_bytes += needed;
+
+    stream->stats.allocations++;
+    stream->stats.bytes_allocated += size;
+    stream->stats.bytes_wasted += needed - size;
+    if (wrap) {
+        stream->stats.wraps++;
+    }
+    if (stream->in_use > stream->stats.peak_in_use) {
+        stream->stats.peak_in_use = stream->in_use;
+    }
+
+    *offset = start;
+    if (stream->memory) {
+        return stream->memory + start;
+    }
+
+    commit_stream(stream);
+    bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    stream->mapped = true;
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                            GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+// Aligned to the vertex size, so offset / vertex_size is a base vertex.
+static void *
+allocate_stream_vertices(StreamBuffer *stream, int count,
+                         GLsizeiptr vertex_size, GLintptr *offset) {
+    return allocate_stream(stream, count * vertex_size, vertex_size, offset);
+}
+
+static void *
+allocate_stream_indices(StreamBuffer *stream, int count,
+                        GLsizeiptr index_size, GLintptr *offset) {
+    return allocate_stream(stream, count * index_size, index_size, offset);
+}
+
+// Aligned for glBindBufferRange(GL_UNIFORM_BUFFER, ...).
+static void *
+allocate_stream_uniforms(StreamBuffer *stream, GLsizeiptr size,
+                         GLintptr *offset) {
+    return allocate_stream(stream, size, stream->uniform_alignment, offset);
+}
+
+// Call once per frame after the last draw that reads this frame's data.
+static void
+end_stream_frame(StreamBuffer *stream) {
+    commit_stream(stream);
+
+    if (stream->frame_count == MAX_STREAM_BUFFER_FRAMES) {
+        retire_stream_frame(stream, true);
+    }
+
+    int index = (stream->first_frame + stream->frame_count) %
+                MAX_STREAM_BUFFER_FRAMES;
+    stream->frames[index].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,
+                                              0);
+    stream->frames[index].bytes = stream->frame_bytes;
+    stream->frame_count++;
+    stream->frame_bytes = 0;
+}
+
+// Appends the statistics to a headless JSON report.
+static void
+print_stream_buffer_report(StreamBuffer *stream) {
+    StreamBufferStats *stats = &stream->stats;
+    printf(",\"stream_persistent\":%s,\"stream_size\":%ld,"
+           "\"stream_allocations\":%d,\"stream_bytes\":%ld,"
+           "\"stream_wasted_bytes\":%ld,\"stream_wraps\":%d,"
+           "\"stream_stalls\":%d,\"stream_stall_ms\":%.3f,"
+           "\"stream_failures\":%d,\"stream_peak_in_use\":%ld",
+           stream->memory ? "true" : "false", (long)stream->size,
+           stats->allocations, (long)stats->bytes_allocated,
+           (long)stats->bytes_wasted, stats->wraps, stats->stalls,
+           stats->stall_ms, stats->failures, (long)stats->peak_in_use);
+}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+// Texture atlas packed into the layers of one GL_TEXTURE_2D_ARRAY.
+//
+// Images are placed with a best-fit shelf packer: each layer is cut into
+// horizontal shelves, an image goes on the shelf whose height wastes the
+// least space, and a new shelf (or layer) is opened only when nothing fits.
+// Every image gets an ATLAS_GUTTER pixel border copied from its edges so
+// bilinear filtering never bleeds into a neighbour.
+//
+// add_atlas_image() returns a handle; get_atlas_region() maps it to a layer
+// and a UV rectangle, so a whole frame can sample every image from the single
+// bound array texture. The atlas has no mipmaps, which would blur across
+// neighbouring images.
+
+#include <SOIL/SOIL.h>
+
+#include "common/gl_state.h"
+#include "common/memory.h"
+
+#define MAX_ATLAS_LAYERS 8
+#define MAX_ATLAS_SHELVES 64
+#define MAX_ATLAS_REGIONS 256
+#define ATLAS_GUTTER 1
+
+typedef struct AtlasRegion {
+    int layer;
+    int x, y;
+    int width, height;
+    GLfloat u0, v0, u1, v1;
+} AtlasRegion;
+
+typedef struct AtlasShelf {
+    int y;
+    int height;
+    int used_width;
+} AtlasShelf;
+
+typedef struct TextureAtlas {
+    GLuint texture;
+    int size;
+    int layer_count;
+
+    AtlasShelf shelves[MAX_ATLAS_LAYERS][MAX_ATLAS_SHELVES];
+    int shelf_counts[MAX_ATLAS_LAYERS];
+
+    AtlasRegion regions[MAX_ATLAS_REGIONS];
+    int region_count;
+} TextureAtlas;
+
+// Allocates `layer_count` layers of size x size RGB texels up front.
+static void
+init_texture_atlas(TextureAtlas *atlas, int size, int layer_count) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->size = size;
+    atlas->layer_count = layer_count < MAX_ATLAS_LAYERS ? layer_count :
+                                                          MAX_ATLAS_LAYERS;
+
+    glGenTextures(1, &atlas->texture);
+    bind_texture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, size, size,
+                 atlas->layer_count, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Finds room for a padded w x h rectangle. Returns false if the atlas is
+// full.
+static bool
+pack_atlas_rect(TextureAtlas *atlas, int w, int h, int *layer, int *x,
+                int *y) {
+    // Best fit over existing shelves: least height wasted.
+    int best_layer = -1, best_shelf = -1;
+    int best_waste = atlas->size + 1;
+    for (int l = 0; l < atlas->layer_count; ++l) {
+        for (int s = 0; s < atlas->shelf_counts[l]; ++s) {
+            AtlasShelf *shelf = &atlas->shelves[l][s];
+            int waste = shelf->height - h;
+            if (waste >= 0 && waste < best_waste &&
+                atlas->size - shelf->used_width >= w) {
+                best_waste = waste;
+                best_layer = l;
+                best_shelf = s;
+            }
+        }
+    }
+
+    // Open a new shelf in the first layer with enough height left, unless an
+    // existing shelf fits snugly enough.
+    if (best_shelf < 0 || best_waste > h / 2) {
+        for (int l = 0; l < atlas->layer_count; ++l) {
+            int count = atlas->shelf_counts[l];
+            int top = 0;
+            if (count > 0) {
+                AtlasShelf *last = &atlas->shelves[l][count - 1];
+                top = last->y + last->height;
+            }
+            if (count < MAX_ATLAS_SHELVES && atlas->size - top >= h &&
+                w <= atlas->size) {
+                AtlasShelf *shelf = &atlas->shelves[l][count];
+                shelf->y = top;
+                shelf->height = h;
+                shelf->used_width = 0;
+                atlas->shelf_counts[l]++;
+                best_layer = l;
+                best_shelf = count;
+                break;
+            }
+        }
+    }
+
+    if (best_shelf < 0) {
+        return false;
+    }
+
+    AtlasShelf *shelf = &atlas->shelves[best_layer][best_shelf];
+    *layer = best_layer;
+    *x = shelf->used_width;
+    *y = shelf->y;
+    shelf->used_width += w;
+
+    return true;
+}
+
+// `pixels` is tightly packed RGB. Returns a handle for get_atlas_region(), or
+// -1 if the image does not fit.
+static int
+add_atlas_image(TextureAtlas *atlas, const unsigned char *pixels, int width,
+                int height) {
+    if (atlas->region_count == MAX_ATLAS_REGIONS) {
+        printf("Too many atlas images (max %d)\n", MAX_ATLAS_REGIONS);
+        return -1;
+    }
+
+    int padded_width = width + 2 * ATLAS_GUTTER;
+    int padded_height = height + 2 * ATLAS_GUTTER;
+
+    int layer, x, y;
+    if (!pack_atlas_rect(atlas, padded_width, padded_height, &layer, &x, &y)) {
+        printf("Texture atlas is full, cannot fit %dx%d\n", width, height);
+        return -1;
+    }
+
+    // Copy the image with its edge texels repeated into the gutter.
+    unsigned char *padded = heap_alloc(padded_width * padded_height * 3);
+    for (int py = 0; py < padded_height; ++py) {
+        int sy = py - ATLAS_GUTTER;
+        sy = sy < 0 ? 0 : sy >= height ? height - 1 : sy;
+        for (int px = 0; px < padded_width; ++px) {
+            int sx = px - ATLAS_GUTTER;
+            sx = sx < 0 ? 0 : sx >= width ? width - 1 : sx;
+            memcpy(padded + (py * padded_width + px) * 3,
+                   pixels + (sy * width + sx) * 3, 3);
+        }
+    }
+
+    bind_texture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, padded_width,
+                    padded_height, 1, GL_RGB, GL_UNSIGNED_BYTE, padded);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+    heap_free(padded);
+
+    int result = atlas->region_count++;
+    AtlasRegion *region = &atlas->regions[result];
+    region->layer = layer;
+    region->x = x + ATLAS_GUTTER;
+    region->y = y + ATLAS_GUTTER;
+    region->width = width;
+    region->height = height;
+    region->u0 = (GLfloat)region->x / atlas->size;
+    region->v0 = (GLfloat)region->y / atlas->size;
+    region->u1 = (GLfloat)(region->x + width) / atlas->size;
+    region->v1 = (GLfloat)(region->y + height) / atlas->size;
+
+    return result;
+}
+
+// Decodes an image file with SOIL and adds it. Returns -1 on failure.
+static int
+load_atlas_image(TextureAtlas *atlas, const char *path) {
+    int result = -1;
+
+    int image_width, image_height;
+    unsigned char *image = SOIL_load_image(path, &image_width, &image_height,
+                                           0, SOIL_LOAD_RGB);
+    if (image) {
+        result = add_atlas_image(atlas, image, image_width, image_height);
+        SOIL_free_image_data(image);
+    } else {
+        printf("Failed to load image %s: %s\n", path, SOIL_last_result());
+    }
+
+    return result;
+}
+
+static AtlasRegion *
+get_atlas_region(TextureAtlas *atlas, int handle) {
+    return &atlas->regions[handle];
+}
+
+// Occupancy is image texels over layer texels. Fragmentation is the share of
+// space already claimed by shelves that no image uses (shelf height above
+// shorter images plus gutters), i.e. space the packer cannot hand out again.
+static void
+print_texture_atlas_report(TextureAtlas *atlas) {
+    long layer_area = (long)atlas->size * atlas->size;
+
+    for (int l = 0; l < atlas->layer_count; ++l) {
+        long image_area = 0;
+        for (int i = 0; i < atlas->region_count; ++i) {
+            AtlasRegion *region = &atlas->regions[i];
+            if (region->layer == l) {
+                image_area += (long)region->width * region->height;
+            }
+        }
+
+        long shelf_area = 0;
+        long top = 0;
+        for (int s = 0; s < atlas->shelf_counts[l]; ++s) {
+            AtlasShelf *shelf = &atlas->shelves[l][s];
+            shelf_area += (long)shelf->used_width * shelf->height;
+            top = shelf->y + shelf->height;
+        }
+
+        if (atlas->shelf_counts[l] == 0) {
+            continue;
+        }
+
+        fprintf(stderr,
+                "Atlas layer %d: %d shelves, occupancy %.1f%%, "
+                "fragmentation %.1f%%, free below shelves %.1f%%\n",
+                l, atlas->shelf_counts[l],
+                100.0 * image_area / layer_area,
+                shelf_area ? 100.0 * (shelf_area - image_area) / shelf_area :
+                             0.0,
+                100.0 * (atlas->size - top) * atlas->size / layer_area);
+    }
+}
+
+#endif
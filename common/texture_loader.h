@@ -0,0 +1,532 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+// Asynchronous texture loading.
+//
+// request_streamed_texture() only records the path; a pool of worker threads
+// decodes the image with SOIL off the GL thread. Once a frame,
+// update_texture_loader() copies decoded rows into a pixel unpack buffer and
+// uploads them with glTexSubImage2D, never more than upload_budget bytes per
+// frame, so a large image is spread across several frames instead of
+// stalling one. Until a texture is complete get_streamed_texture() returns a
+// 1x1 placeholder.
+//
+// request_streamed_texture_array() streams one image per layer of a
+// GL_TEXTURE_2D_ARRAY the same way, so a whole scene can sample from one
+// bound texture. Its mip chain is generated once the last layer is in, and
+// get_streamed_texture_array() returns a 1x1 placeholder array until then,
+// or for good if any layer fails.
+//
+// If a baked .ctex sits next to the requested image (see
+// common/compressed_texture.h) it is mapped and uploaded on the spot instead,
+// skipping decode entirely. An array only takes the baked path if every one
+// of its layers has been baked.
+//
+// The unpack buffer is split into TEXTURE_UPLOAD_FRAMES segments, each
+// guarded by a fence, and is persistently mapped when ARB_buffer_storage is
+// available.
+//
+// shutdown_texture_loader() stops and joins the workers and releases every
+// texture the loader created.
+
+#include <SOIL/SOIL.h>
+
+#include "common/compressed_texture.h"
+
+#define MAX_STREAMED_TEXTURES 64
+#define MAX_STREAMED_TEXTURE_ARRAYS 8
+#define MAX_TEXTURE_DECODE_WORKERS 4
+#define TEXTURE_UPLOAD_FRAMES 3
+#define DEFAULT_TEXTURE_UPLOAD_BUDGET (1024 * 1024)
+
+typedef enum StreamedTextureState {
+    STREAMED_TEXTURE_QUEUED,
+    STREAMED_TEXTURE_DECODING,
+    STREAMED_TEXTURE_DECODED,
+    STREAMED_TEXTURE_READY,
+    STREAMED_TEXTURE_FAILED,
+} StreamedTextureState;
+
+// Owned by the GL thread. The layers are StreamedTextures of their own.
+typedef struct StreamedTextureArray {
+    GLuint id;
+    int layer_count;
+    int ready_layers;
+    // Taken from the first layer to finish decoding.
+    int width;
+    int height;
+} StreamedTextureArray;
+
+typedef struct StreamedTexture {
+    char path[256];
+    SDL_atomic_t state;
+
+    // Written by the decode worker before state becomes DECODED.
+    unsigned char *pixels;
+    int width;
+    int height;
+
+    // Owned by the GL thread. A layer of an array leaves id at 0 and uploads
+    // into array->id.
+    GLuint id;
+    int uploaded_rows;
+    StreamedTextureArray *array;
+    int layer;
+} StreamedTexture;
+
+typedef struct TextureLoader {
+    StreamedTexture textures[MAX_STREAMED_TEXTURES];
+    int texture_count;
+
+    StreamedTextureArray arrays[MAX_STREAMED_TEXTURE_ARRAYS];
+    int array_count;
+
+    SDL_Thread *workers[MAX_TEXTURE_DECODE_WORKERS];
+    int worker_count;
+    SDL_sem *pending;
+    SDL_atomic_t next_to_decode;
+    SDL_atomic_t quit;
+
+    GLuint placeholder;
+    GLuint placeholder_array;
+
+    GLuint pbo;
+    unsigned char *pbo_memory;
+    int upload_budget;
+    GLsync fences[TEXTURE_UPLOAD_FRAMES];
+    int frame;
+
+    size_t uploaded_bytes;
+} TextureLoader;
+
+static int
+texture_decode_worker(void *data) {
+    TextureLoader *loader = data;
+
+    for (;;) {
+        SDL_SemWait(loader->pending);
+        if (SDL_AtomicGet(&loader->quit)) {
+            break;
+        }
+
+        int index = SDL_AtomicAdd(&loader->next_to_decode, 1);
+        StreamedTexture *texture = &loader->textures[index];
+
+        // Baked textures are already READY by the time we get here.
+        if (!SDL_AtomicCAS(&texture->state, STREAMED_TEXTURE_QUEUED,
+                           STREAMED_TEXTURE_DECODING)) {
+            continue;
+        }
+
+        texture->pixels = SOIL_load_image(texture->path,
+                                          &texture->width,
+                                          &texture->height,
+                                          0, SOIL_LOAD_RGB);
+        if (!texture->pixels) {
+            printf("Failed to load image %s: %s\n", texture->path,
+                   SOIL_last_result());
+        }
+
+        SDL_AtomicSet(&texture->state, texture->pixels ?
+                                       STREAMED_TEXTURE_DECODED :
+                                       STREAMED_TEXTURE_FAILED);
+    }
+
+    return 0;
+}
+
+static void
+init_texture_loader(TextureLoader *loader, int upload_budget) {
+    memset(loader, 0, sizeof(*loader));
+    loader->upload_budget = upload_budget;
+    loader->pending = SDL_CreateSemaphore(0);
+
+    // Leave a core for the GL thread.
+    int worker_count = SDL_GetCPUCount() - 1;
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    if (worker_count > MAX_TEXTURE_DECODE_WORKERS) {
+        worker_count = MAX_TEXTURE_DECODE_WORKERS;
+    }
+    for (int i = 0; i < worker_count; ++i) {
+        loader->workers[i] = SDL_CreateThread(texture_decode_worker,
+                                              "TextureDecode", loader);
+    }
+    loader->worker_count = worker_count;
+
+    GLubyte grey[3] = {128, 128, 128};
+    glGenTextures(1, &loader->placeholder);
+    bind_texture(GL_TEXTURE_2D, loader->placeholder);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                 grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    bind_texture(GL_TEXTURE_2D, 0);
+
+    glGenTextures(1, &loader->placeholder_array);
+    bind_texture(GL_TEXTURE_2D_ARRAY, loader->placeholder_array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, 1, 1, 1, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    GLsizeiptr pbo_size = (GLsizeiptr)upload_budget * TEXTURE_UPLOAD_FRAMES;
+    glGenBuffers(1, &loader->pbo);
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, loader->pbo);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                           GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, pbo_size, 0, flags);
+        loader->pbo_memory = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                              pbo_size, flags);
+    } else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo_size, 0, GL_STREAM_DRAW);
+    }
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Call on the GL thread. Waits for any image being decoded to finish; queued
+// ones are dropped.
+static void
+shutdown_texture_loader(TextureLoader *loader) {
+    SDL_AtomicSet(&loader->quit, 1);
+    for (int i = 0; i < loader->worker_count; ++i) {
+        SDL_SemPost(loader->pending);
+    }
+    for (int i = 0; i < loader->worker_count; ++i) {
+        SDL_WaitThread(loader->workers[i], 0);
+    }
+    SDL_DestroySemaphore(loader->pending);
+
+    for (int i = 0; i < loader->texture_count; ++i) {
+        StreamedTexture *texture = &loader->textures[i];
+        if (texture->pixels) {
+            SOIL_free_image_data(texture->pixels);
+            texture->pixels = 0;
+        }
+        delete_textures(1, &texture->id);
+    }
+    for (int i = 0; i < loader->array_count; ++i) {
+        delete_textures(1, &loader->arrays[i].id);
+    }
+    delete_textures(1, &loader->placeholder);
+    delete_textures(1, &loader->placeholder_array);
+
+    for (int i = 0; i < TEXTURE_UPLOAD_FRAMES; ++i) {
+        if (loader->fences[i]) {
+            glDeleteSync(loader->fences[i]);
+        }
+    }
+
+    if (loader->pbo_memory) {
+        bind_buffer(GL_PIXEL_UNPACK_BUFFER, loader->pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    delete_buffers(1, &loader->pbo);
+
+    memset(loader, 0, sizeof(*loader));
+}
+
+// Writes the path of the .ctex baked from `path`. Returns false if `path`
+// has no extension or the result does not fit.
+static bool
+get_baked_texture_path(const char *path, char *result, size_t size) {
+    snprintf(result, size, "%s", path);
+    char *extension = strrchr(result, '.');
+    if (extension && (size_t)(extension - result) + 6 <= size) {
+        strcpy(extension, ".ctex");
+        return true;
+    }
+
+    return false;
+}
+
+// Returns a handle for get_streamed_texture(), or -1 if the loader is full.
+static int
+request_streamed_texture(TextureLoader *loader, const char *path) {
+    if (loader->texture_count == MAX_STREAMED_TEXTURES) {
+        printf("Too many streamed textures (max %d)\n", MAX_STREAMED_TEXTURES);
+        return -1;
+    }
+
+    int result = loader->texture_count++;
+    StreamedTexture *texture = &loader->textures[result];
+    snprintf(texture->path, sizeof(texture->path), "%s", path);
+
+    char baked_path[sizeof(texture->path)];
+    if (get_baked_texture_path(path, baked_path, sizeof(baked_path))) {
+        texture->id = load_compressed_texture(baked_path);
+    }
+
+    SDL_AtomicSet(&texture->state, texture->id ? STREAMED_TEXTURE_READY :
+                                                 STREAMED_TEXTURE_QUEUED);
+
+    SDL_SemPost(loader->pending);
+
+    return result;
+}
+
+static GLuint
+get_streamed_texture(TextureLoader *loader, int handle) {
+    GLuint result = loader->placeholder;
+
+    if (handle >= 0 && handle < loader->texture_count) {
+        StreamedTexture *texture = &loader->textures[handle];
+        if (SDL_AtomicGet(&texture->state) == STREAMED_TEXTURE_READY) {
+            result = texture->id;
+        }
+    }
+
+    return result;
+}
+
+// Sets the filtering of a complete array: trilinear, wrapping with
+// GL_REPEAT.
+static void
+set_streamed_texture_array_filter(GLuint id) {
+    bind_texture(GL_TEXTURE_2D_ARRAY, id);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// `paths` are the layers in order, all the same size. Returns a handle for
+// get_streamed_texture_array(), or -1 if the loader is full.
+static int
+request_streamed_texture_array(TextureLoader *loader, const char **paths,
+                               int count) {
+    if (loader->array_count == MAX_STREAMED_TEXTURE_ARRAYS ||
+        loader->texture_count + count > MAX_STREAMED_TEXTURES) {
+        printf("Too many streamed textures (max %d arrays, %d textures)\n",
+               MAX_STREAMED_TEXTURE_ARRAYS, MAX_STREAMED_TEXTURES);
+        return -1;
+    }
+    if (count < 1 || count > COMPRESSED_TEXTURE_MAX_LAYERS) {
+        printf("Cannot stream a texture array of %d layers (max %d)\n", count,
+               COMPRESSED_TEXTURE_MAX_LAYERS);
+        return -1;
+    }
+
+    int result = loader->array_count++;
+    StreamedTextureArray *array = &loader->arrays[result];
+    array->layer_count = count;
+
+    char baked_paths[COMPRESSED_TEXTURE_MAX_LAYERS][256];
+    const char *baked[COMPRESSED_TEXTURE_MAX_LAYERS];
+    bool all_baked = true;
+    for (int i = 0; i < count; ++i) {
+        baked[i] = baked_paths[i];
+        all_baked = all_baked && get_baked_texture_path(paths[i],
+                                                        baked_paths[i],
+                                                        sizeof(baked_paths[i]));
+    }
+    if (all_baked) {
+        array->id = load_compressed_texture_array(baked, count);
+    }
+    if (array->id) {
+        array->ready_layers = count;
+        set_streamed_texture_array_filter(array->id);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        StreamedTexture *texture = &loader->textures[loader->texture_count++];
+        snprintf(texture->path, sizeof(texture->path), "%s", paths[i]);
+        texture->array = array;
+        texture->layer = i;
+
+        SDL_AtomicSet(&texture->state, array->id ? STREAMED_TEXTURE_READY :
+                                                   STREAMED_TEXTURE_QUEUED);
+
+        SDL_SemPost(loader->pending);
+    }
+
+    return result;
+}
+
+static GLuint
+get_streamed_texture_array(TextureLoader *loader, int handle) {
+    GLuint result = loader->placeholder_array;
+
+    if (handle >= 0 && handle < loader->array_count) {
+        StreamedTextureArray *array = &loader->arrays[handle];
+        if (array->ready_layers == array->layer_count) {
+            result = array->id;
+        }
+    }
+
+    return result;
+}
+
+// Allocates the texture, or the array, a decoded image is uploaded into.
+// Call with no unpack buffer bound: the null data pointer would otherwise be
+// read as an offset into it. Returns false, and fails the texture, if the
+// image cannot be streamed.
+static bool
+prepare_streamed_texture(TextureLoader *loader, StreamedTexture *texture) {
+    StreamedTextureArray *array = texture->array;
+
+    const char *error = 0;
+    if ((size_t)texture->width * 3 > (size_t)loader->upload_budget) {
+        error = "is too wide for the upload budget";
+    } else if (array && array->id && (array->width != texture->width ||
+                                      array->height != texture->height)) {
+        error = "is not the size of the other layers";
+    }
+
+    if (error) {
+        printf("Image %s %s\n", texture->path, error);
+        SOIL_free_image_data(texture->pixels);
+        texture->pixels = 0;
+        SDL_AtomicSet(&texture->state, STREAMED_TEXTURE_FAILED);
+        return false;
+    }
+
+    if (array && !array->id) {
+        array->width = texture->width;
+        array->height = texture->height;
+        glGenTextures(1, &array->id);
+        bind_texture(GL_TEXTURE_2D_ARRAY, array->id);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, array->width,
+                     array->height, array->layer_count, 0, GL_RGB,
+                     GL_UNSIGNED_BYTE, 0);
+        set_streamed_texture_array_filter(array->id);
+    } else if (!array && !texture->id) {
+        glGenTextures(1, &texture->id);
+        bind_texture(GL_TEXTURE_2D, texture->id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texture->width,
+                     texture->height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    }
+
+    return true;
+}
+
+typedef struct TextureUpload {
+    StreamedTexture *texture;
+    int first_row;
+    int row_count;
+    size_t offset;
+} TextureUpload;
+
+// Call once per frame on the GL thread. Leaves GL_PIXEL_UNPACK_BUFFER
+// unbound so later uploads from client memory still work.
+static void
+update_texture_loader(TextureLoader *loader) {
+    TextureUpload uploads[MAX_STREAMED_TEXTURES];
+    int upload_count = 0;
+    size_t used = 0;
+
+    // Pick this frame's rows, and allocate storage for new textures, before
+    // the unpack buffer is bound. Offsets are from the start of the segment.
+    for (int i = 0; i < loader->texture_count; ++i) {
+        StreamedTexture *texture = &loader->textures[i];
+        if (SDL_AtomicGet(&texture->state) != STREAMED_TEXTURE_DECODED ||
+            !prepare_streamed_texture(loader, texture)) {
+            continue;
+        }
+
+        size_t row_size = (size_t)texture->width * 3;
+        int row_count = (int)((loader->upload_budget - used) / row_size);
+        if (row_count > texture->height - texture->uploaded_rows) {
+            row_count = texture->height - texture->uploaded_rows;
+        }
+        if (row_count == 0) {
+            break;
+        }
+
+        TextureUpload *upload = &uploads[upload_count++];
+        upload->texture = texture;
+        upload->first_row = texture->uploaded_rows;
+        upload->row_count = row_count;
+        upload->offset = used;
+
+        texture->uploaded_rows += row_count;
+        used += row_count * row_size;
+    }
+
+    if (upload_count == 0) {
+        return;
+    }
+
+    int segment = loader->frame++ % TEXTURE_UPLOAD_FRAMES;
+    size_t segment_offset = (size_t)segment * loader->upload_budget;
+
+    // Wait until the GPU has consumed what this segment held
+    // TEXTURE_UPLOAD_FRAMES frames ago.
+    GLsync fence = loader->fences[segment];
+    if (fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fence);
+        loader->fences[segment] = 0;
+    }
+
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, loader->pbo);
+    unsigned char *dest;
+    if (loader->pbo_memory) {
+        dest = loader->pbo_memory + segment_offset;
+    } else {
+        dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, segment_offset,
+                                loader->upload_budget,
+                                GL_MAP_WRITE_BIT |
+                                GL_MAP_INVALIDATE_RANGE_BIT |
+                                GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    for (int i = 0; i < upload_count; ++i) {
+        TextureUpload *upload = &uploads[i];
+        size_t row_size = (size_t)upload->texture->width * 3;
+        memcpy(dest + upload->offset,
+               upload->texture->pixels + upload->first_row * row_size,
+               upload->row_count * row_size);
+    }
+
+    if (!loader->pbo_memory) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < upload_count; ++i) {
+        TextureUpload *upload = &uploads[i];
+        StreamedTexture *texture = upload->texture;
+        StreamedTextureArray *array = texture->array;
+        GLvoid *offset = (GLvoid *)(segment_offset + upload->offset);
+
+        if (array) {
+            bind_texture(GL_TEXTURE_2D_ARRAY, array->id);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, upload->first_row,
+                            texture->layer, texture->width, upload->row_count,
+                            1, GL_RGB, GL_UNSIGNED_BYTE, offset);
+        } else {
+            bind_texture(GL_TEXTURE_2D, texture->id);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, upload->first_row,
+                            texture->width, upload->row_count, GL_RGB,
+                            GL_UNSIGNED_BYTE, offset);
+        }
+
+        if (texture->uploaded_rows == texture->height) {
+            SOIL_free_image_data(texture->pixels);
+            texture->pixels = 0;
+            SDL_AtomicSet(&texture->state, STREAMED_TEXTURE_READY);
+
+            // An array's mip chain waits for its last layer.
+            if (!array) {
+                glGenerateMipmap(GL_TEXTURE_2D);
+            } else if (++array->ready_layers == array->layer_count) {
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            }
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    loader->fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    loader->uploaded_bytes += used;
+
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+#endif
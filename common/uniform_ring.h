@@ -0,0 +1,129 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+// Ring-buffered uniform buffer for per-frame and per-draw block data.
+//
+// One GL_UNIFORM_BUFFER is split into UNIFORM_RING_FRAMES segments, each
+// guarded by a fence like the texture loader's unpack buffer. Within a frame
+// push_uniforms() copies a block into the current segment at the next offset
+// that satisfies GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, and bind_uniforms()
+// points a block's binding at it with glBindBufferRange. Data shared by every
+// program (camera, time) is pushed and bound once per frame; per-draw data is
+// pushed once per draw, with no buffer respecification in between.
+//
+// The buffer is persistently mapped when ARB_buffer_storage is available,
+// otherwise each push maps its range unsynchronized, which is safe because
+// the fence already guarantees the GPU is done with the segment.
+
+#include "common/shader.h"
+
+#define UNIFORM_RING_FRAMES 3
+#define DEFAULT_UNIFORM_RING_FRAME_SIZE (64 * 1024)
+
+typedef struct UniformRing {
+    GLuint buffer;
+    GLsizeiptr frame_size;
+    GLint alignment;
+    unsigned char *memory;
+
+    GLsync fences[UNIFORM_RING_FRAMES];
+    int frame;
+    GLintptr segment_offset;
+    GLsizeiptr used;
+
+    // Pushes that did not fit in the current segment.
+    int overflows;
+    GLsizeiptr peak_used;
+} UniformRing;
+
+static void
+init_uniform_ring(UniformRing *ring, GLsizeiptr frame_size) {
+    memset(ring, 0, sizeof(*ring));
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring->alignment);
+    if (ring->alignment < 1) {
+        ring->alignment = 256;
+    }
+    ring->frame_size = (frame_size + ring->alignment - 1) /
+                       ring->alignment * ring->alignment;
+
+    GLsizeiptr size = ring->frame_size * UNIFORM_RING_FRAMES;
+    glGenBuffers(1, &ring->buffer);
+    bind_buffer(GL_UNIFORM_BUFFER, ring->buffer);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                           GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, 0, flags);
+        ring->memory = glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, size, 0, GL_STREAM_DRAW);
+    }
+}
+
+// Call once per frame before the first push. Blocks only if the GPU is still
+// reading the segment from UNIFORM_RING_FRAMES frames ago.
+static void
+begin_uniform_ring_frame(UniformRing *ring) {
+    int segment = ring->frame % UNIFORM_RING_FRAMES;
+
+    GLsync fence = ring->fences[segment];
+    if (fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fence);
+        ring->fences[segment] = 0;
+    }
+
+    ring->segment_offset = (GLintptr)segment * ring->frame_size;
+    ring->used = 0;
+}
+
+// Returns the buffer offset of the copy, or -1 if the segment is full.
+static GLintptr
+push_uniforms(UniformRing *ring, const void *data, GLsizeiptr size) {
+    GLsizeiptr aligned = (ring->used + ring->alignment - 1) /
+                         ring->alignment * ring->alignment;
+    if (aligned + size > ring->frame_size) {
+        ring->overflows++;
+        return -1;
+    }
+
+    GLintptr result = ring->segment_offset + aligned;
+    if (ring->memory) {
+        memcpy(ring->memory + result, data, size);
+    } else {
+        bind_buffer(GL_UNIFORM_BUFFER, ring->buffer);
+        void *dest = glMapBufferRange(GL_UNIFORM_BUFFER, result, size,
+                                      GL_MAP_WRITE_BIT |
+                                      GL_MAP_INVALIDATE_RANGE_BIT |
+                                      GL_MAP_UNSYNCHRONIZED_BIT);
+        memcpy(dest, data, size);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+
+    ring->used = aligned + size;
+    if (ring->used > ring->peak_used) {
+        ring->peak_used = ring->used;
+    }
+
+    return result;
+}
+
+// Binds `size` bytes at `offset` (from push_uniforms()) to the block's shared
+// binding point. Does nothing if the push failed.
+static void
+bind_uniforms(UniformRing *ring, UniformBlockLayout *block, GLintptr offset,
+              GLsizeiptr size) {
+    if (block && offset >= 0) {
+        bind_buffer_range(GL_UNIFORM_BUFFER, block->binding, ring->buffer,
+                          offset, size);
+    }
+}
+
+// Call once per frame after the last draw that reads this frame's data.
+static void
+end_uniform_ring_frame(UniformRing *ring) {
+    int segment = ring->frame++ % UNIFORM_RING_FRAMES;
+    ring->fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+#endif
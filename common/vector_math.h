@@ -0,0 +1,669 @@
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+// Vectors, matrices, quaternions and frustum tests for CPU-side transform
+// and culling work.
+//
+// Matrices are column-major like GL's, so a Mat4 goes to glUniformMatrix4fv
+// with transpose GL_FALSE, and vectors are columns: mat4_multiply(a, b)
+// applies b first.
+//
+// The single-value functions are plain scalar C. The batch functions work on
+// structure-of-arrays data (separate x, y, z, ... arrays) and come in scalar,
+// SSE and AVX2 versions. The widest version the CPU supports is picked at
+// runtime, so the default build needs no -mavx2. Every version does the same
+// operations in the same order, so they return identical results, which
+// benchmarks/vector_math.c checks. set_simd_level() forces a narrower one.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_MATH_X86
+#include <immintrin.h>
+#endif
+
+typedef struct Vec3 {
+    float x, y, z;
+} Vec3;
+
+typedef struct Vec4 {
+    float x, y, z, w;
+} Vec4;
+
+typedef struct Quat {
+    float x, y, z, w;
+} Quat;
+
+// m[column * 4 + row].
+typedef struct Mat4 {
+    float m[16];
+} Mat4;
+
+// Plane (a, b, c, d) holds points where a x + b y + c z + d >= 0, with
+// (a, b, c) unit length. Left, right, bottom, top, near, far.
+typedef struct Frustum {
+    Vec4 planes[6];
+} Frustum;
+
+//
+// Vectors
+//
+
+static Vec3
+vec3(float x, float y, float z) {
+    Vec3 result = {x, y, z};
+    return result;
+}
+
+static Vec3
+vec3_add(Vec3 a, Vec3 b) {
+    return vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+static Vec3
+vec3_sub(Vec3 a, Vec3 b) {
+    return vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static Vec3
+vec3_scale(Vec3 v, float s) {
+    return vec3(v.x * s, v.y * s, v.z * s);
+}
+
+static float
+vec3_dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Vec3
+vec3_cross(Vec3 a, Vec3 b) {
+    return vec3(a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x);
+}
+
+static float
+vec3_length(Vec3 v) {
+    return sqrtf(vec3_dot(v, v));
+}
+
+// Returns v unchanged if it has no length.
+static Vec3
+vec3_normalize(Vec3 v) {
+    float length = vec3_length(v);
+    return length > 0.0f ? vec3_scale(v, 1.0f / length) : v;
+}
+
+static Vec4
+vec4(float x, float y, float z, float w) {
+    Vec4 result = {x, y, z, w};
+    return result;
+}
+
+static Vec4
+vec4_add(Vec4 a, Vec4 b) {
+    return vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+}
+
+static Vec4
+vec4_scale(Vec4 v, float s) {
+    return vec4(v.x * s, v.y * s, v.z * s, v.w * s);
+}
+
+static float
+vec4_dot(Vec4 a, Vec4 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+//
+// Matrices
+//
+
+static Mat4
+mat4_identity(void) {
+    Mat4 result = {{
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1,
+    }};
+    return result;
+}
+
+static Mat4
+mat4_multiply(Mat4 a, Mat4 b) {
+    Mat4 result;
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            result.m[column * 4 + row] =
+                a.m[0 * 4 + row] * b.m[column * 4 + 0] +
+                a.m[1 * 4 + row] * b.m[column * 4 + 1] +
+                a.m[2 * 4 + row] * b.m[column * 4 + 2] +
+                a.m[3 * 4 + row] * b.m[column * 4 + 3];
+        }
+    }
+    return result;
+}
+
+static Vec4
+mat4_transform(Mat4 m, Vec4 v) {
+    return vec4(m.m[0] * v.x + m.m[4] * v.y + m.m[8] * v.z + m.m[12] * v.w,
+                m.m[1] * v.x + m.m[5] * v.y + m.m[9] * v.z + m.m[13] * v.w,
+                m.m[2] * v.x + m.m[6] * v.y + m.m[10] * v.z + m.m[14] * v.w,
+                m.m[3] * v.x + m.m[7] * v.y + m.m[11] * v.z + m.m[15] * v.w);
+}
+
+static Mat4
+mat4_translate(Vec3 offset) {
+    Mat4 result = mat4_identity();
+    result.m[12] = offset.x;
+    result.m[13] = offset.y;
+    result.m[14] = offset.z;
+    return result;
+}
+
+static Mat4
+mat4_scale(Vec3 scale) {
+    Mat4 result = mat4_identity();
+    result.m[0] = scale.x;
+    result.m[5] = scale.y;
+    result.m[10] = scale.z;
+    return result;
+}
+
+// Right-handed rotation by `angle` radians about `axis`.
+static Mat4
+mat4_rotate(Vec3 axis, float angle) {
+    Vec3 a = vec3_normalize(axis);
+    float c = cosf(angle);
+    float s = sinf(angle);
+    float t = 1.0f - c;
+
+    Mat4 result = mat4_identity();
+    result.m[0] = t * a.x * a.x + c;
+    result.m[1] = t * a.x * a.y + s * a.z;
+    result.m[2] = t * a.x * a.z - s * a.y;
+    result.m[4] = t * a.x * a.y - s * a.z;
+    result.m[5] = t * a.y * a.y + c;
+    result.m[6] = t * a.y * a.z + s * a.x;
+    result.m[8] = t * a.x * a.z + s * a.y;
+    result.m[9] = t * a.y * a.z - s * a.x;
+    result.m[10] = t * a.z * a.z + c;
+    return result;
+}
+
+// Like gluPerspective: `fov_y` in radians, depth mapped to [-1, 1].
+static Mat4
+mat4_perspective(float fov_y, float aspect, float near, float far) {
+    float f = 1.0f / tanf(fov_y * 0.5f);
+
+    Mat4 result = {{0}};
+    result.m[0] = f / aspect;
+    result.m[5] = f;
+    result.m[10] = (far + near) / (near - far);
+    result.m[11] = -1.0f;
+    result.m[14] = 2.0f * far * near / (near - far);
+    return result;
+}
+
+// Like glOrtho.
+static Mat4
+mat4_ortho(float left, float right, float bottom, float top, float near,
+           float far) {
+    Mat4 result = mat4_identity();
+    result.m[0] = 2.0f / (right - left);
+    result.m[5] = 2.0f / (top - bottom);
+    result.m[10] = -2.0f / (far - near);
+    result.m[12] = -(right + left) / (right - left);
+    result.m[13] = -(top + bottom) / (top - bottom);
+    result.m[14] = -(far + near) / (far - near);
+    return result;
+}
+
+// Like gluLookAt.
+static Mat4
+mat4_look_at(Vec3 eye, Vec3 target, Vec3 up) {
+    Vec3 f = vec3_normalize(vec3_sub(target, eye));
+    Vec3 s = vec3_normalize(vec3_cross(f, up));
+    Vec3 u = vec3_cross(s, f);
+
+    Mat4 result = mat4_identity();
+    result.m[0] = s.x;
+    result.m[4] = s.y;
+    result.m[8] = s.z;
+    result.m[1] = u.x;
+    result.m[5] = u.y;
+    result.m[9] = u.z;
+    result.m[2] = -f.x;
+    result.m[6] = -f.y;
+    result.m[10] = -f.z;
+    result.m[12] = -vec3_dot(s, eye);
+    result.m[13] = -vec3_dot(u, eye);
+    result.m[14] = vec3_dot(f, eye);
+    return result;
+}
+
+//
+// Quaternions
+//
+
+static Quat
+quat_identity(void) {
+    Quat result = {0, 0, 0, 1};
+    return result;
+}
+
+static Quat
+quat_from_axis_angle(Vec3 axis, float angle) {
+    Vec3 a = vec3_scale(vec3_normalize(axis), sinf(angle * 0.5f));
+    Quat result = {a.x, a.y, a.z, cosf(angle * 0.5f)};
+    return result;
+}
+
+// The rotation b followed by a.
+static Quat
+quat_multiply(Quat a, Quat b) {
+    Quat result = {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+    return result;
+}
+
+static Quat
+quat_normalize(Quat q) {
+    float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if (length > 0.0f) {
+        q.x /= length;
+        q.y /= length;
+        q.z /= length;
+        q.w /= length;
+    }
+    return q;
+}
+
+static Vec3
+quat_rotate(Quat q, Vec3 v) {
+    // v + 2 w (u x v) + 2 u x (u x v), with u the vector part.
+    Vec3 u = vec3(q.x, q.y, q.z);
+    Vec3 t = vec3_scale(vec3_cross(u, v), 2.0f);
+    return vec3_add(vec3_add(v, vec3_scale(t, q.w)), vec3_cross(u, t));
+}
+
+// Normalized linear interpolation along the shorter arc. Close enough to
+// slerp for small steps and much cheaper.
+static Quat
+quat_nlerp(Quat a, Quat b, float t) {
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    float sign = dot < 0.0f ? -1.0f : 1.0f;
+    Quat result = {
+        a.x + (b.x * sign - a.x) * t,
+        a.y + (b.y * sign - a.y) * t,
+        a.z + (b.z * sign - a.z) * t,
+        a.w + (b.w * sign - a.w) * t,
+    };
+    return quat_normalize(result);
+}
+
+static Mat4
+quat_to_mat4(Quat q) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    Mat4 result = mat4_identity();
+    result.m[0] = 1.0f - 2.0f * (yy + zz);
+    result.m[1] = 2.0f * (xy + wz);
+    result.m[2] = 2.0f * (xz - wy);
+    result.m[4] = 2.0f * (xy - wz);
+    result.m[5] = 1.0f - 2.0f * (xx + zz);
+    result.m[6] = 2.0f * (yz + wx);
+    result.m[8] = 2.0f * (xz + wy);
+    result.m[9] = 2.0f * (yz - wx);
+    result.m[10] = 1.0f - 2.0f * (xx + yy);
+    return result;
+}
+
+//
+// Frustum
+//
+
+// Gribb and Hartmann: the planes are sums and differences of the rows of
+// the view-projection matrix.
+static Frustum
+frustum_from_matrix(Mat4 view_projection) {
+    const float *m = view_projection.m;
+    Vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = vec4(m[i], m[4 + i], m[8 + i], m[12 + i]);
+    }
+
+    Frustum result;
+    for (int i = 0; i < 3; ++i) {
+        result.planes[i * 2] = vec4_add(rows[3], rows[i]);
+        result.planes[i * 2 + 1] = vec4_add(rows[3], vec4_scale(rows[i], -1));
+    }
+    for (int i = 0; i < 6; ++i) {
+        Vec4 *p = &result.planes[i];
+        float length = sqrtf(p->x * p->x + p->y * p->y + p->z * p->z);
+        if (length > 0.0f) {
+            *p = vec4_scale(*p, 1.0f / length);
+        }
+    }
+    return result;
+}
+
+static bool
+frustum_test_sphere(const Frustum *frustum, Vec3 center, float radius) {
+    for (int i = 0; i < 6; ++i) {
+        const Vec4 *p = &frustum->planes[i];
+        if (p->x * center.x + p->y * center.y + p->z * center.z + p->w <
+            -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tests the box corner furthest along each plane's normal.
+static bool
+frustum_test_aabb(const Frustum *frustum, Vec3 min, Vec3 max) {
+    for (int i = 0; i < 6; ++i) {
+        const Vec4 *p = &frustum->planes[i];
+        float x = p->x >= 0.0f ? max.x : min.x;
+        float y = p->y >= 0.0f ? max.y : min.y;
+        float z = p->z >= 0.0f ? max.z : min.z;
+        if (p->x * x + p->y * y + p->z * z + p->w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef enum FrustumResult {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECT,
+    FRUSTUM_INSIDE,
+} FrustumResult;
+
+// Like frustum_test_aabb(), but also tests the nearest corner so a box that
+// is wholly inside can skip testing whatever it contains.
+static FrustumResult
+frustum_classify_aabb(const Frustum *frustum, Vec3 min, Vec3 max) {
+    FrustumResult result = FRUSTUM_INSIDE;
+    for (int i = 0; i < 6; ++i) {
+        const Vec4 *p = &frustum->planes[i];
+        float far_x = p->x >= 0.0f ? max.x : min.x;
+        float far_y = p->y >= 0.0f ? max.y : min.y;
+        float far_z = p->z >= 0.0f ? max.z : min.z;
+        if (p->x * far_x + p->y * far_y + p->z * far_z + p->w < 0.0f) {
+            return FRUSTUM_OUTSIDE;
+        }
+        float near_x = p->x >= 0.0f ? min.x : max.x;
+        float near_y = p->y >= 0.0f ? min.y : max.y;
+        float near_z = p->z >= 0.0f ? min.z : max.z;
+        if (p->x * near_x + p->y * near_y + p->z * near_z + p->w < 0.0f) {
+            result = FRUSTUM_INTERSECT;
+        }
+    }
+    return result;
+}
+
+//
+// Batch kernels
+//
+
+typedef enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE,
+    SIMD_AVX2,
+} SimdLevel;
+
+// -1 until the first batch call detects it.
+static int SIMD_LEVEL = -1;
+
+static SimdLevel
+detect_simd_level(void) {
+#ifdef VECTOR_MATH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+static SimdLevel
+get_simd_level(void) {
+    if (SIMD_LEVEL < 0) {
+        SIMD_LEVEL = detect_simd_level();
+    }
+    return (SimdLevel)SIMD_LEVEL;
+}
+
+// Anything wider than the CPU supports falls back to what it does support.
+static void
+set_simd_level(SimdLevel level) {
+    SimdLevel supported = detect_simd_level();
+    SIMD_LEVEL = level < supported ? level : supported;
+}
+
+static const char *
+get_simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE: return "sse";
+        case SIMD_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+// Transforms points (x, y, z, 1) by m into out_x, out_y, out_z, out_w.
+static void
+transform_points_scalar(const Mat4 *m, const float *x, const float *y,
+                        const float *z, float *out_x, float *out_y,
+                        float *out_z, float *out_w, int begin, int end) {
+    const float *c = m->m;
+    for (int i = begin; i < end; ++i) {
+        out_x[i] = c[0] * x[i] + c[4] * y[i] + c[8] * z[i] + c[12];
+        out_y[i] = c[1] * x[i] + c[5] * y[i] + c[9] * z[i] + c[13];
+        out_z[i] = c[2] * x[i] + c[6] * y[i] + c[10] * z[i] + c[14];
+        out_w[i] = c[3] * x[i] + c[7] * y[i] + c[11] * z[i] + c[15];
+    }
+}
+
+// Writes 1 to visible[i] for spheres at least partly inside the frustum and
+// 0 for the rest. Returns the number visible.
+static int
+cull_spheres_scalar(const Frustum *frustum, const float *x, const float *y,
+                    const float *z, const float *radius, uint8_t *visible,
+                    int begin, int end) {
+    int result = 0;
+    for (int i = begin; i < end; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6; ++p) {
+            const Vec4 *plane = &frustum->planes[p];
+            float distance = plane->x * x[i] + plane->y * y[i] +
+                             plane->z * z[i] + plane->w;
+            inside = inside && !(distance < -radius[i]);
+        }
+        visible[i] = inside;
+        result += inside;
+    }
+    return result;
+}
+
+#ifdef VECTOR_MATH_X86
+
+__attribute__((target("sse2")))
+static int
+transform_points_sse(const Mat4 *m, const float *x, const float *y,
+                     const float *z, float *out_x, float *out_y,
+                     float *out_z, float *out_w, int count) {
+    const float *c = m->m;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vz = _mm_loadu_ps(z + i);
+        float *out[4] = {out_x, out_y, out_z, out_w};
+        for (int row = 0; row < 4; ++row) {
+            __m128 r = _mm_mul_ps(_mm_set1_ps(c[row]), vx);
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(c[4 + row]), vy));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(c[8 + row]), vz));
+            r = _mm_add_ps(r, _mm_set1_ps(c[12 + row]));
+            _mm_storeu_ps(out[row] + i, r);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+transform_points_avx2(const Mat4 *m, const float *x, const float *y,
+                      const float *z, float *out_x, float *out_y,
+                      float *out_z, float *out_w, int count) {
+    const float *c = m->m;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        __m256 vz = _mm256_loadu_ps(z + i);
+        float *out[4] = {out_x, out_y, out_z, out_w};
+        for (int row = 0; row < 4; ++row) {
+            __m256 r = _mm256_mul_ps(_mm256_set1_ps(c[row]), vx);
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(c[4 + row]),
+                                               vy));
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(c[8 + row]),
+                                               vz));
+            r = _mm256_add_ps(r, _mm256_set1_ps(c[12 + row]));
+            _mm256_storeu_ps(out[row] + i, r);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int
+cull_spheres_sse(const Frustum *frustum, const float *x, const float *y,
+                 const float *z, const float *radius, uint8_t *visible,
+                 int count, int *visible_count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vz = _mm_loadu_ps(z + i);
+        __m128 limit = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p) {
+            const Vec4 *plane = &frustum->planes[p];
+            __m128 d = _mm_mul_ps(_mm_set1_ps(plane->x), vx);
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane->y), vy));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane->z), vz));
+            d = _mm_add_ps(d, _mm_set1_ps(plane->w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, limit));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; ++lane) {
+            visible[i + lane] = !(mask & (1 << lane));
+        }
+        *visible_count += 4 - __builtin_popcount(mask);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+cull_spheres_avx2(const Frustum *frustum, const float *x, const float *y,
+                  const float *z, const float *radius, uint8_t *visible,
+                  int count, int *visible_count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        __m256 vz = _mm256_loadu_ps(z + i);
+        __m256 limit = _mm256_sub_ps(_mm256_setzero_ps(),
+                                     _mm256_loadu_ps(radius + i));
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; ++p) {
+            const Vec4 *plane = &frustum->planes[p];
+            __m256 d = _mm256_mul_ps(_mm256_set1_ps(plane->x), vx);
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane->y), vy));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane->z), vz));
+            d = _mm256_add_ps(d, _mm256_set1_ps(plane->w));
+            outside = _mm256_or_ps(outside,
+                                   _mm256_cmp_ps(d, limit, _CMP_LT_OQ));
+        }
+        int mask = _mm256_movemask_ps(outside);
+        for (int lane = 0; lane < 8; ++lane) {
+            visible[i + lane] = !(mask & (1 << lane));
+        }
+        *visible_count += 8 - __builtin_popcount(mask);
+    }
+    return i;
+}
+
+#endif
+
+// Transforms count points (x, y, z, 1) by m, e.g. object positions to clip
+// space. Input and output arrays must not overlap.
+static void
+transform_points(const Mat4 *m, const float *x, const float *y,
+                 const float *z, float *out_x, float *out_y, float *out_z,
+                 float *out_w, int count) {
+    int done = 0;
+#ifdef VECTOR_MATH_X86
+    switch (get_simd_level()) {
+        case SIMD_AVX2: {
+            done = transform_points_avx2(m, x, y, z, out_x, out_y, out_z,
+                                         out_w, count);
+        } break;
+
+        case SIMD_SSE: {
+            done = transform_points_sse(m, x, y, z, out_x, out_y, out_z,
+                                        out_w, count);
+        } break;
+
+        default: {
+        } break;
+    }
+#endif
+    transform_points_scalar(m, x, y, z, out_x, out_y, out_z, out_w, done,
+                            count);
+}
+
+// Bounding spheres against a frustum: visible[i] becomes 1 if sphere i is at
+// least partly inside, else 0. Returns the number visible.
+static int
+cull_spheres(const Frustum *frustum, const float *x, const float *y,
+             const float *z, const float *radius, uint8_t *visible,
+             int count) {
+    int done = 0;
+    int result = 0;
+#ifdef VECTOR_MATH_X86
+    switch (get_simd_level()) {
+        case SIMD_AVX2: {
+            done = cull_spheres_avx2(frustum, x, y, z, radius, visible,
+                                     count, &result);
+        } break;
+
+        case SIMD_SSE: {
+            done = cull_spheres_sse(frustum, x, y, z, radius, visible,
+                                    count, &result);
+        } break;
+
+        default: {
+        } break;
+    }
+#endif
+    return result + cull_spheres_scalar(frustum, x, y, z, radius, visible,
+                                        done, count);
+}
+
+#endif
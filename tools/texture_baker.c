@@ -0,0 +1,499 @@
+// Offline texture baker: decodes an image once, builds its mip chain and
+// writes it block-compressed as a .ctex file (see common/compressed_texture.h).
+//
+//   texture_baker [--format bc1|bc3|bc7] input.png output.ctex
+//
+// Without --format, opaque images become BC1 and images with alpha BC3.
+// The encoders are simple principal-axis fits: not the best quality
+// available, but fast and deterministic, which is what a build step wants.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <SOIL/SOIL.h>
+
+#include "common/compressed_texture.h"
+
+typedef struct Image {
+    int width;
+    int height;
+    unsigned char *rgba;
+} Image;
+
+// Finds the principal axis of `count` points with `dims` channels by power
+// iteration and returns the two points that project furthest along it.
+static void
+fit_principal_axis(float points[16][4], int count, int dims,
+                   float *lo, float *hi) {
+    float mean[4] = {0};
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < dims; ++c) {
+            mean[c] += points[i][c] / count;
+        }
+    }
+
+    float cov[4][4] = {{0}};
+    for (int i = 0; i < count; ++i) {
+        for (int a = 0; a < dims; ++a) {
+            for (int b = 0; b < dims; ++b) {
+                cov[a][b] += (points[i][a] - mean[a]) *
+                             (points[i][b] - mean[b]);
+            }
+        }
+    }
+
+    float axis[4] = {1, 1, 1, 1};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {0};
+        float length = 0;
+        for (int a = 0; a < dims; ++a) {
+            for (int b = 0; b < dims; ++b) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) {
+            break;
+        }
+        length = sqrtf(length);
+        for (int a = 0; a < dims; ++a) {
+            axis[a] = next[a] / length;
+        }
+    }
+
+    float min_t = 1e30f, max_t = -1e30f;
+    for (int i = 0; i < count; ++i) {
+        float t = 0;
+        for (int c = 0; c < dims; ++c) {
+            t += (points[i][c] - mean[c]) * axis[c];
+        }
+        if (t < min_t) {
+            min_t = t;
+        }
+        if (t > max_t) {
+            max_t = t;
+        }
+    }
+
+    for (int c = 0; c < dims; ++c) {
+        lo[c] = fminf(fmaxf(mean[c] + axis[c] * min_t, 0), 255);
+        hi[c] = fminf(fmaxf(mean[c] + axis[c] * max_t, 0), 255);
+    }
+}
+
+// Gathers a 4x4 block, clamping at the right and bottom edges.
+static void
+load_block(Image *image, int bx, int by, float block[16][4]) {
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            int sx = bx * 4 + x;
+            int sy = by * 4 + y;
+            if (sx >= image->width) {
+                sx = image->width - 1;
+            }
+            if (sy >= image->height) {
+                sy = image->height - 1;
+            }
+            unsigned char *p = image->rgba + (sy * image->width + sx) * 4;
+            for (int c = 0; c < 4; ++c) {
+                block[y * 4 + x][c] = p[c];
+            }
+        }
+    }
+}
+
+static float
+distance_squared(const float *a, const float *b, int dims) {
+    float result = 0;
+    for (int c = 0; c < dims; ++c) {
+        float d = a[c] - b[c];
+        result += d * d;
+    }
+    return result;
+}
+
+static uint16_t
+pack_565(const float *color) {
+    int r = (int)(color[0] * 31 / 255 + 0.5f);
+    int g = (int)(color[1] * 63 / 255 + 0.5f);
+    int b = (int)(color[2] * 31 / 255 + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void
+unpack_565(uint16_t packed, float *color) {
+    color[0] = ((packed >> 11) & 31) * 255 / 31.0f;
+    color[1] = ((packed >> 5) & 63) * 255 / 63.0f;
+    color[2] = (packed & 31) * 255 / 31.0f;
+}
+
+// Writes the 8-byte colour half of a BC1/BC3 block, always in 4-colour mode.
+static void
+encode_bc1_block(float block[16][4], uint8_t *out) {
+    float lo[4], hi[4];
+    fit_principal_axis(block, 16, 3, lo, hi);
+
+    uint16_t c0 = pack_565(hi);
+    uint16_t c1 = pack_565(lo);
+    if (c0 < c1) {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+
+    float palette[4][4];
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            float best_error = 1e30f;
+            for (int p = 0; p < 4; ++p) {
+                float error = distance_squared(block[i], palette[p], 3);
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; ++i) {
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// BC4-style alpha half of a BC3 block, 8-value mode.
+static void
+encode_bc3_alpha_block(float block[16][4], uint8_t *out) {
+    float min_a = 255, max_a = 0;
+    for (int i = 0; i < 16; ++i) {
+        min_a = fminf(min_a, block[i][3]);
+        max_a = fmaxf(max_a, block[i][3]);
+    }
+
+    int a0 = (int)(max_a + 0.5f);
+    int a1 = (int)(min_a + 0.5f);
+
+    float palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    for (int i = 1; i < 7; ++i) {
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7.0f;
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            float best_error = 1e30f;
+            for (int p = 0; p < 8; ++p) {
+                float error = fabsf(block[i][3] - palette[p]);
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for (int i = 0; i < 6; ++i) {
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+static void
+write_bits(uint8_t *out, int *bit, uint32_t value, int count) {
+    for (int i = 0; i < count; ++i, ++*bit) {
+        if ((value >> i) & 1) {
+            out[*bit >> 3] |= 1 << (*bit & 7);
+        }
+    }
+}
+
+// Quantizes an RGBA endpoint to 7 bits per channel plus a shared p-bit,
+// choosing whichever p-bit reconstructs it best.
+static void
+quantize_bc7_endpoint(const float *endpoint, int *q, int *p) {
+    float best_error = 1e30f;
+
+    for (int pbit = 0; pbit < 2; ++pbit) {
+        int candidate[4];
+        float error = 0;
+        for (int c = 0; c < 4; ++c) {
+            int v = (int)((endpoint[c] - pbit) / 2 + 0.5f);
+            v = v < 0 ? 0 : v > 127 ? 127 : v;
+            candidate[c] = v;
+            float d = endpoint[c] - ((v << 1) | pbit);
+            error += d * d;
+        }
+        if (error < best_error) {
+            best_error = error;
+            *p = pbit;
+            memcpy(q, candidate, sizeof(candidate));
+        }
+    }
+}
+
+// BC7 mode 6: one RGBA subset, 7.7.7.7 endpoints with p-bits and 4-bit
+// indices. Plenty for photographic content with or without alpha.
+static void
+encode_bc7_block(float block[16][4], uint8_t *out) {
+    static const int WEIGHTS[16] = {
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64,
+    };
+
+    float lo[4], hi[4];
+    fit_principal_axis(block, 16, 4, lo, hi);
+
+    int q[2][4], p[2];
+    quantize_bc7_endpoint(lo, q[0], &p[0]);
+    quantize_bc7_endpoint(hi, q[1], &p[1]);
+
+    float palette[16][4];
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            int e0 = (q[0][c] << 1) | p[0];
+            int e1 = (q[1][c] << 1) | p[1];
+            palette[i][c] = ((64 - WEIGHTS[i]) * e0 + WEIGHTS[i] * e1 +
+                             32) >> 6;
+        }
+    }
+
+    int indices[16];
+    for (int i = 0; i < 16; ++i) {
+        float best_error = 1e30f;
+        for (int w = 0; w < 16; ++w) {
+            float error = distance_squared(block[i], palette[w], 4);
+            if (error < best_error) {
+                best_error = error;
+                indices[i] = w;
+            }
+        }
+    }
+
+    // The anchor (first) index is stored with its top bit implied zero.
+    if (indices[0] & 8) {
+        for (int c = 0; c < 4; ++c) {
+            int t = q[0][c];
+            q[0][c] = q[1][c];
+            q[1][c] = t;
+        }
+        int t = p[0];
+        p[0] = p[1];
+        p[1] = t;
+        for (int i = 0; i < 16; ++i) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(out, 0, 16);
+    int bit = 0;
+    write_bits(out, &bit, 1 << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        write_bits(out, &bit, q[0][c], 7);
+        write_bits(out, &bit, q[1][c], 7);
+    }
+    write_bits(out, &bit, p[0], 1);
+    write_bits(out, &bit, p[1], 1);
+    for (int i = 0; i < 16; ++i) {
+        write_bits(out, &bit, indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+static void
+encode_level(Image *image, uint32_t format, uint8_t *out) {
+    int blocks_x = (image->width + 3) / 4;
+    int blocks_y = (image->height + 3) / 4;
+    uint32_t block_size = get_compressed_block_size(format);
+
+    for (int by = 0; by < blocks_y; ++by) {
+        for (int bx = 0; bx < blocks_x; ++bx) {
+            float block[16][4];
+            load_block(image, bx, by, block);
+
+            switch (format) {
+                case COMPRESSED_TEXTURE_BC1: {
+                    encode_bc1_block(block, out);
+                } break;
+
+                case COMPRESSED_TEXTURE_BC3: {
+                    encode_bc3_alpha_block(block, out);
+                    encode_bc1_block(block, out + 8);
+                } break;
+
+                case COMPRESSED_TEXTURE_BC7: {
+                    encode_bc7_block(block, out);
+                } break;
+
+                default: break;
+            }
+
+            out += block_size;
+        }
+    }
+}
+
+// 2x2 box filter; odd edges reuse the last row/column.
+static Image
+downsample(Image *image) {
+    Image result;
+    result.width = image->width > 1 ? image->width / 2 : 1;
+    result.height = image->height > 1 ? image->height / 2 : 1;
+    result.rgba = malloc(result.width * result.height * 4);
+
+    for (int y = 0; y < result.height; ++y) {
+        for (int x = 0; x < result.width; ++x) {
+            int x0 = x * 2, y0 = y * 2;
+            int x1 = x0 + 1 < image->width ? x0 + 1 : x0;
+            int y1 = y0 + 1 < image->height ? y0 + 1 : y0;
+            for (int c = 0; c < 4; ++c) {
+                int sum = image->rgba[(y0 * image->width + x0) * 4 + c] +
+                          image->rgba[(y0 * image->width + x1) * 4 + c] +
+                          image->rgba[(y1 * image->width + x0) * 4 + c] +
+                          image->rgba[(y1 * image->width + x1) * 4 + c];
+                result.rgba[(y * result.width + x) * 4 + c] =
+                    (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+
+    return result;
+}
+
+static bool
+has_alpha(Image *image) {
+    for (int i = 0; i < image->width * image->height; ++i) {
+        if (image->rgba[i * 4 + 3] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+main(int argc, char **argv) {
+    uint32_t format = 0;
+    const char *input = 0;
+    const char *output = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "bc1") == 0) {
+                format = COMPRESSED_TEXTURE_BC1;
+            } else if (strcmp(name, "bc3") == 0) {
+                format = COMPRESSED_TEXTURE_BC3;
+            } else if (strcmp(name, "bc7") == 0) {
+                format = COMPRESSED_TEXTURE_BC7;
+            } else {
+                printf("Unknown format: %s\n", name);
+                return -1;
+            }
+        } else if (!input) {
+            input = argv[i];
+        } else {
+            output = argv[i];
+        }
+    }
+
+    if (!input || !output) {
+        printf("Usage: %s [--format bc1|bc3|bc7] input output.ctex\n",
+               argv[0]);
+        return -1;
+    }
+
+    Image image;
+    image.rgba = SOIL_load_image(input, &image.width, &image.height, 0,
+                                 SOIL_LOAD_RGBA);
+    if (!image.rgba) {
+        printf("Failed to load image %s: %s\n", input, SOIL_last_result());
+        return -1;
+    }
+
+    if (!format) {
+        format = has_alpha(&image) ? COMPRESSED_TEXTURE_BC3 :
+                                     COMPRESSED_TEXTURE_BC1;
+    }
+
+    CompressedTextureHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COMPRESSED_TEXTURE_MAGIC;
+    header.version = COMPRESSED_TEXTURE_VERSION;
+    header.format = format;
+    header.width = image.width;
+    header.height = image.height;
+
+    // Encode every level into one buffer laid out exactly like the file.
+    uint32_t offset = sizeof(header);
+    size_t capacity = offset;
+    uint8_t *data = 0;
+
+    Image level = image;
+    for (;;) {
+        CompressedTextureLevel *info = &header.levels[header.level_count++];
+        info->offset = offset;
+        info->width = level.width;
+        info->height = level.height;
+        info->size = get_compressed_level_size(format, level.width,
+                                               level.height);
+
+        capacity = offset + info->size;
+        data = realloc(data, capacity);
+        encode_level(&level, format, data + offset);
+        offset += info->size;
+
+        if ((level.width == 1 && level.height == 1) ||
+            header.level_count == COMPRESSED_TEXTURE_MAX_LEVELS) {
+            break;
+        }
+
+        Image next = downsample(&level);
+        if (level.rgba != image.rgba) {
+            free(level.rgba);
+        }
+        level = next;
+    }
+    if (level.rgba != image.rgba) {
+        free(level.rgba);
+    }
+
+    memcpy(data, &header, sizeof(header));
+
+    FILE *file = fopen(output, "wb");
+    if (!file) {
+        printf("Failed to open %s for writing\n", output);
+        return -1;
+    }
+    fwrite(data, capacity, 1, file);
+    fclose(file);
+
+    printf("%s: %dx%d BC%u, %u levels, %zu bytes (RGB8 with mips: %d bytes)\n",
+           output, image.width, image.height, format, header.level_count,
+           capacity, image.width * image.height * 3 * 4 / 3);
+
+    free(data);
+    SOIL_free_image_data(image.rgba);
+
+    return 0;
+}